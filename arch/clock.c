@@ -0,0 +1,126 @@
+#include "clock.h"
+#include "cpu.h"
+#include "acpi.h"
+#include "pit.h"
+#include "rtc.h"
+#include <stddef.h>
+
+#define CALIBRATE_US    10000   /* интервал одного замера */
+#define CALIBRATE_RUNS  3       /* берём медиану */
+
+/* ns = cycles * ns_mult >> NS_SHIFT; cycles = ns * cyc_mult >> CYC_SHIFT.
+ * CYC_SHIFT меньше, чтобы tsc_hz << CYC_SHIFT помещалось в 64 бита. */
+#define NS_SHIFT   CLOCK_NS_SHIFT
+#define CYC_SHIFT  24
+
+static uint64_t tsc_hz = 0;
+static uint64_t tsc_base = 0;
+static uint64_t ns_mult = 0;
+static uint64_t cyc_mult = 0;
+static uint64_t boot_real_ns = 0;
+static int tsc_invariant = 0;
+static const char *calib_source = "none";
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t value;
+    __asm__ volatile("inl %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+/* PM timer — свободно бегущий счётчик 3.579545 МГц; отсчитываем по нему
+ * CALIBRATE_US и смотрим, сколько прошло тактов TSC. */
+static uint64_t pm_tsc_hz(uint16_t port, int bits) {
+    uint32_t mask = bits == 32 ? 0xFFFFFFFFu : 0xFFFFFFu;
+    uint32_t want = (uint32_t)((uint64_t)ACPI_PM_TIMER_HZ * CALIBRATE_US / 1000000);
+    uint32_t start = inl(port) & mask;
+    uint64_t t0 = rdtsc();
+    uint32_t ticks;
+    do {
+        ticks = ((inl(port) & mask) - start) & mask;
+    } while (ticks < want);
+    uint64_t t1 = rdtsc();
+    return (t1 - t0) * ACPI_PM_TIMER_HZ / ticks;
+}
+
+static uint64_t median3(uint64_t a, uint64_t b, uint64_t c) {
+    if (a > b) { uint64_t t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return a > b ? a : b;
+}
+
+static uint64_t calibrate(void) {
+    uint64_t hz[CALIBRATE_RUNS];
+    uint16_t port;
+    int bits;
+    int pm = acpi_pm_timer(&port, &bits) == 0;
+
+    for (int i = 0; i < CALIBRATE_RUNS; i++)
+        hz[i] = pm ? pm_tsc_hz(port, bits) : pit_tsc_hz(CALIBRATE_US);
+    calib_source = pm ? "acpi_pm" : "pit";
+    return median3(hz[0], hz[1], hz[2]);
+}
+
+void clock_init(void) {
+    tsc_invariant = cpu_has(CPU_FEAT_INVTSC);
+    tsc_hz = calibrate();
+    if (!tsc_hz) return;
+
+    ns_mult = (NSEC_PER_SEC << NS_SHIFT) / tsc_hz;
+    /* С округлением вверх: срок таймера в тактах не наступит раньше нужного. */
+    cyc_mult = ((tsc_hz << CYC_SHIFT) + NSEC_PER_SEC - 1) / NSEC_PER_SEC;
+    boot_real_ns = rtc_read_epoch() * NSEC_PER_SEC;
+    tsc_base = rdtsc();
+}
+
+uint64_t cycles_to_ns(uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128)cycles * ns_mult) >> NS_SHIFT);
+}
+
+uint64_t ns_to_cycles(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * cyc_mult) >> CYC_SHIFT);
+}
+
+uint64_t ktime_to_tsc(uint64_t ns) {
+    return tsc_base + ns_to_cycles(ns);
+}
+
+uint64_t ktime_get_ns(void) {
+    return cycles_to_ns(rdtsc() - tsc_base);
+}
+
+uint64_t ktime_get_real_ns(void) {
+    return boot_real_ns + ktime_get_ns();
+}
+
+int clock_get_ns(int clk, uint64_t *ns) {
+    switch (clk) {
+    case CLOCK_REALTIME:
+        *ns = ktime_get_real_ns();
+        return 0;
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_BOOTTIME:
+        *ns = ktime_get_ns();
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+uint64_t clock_tsc_hz(void) {
+    return tsc_hz;
+}
+
+void clock_get_params(clock_params_t *p) {
+    p->tsc_base = tsc_base;
+    p->ns_mult = ns_mult;
+    p->real_base_ns = boot_real_ns;
+}
+
+int clock_tsc_invariant(void) {
+    return tsc_invariant;
+}
+
+const char *clock_calibration_source(void) {
+    return calib_source;
+}
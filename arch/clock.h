@@ -0,0 +1,70 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/* Источник времени — TSC, откалиброванный при загрузке по ACPI PM timer
+ * (или каналу 2 PIT). Чтение времени — один rdtsc и умножение, без
+ * обращений к портам и без блокировок. */
+
+#define NSEC_PER_SEC  1000000000ull
+#define NSEC_PER_MSEC 1000000ull
+#define NSEC_PER_USEC 1000ull
+
+/* Часы clock_gettime (номера как в Linux). */
+#define CLOCK_REALTIME      0
+#define CLOCK_MONOTONIC     1
+#define CLOCK_MONOTONIC_RAW 4
+#define CLOCK_BOOTTIME      7
+
+struct timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+struct timeval {
+    int64_t tv_sec;
+    int64_t tv_usec;
+};
+
+/* Пересчёт TSC во время без вызова ядра (vDSO):
+ * ns = (tsc - tsc_base) * ns_mult >> CLOCK_NS_SHIFT. */
+#define CLOCK_NS_SHIFT 32
+
+typedef struct clock_params {
+    uint64_t tsc_base;
+    uint64_t ns_mult;       /* 0 — TSC не откалиброван */
+    uint64_t real_base_ns;  /* CLOCK_REALTIME в момент tsc_base */
+} clock_params_t;
+
+/* Откалибровать TSC и прочитать RTC. После acpi_init, с запрещёнными
+ * прерываниями. */
+void clock_init(void);
+
+/* Наносекунды с clock_init. До неё — 0. */
+uint64_t ktime_get_ns(void);
+
+/* Наносекунды с 1970-01-01 UTC. */
+uint64_t ktime_get_real_ns(void);
+
+/* Время часов clk в нс; -1 для неизвестных часов. */
+int clock_get_ns(int clk, uint64_t *ns);
+
+/* Пересчёт тактов TSC в наносекунды и обратно. */
+uint64_t cycles_to_ns(uint64_t cycles);
+uint64_t ns_to_cycles(uint64_t ns);
+
+/* Значение TSC в момент ktime ns (для TSC-deadline). */
+uint64_t ktime_to_tsc(uint64_t ns);
+
+uint64_t clock_tsc_hz(void);
+
+void clock_get_params(clock_params_t *p);
+
+/* 1, если TSC идёт с постоянной частотой во всех P/C-состояниях. */
+int clock_tsc_invariant(void);
+
+/* Эталон калибровки: "acpi_pm" или "pit". */
+const char *clock_calibration_source(void);
+
+#endif /* CLOCK_H */
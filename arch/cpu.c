@@ -11,6 +11,42 @@ static inline uint8_t inb(uint16_t port) {
     return value;
 }
 
+static uint32_t features[CPU_WORDS];
+
+void cpu_init(void) {
+    uint32_t a, b, c, d;
+
+    cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+
+    cpuid(1, 0, &a, &b, &c, &d);
+    features[CPU_WORD_1_EDX] = d;
+    features[CPU_WORD_1_ECX] = c;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &a, &b, &c, &d);
+        features[CPU_WORD_7_EBX] = b;
+        features[CPU_WORD_7_ECX] = c;
+        features[CPU_WORD_7_EDX] = d;
+    }
+
+    cpuid(0x80000000, 0, &a, &b, &c, &d);
+    uint32_t max_ext = a;
+    if (max_ext >= 0x80000001) {
+        cpuid(0x80000001, 0, &a, &b, &c, &d);
+        features[CPU_WORD_81_EDX] = d;
+        features[CPU_WORD_81_ECX] = c;
+    }
+    if (max_ext >= 0x80000007) {
+        cpuid(0x80000007, 0, &a, &b, &c, &d);
+        features[CPU_WORD_87_EDX] = d;
+    }
+}
+
+int cpu_has(int feature) {
+    return (int)((features[feature >> 5] >> (feature & 31)) & 1);
+}
+
 void cpu_halt(void) {
     for (;;) __asm__ volatile("cli; hlt");
 }
@@ -1,10 +1,171 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <stdint.h>
+
+/* Возможности CPU: слово CPUID (номер << 5) | бит. */
+#define CPU_WORD_1_EDX      0   /* CPUID 1, EDX */
+#define CPU_WORD_1_ECX      1   /* CPUID 1, ECX */
+#define CPU_WORD_7_EBX      2   /* CPUID 7.0, EBX */
+#define CPU_WORD_7_ECX      3   /* CPUID 7.0, ECX */
+#define CPU_WORD_7_EDX      4   /* CPUID 7.0, EDX */
+#define CPU_WORD_81_EDX     5   /* CPUID 0x80000001, EDX */
+#define CPU_WORD_81_ECX     6   /* CPUID 0x80000001, ECX */
+#define CPU_WORD_87_EDX     7   /* CPUID 0x80000007, EDX */
+#define CPU_WORDS           8
+
+#define CPU_FEATURE(word, bit) (((word) << 5) | (bit))
+
+#define CPU_FEAT_TSC        CPU_FEATURE(CPU_WORD_1_EDX, 4)
+#define CPU_FEAT_PGE        CPU_FEATURE(CPU_WORD_1_EDX, 13)
+#define CPU_FEAT_PAT        CPU_FEATURE(CPU_WORD_1_EDX, 16)
+#define CPU_FEAT_APIC       CPU_FEATURE(CPU_WORD_1_EDX, 9)
+#define CPU_FEAT_FXSR       CPU_FEATURE(CPU_WORD_1_EDX, 24)
+#define CPU_FEAT_XSAVE      CPU_FEATURE(CPU_WORD_1_ECX, 26)
+#define CPU_FEAT_AVX        CPU_FEATURE(CPU_WORD_1_ECX, 28)
+#define CPU_FEAT_PCID       CPU_FEATURE(CPU_WORD_1_ECX, 17)
+#define CPU_FEAT_X2APIC     CPU_FEATURE(CPU_WORD_1_ECX, 21)
+#define CPU_FEAT_TSC_DEADLINE CPU_FEATURE(CPU_WORD_1_ECX, 24)
+#define CPU_FEAT_ERMS       CPU_FEATURE(CPU_WORD_7_EBX, 9)
+#define CPU_FEAT_FSRM       CPU_FEATURE(CPU_WORD_7_EDX, 4)
+#define CPU_FEAT_NX         CPU_FEATURE(CPU_WORD_81_EDX, 20)
+#define CPU_FEAT_PDPE1GB    CPU_FEATURE(CPU_WORD_81_EDX, 26)
+#define CPU_FEAT_INVTSC     CPU_FEATURE(CPU_WORD_87_EDX, 8)
+
 /* Остановить CPU. */
 void cpu_halt(void);
 
 /* Перезагрузка через keyboard controller. */
 void cpu_reboot(void);
 
+/* Прочитать CPUID; вызвать один раз при старте. */
+void cpu_init(void);
+
+/* 1, если CPU поддерживает возможность CPU_FEAT_*. */
+int cpu_has(int feature);
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+                     : "a"(leaf), "c"(subleaf));
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    uint32_t lo = (uint32_t)(value & 0xFFFFFFFF);
+    uint32_t hi = (uint32_t)(value >> 32);
+    __asm__ volatile("wrmsr" :: "c"(msr), "a"(lo), "d"(hi));
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t read_cr0(void) {
+    uint64_t v;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint64_t v) {
+    __asm__ volatile("mov %0, %%cr0" :: "r"(v) : "memory");
+}
+
+static inline uint64_t read_cr2(void) {
+    uint64_t v;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(v));
+    return v;
+}
+
+static inline uint64_t read_cr3(void) {
+    uint64_t v;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr3(uint64_t v) {
+    __asm__ volatile("mov %0, %%cr3" :: "r"(v) : "memory");
+}
+
+static inline uint64_t read_cr4(void) {
+    uint64_t v;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint64_t v) {
+    __asm__ volatile("mov %0, %%cr4" :: "r"(v) : "memory");
+}
+
+/* Счётчик тактов; lfence не даёт rdtsc выполниться раньше предыдущих инструкций. */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void invlpg(uint64_t addr) {
+    __asm__ volatile("invlpg (%0)" :: "r"(addr) : "memory");
+}
+
+/* Запретить прерывания, вернув прежний RFLAGS для cpu_irq_restore. */
+static inline uint64_t cpu_irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void cpu_irq_restore(uint64_t flags) {
+    __asm__ volatile("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+static inline void cpu_irq_enable(void) {
+    __asm__ volatile("sti" ::: "memory");
+}
+
+/* Ждать прерывания. sti действует только после следующей инструкции,
+ * поэтому прерывание между проверкой и hlt не теряется. */
+static inline void cpu_wait_irq(void) {
+    __asm__ volatile("sti; hlt; cli" ::: "memory");
+}
+
+static inline void xsetbv(uint32_t xcr, uint64_t value) {
+    __asm__ volatile("xsetbv" :: "c"(xcr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void cpu_pause(void) {
+    __asm__ volatile("pause" ::: "memory");
+}
+
+static inline void clts(void) {
+    __asm__ volatile("clts" ::: "memory");
+}
+
+static inline void wbinvd(void) {
+    __asm__ volatile("wbinvd" ::: "memory");
+}
+
+#define MSR_EFER    0xC0000080
+#define EFER_SCE    (1 << 0)
+#define EFER_LME    (1 << 8)
+#define EFER_LMA    (1 << 10)
+#define EFER_NXE    (1 << 11)
+#define MSR_PAT     0x277
+#define MSR_APIC_BASE 0x1B
+#define MSR_TSC_DEADLINE 0x6E0
+#define MSR_GS_BASE        0xC0000101
+#define MSR_KERNEL_GS_BASE 0xC0000102
+
+#define CR0_MP      (1ull << 1)
+#define CR0_EM      (1ull << 2)
+#define CR0_TS      (1ull << 3)
+#define CR0_NE      (1ull << 5)
+#define CR0_WP      (1ull << 16)
+#define CR4_PGE     (1ull << 7)
+#define CR4_OSFXSR  (1ull << 9)
+#define CR4_OSXMMEXCPT (1ull << 10)
+#define CR4_PCIDE   (1ull << 17)
+#define CR4_OSXSAVE (1ull << 18)
+
 #endif /* CPU_H */
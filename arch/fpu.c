@@ -0,0 +1,193 @@
+#include "fpu.h"
+#include "cpu.h"
+#include "process.h"
+#include "pmm.h"
+#include "string.h"
+#include "smp.h"
+#include <stddef.h>
+
+#define XCR0_X87   (1ull << 0)
+#define XCR0_SSE   (1ull << 1)
+#define XCR0_AVX   (1ull << 2)
+
+#define FPU_AREA_MAX   PAGE_SIZE    /* область задачи — один фрейм */
+#define MXCSR_DEFAULT  0x1F80       /* все исключения SIMD замаскированы */
+
+static int use_xsave = 0;
+static uint64_t xcr0 = 0;
+static uint32_t state_size = 512;   /* FXSAVE */
+
+/* Состояние после FNINIT — с него начинает каждая задача. */
+static uint8_t init_state[FPU_AREA_MAX] __attribute__((aligned(64)));
+
+/* По CPU: задача, чьё состояние сейчас в регистрах (NULL — ничьё). */
+static struct process *fpu_owner[SMP_MAX_CPUS];
+
+static int kernel_fpu_depth[SMP_MAX_CPUS];
+static uint64_t kernel_fpu_flags[SMP_MAX_CPUS];
+
+static void fpu_save(void *area) {
+    if (use_xsave)
+        __asm__ volatile("xsave64 (%0)" :: "r"(area), "a"((uint32_t)xcr0),
+                         "d"((uint32_t)(xcr0 >> 32)) : "memory");
+    else
+        __asm__ volatile("fxsave64 (%0)" :: "r"(area) : "memory");
+}
+
+static void fpu_restore(const void *area) {
+    if (use_xsave)
+        __asm__ volatile("xrstor64 (%0)" :: "r"(area), "a"((uint32_t)xcr0),
+                         "d"((uint32_t)(xcr0 >> 32)) : "memory");
+    else
+        __asm__ volatile("fxrstor64 (%0)" :: "r"(area) : "memory");
+}
+
+static void set_ts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* Сохранить состояние владельца в его область; регистры становятся ничьими. */
+static void fpu_unload(void) {
+    uint32_t cpu = cpu_id();
+    if (!fpu_owner[cpu]) return;
+    clts();
+    fpu_save(fpu_owner[cpu]->fpu_state);
+    fpu_owner[cpu] = NULL;
+}
+
+/* CR0/CR4/XCR0 этого CPU; xcr0 уже выбран. */
+static void fpu_enable(void) {
+    uint64_t cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0 & ~CR0_TS);
+
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (cpu_has(CPU_FEAT_XSAVE)) cr4 |= CR4_OSXSAVE;
+    write_cr4(cr4);
+    if (xcr0) xsetbv(0, xcr0);
+}
+
+void fpu_init(void) {
+    fpu_enable();
+
+    if (cpu_has(CPU_FEAT_XSAVE)) {
+        uint32_t a, b, c, d;
+        cpuid(0xD, 0, &a, &b, &c, &d);
+        uint64_t supported = ((uint64_t)d << 32) | a;
+        xcr0 = XCR0_X87 | XCR0_SSE;
+        if (cpu_has(CPU_FEAT_AVX) && (supported & XCR0_AVX)) xcr0 |= XCR0_AVX;
+        xsetbv(0, xcr0);
+
+        /* EBX — размер области для включённых сейчас компонент. */
+        cpuid(0xD, 0, &a, &b, &c, &d);
+        if (b <= FPU_AREA_MAX) {
+            use_xsave = 1;
+            state_size = b;
+        }
+    }
+
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ volatile("fninit; ldmxcsr %0" :: "m"(mxcsr));
+    fpu_save(init_state);
+
+    /* Первая FPU-инструкция любой задачи загрузит ей init_state. */
+    set_ts();
+}
+
+void fpu_init_cpu(void) {
+    fpu_enable();
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ volatile("fninit; ldmxcsr %0" :: "m"(mxcsr));
+    set_ts();
+}
+
+uint32_t fpu_state_size(void) {
+    return state_size;
+}
+
+static void *fpu_area_alloc(void) {
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) return NULL;
+    memcpy((void *)(uintptr_t)frame, init_state, FPU_AREA_MAX);
+    return (void *)(uintptr_t)frame;
+}
+
+int fpu_handle_nm(void) {
+    struct process *cur = process_current();
+    uint32_t cpu = cpu_id();
+    clts();
+    if (fpu_owner[cpu] == cur && cur) return 0;
+
+    fpu_unload();
+    if (!cur) {
+        /* Ядру без процесса сохранять нечего. */
+        fpu_restore(init_state);
+        return 0;
+    }
+    if (!cur->fpu_state) {
+        cur->fpu_state = fpu_area_alloc();
+        if (!cur->fpu_state) return -1;
+    }
+    fpu_restore(cur->fpu_state);
+    fpu_owner[cpu] = cur;
+    return 0;
+}
+
+void fpu_switch(struct process *next) {
+    if (next && next == fpu_owner[cpu_id()]) clts();
+    else set_ts();
+}
+
+int fpu_state_live(const struct process *p) {
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (fpu_owner[cpu] == p) return 1;
+    }
+    return 0;
+}
+
+int fpu_fork(struct process *parent, struct process *child) {
+    child->fpu_state = NULL;
+    if (!parent || !parent->fpu_state) return 0;
+
+    /* Родитель может держать свежее состояние в регистрах. */
+    if (fpu_owner[cpu_id()] == parent) {
+        uint64_t flags = cpu_irq_save();
+        fpu_unload();
+        set_ts();
+        cpu_irq_restore(flags);
+    }
+
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) return -1;
+    memcpy((void *)(uintptr_t)frame, parent->fpu_state, FPU_AREA_MAX);
+    child->fpu_state = (void *)(uintptr_t)frame;
+    return 0;
+}
+
+void fpu_release(struct process *p) {
+    if (!p || !p->fpu_state) return;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (fpu_owner[cpu] == p) fpu_owner[cpu] = NULL;
+    }
+    pmm_free_frame((uint64_t)(uintptr_t)p->fpu_state);
+    p->fpu_state = NULL;
+}
+
+void kernel_fpu_begin(void) {
+    uint64_t flags = cpu_irq_save();
+    uint32_t cpu = cpu_id();
+    if (kernel_fpu_depth[cpu]++ > 0) return;
+    kernel_fpu_flags[cpu] = flags;
+    fpu_unload();
+    clts();
+}
+
+void kernel_fpu_end(void) {
+    uint32_t cpu = cpu_id();
+    if (--kernel_fpu_depth[cpu] > 0) return;
+    /* В регистрах значения ядра: следующая FPU-инструкция задачи загрузит
+     * её состояние через #NM. */
+    set_ts();
+    cpu_irq_restore(kernel_fpu_flags[cpu]);
+}
@@ -0,0 +1,45 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+
+struct process;
+
+/* x87/SSE/AVX. Состояние регистров сохраняется лениво: при переключении
+ * задач ставится CR0.TS, и только первая FPU-инструкция новой задачи (#NM)
+ * сохраняет состояние прежнего владельца и загружает своё. Задачи, которые
+ * не трогают FPU, за это не платят. Ядро собрано с -mno-sse; SIMD в ядре —
+ * только между kernel_fpu_begin и kernel_fpu_end. */
+
+/* Включить SSE (и XSAVE/AVX, если есть) в CR0/CR4/XCR0. После cpu_init. */
+void fpu_init(void);
+
+/* Те же регистры на AP (размер области и XCR0 уже выбраны BSP). */
+void fpu_init_cpu(void);
+
+/* Байт в области сохранения одной задачи (XSAVE или FXSAVE). */
+uint32_t fpu_state_size(void);
+
+/* Обработчик #NM: 0 — состояние загружено, -1 — нет памяти под область. */
+int fpu_handle_nm(void);
+
+/* Вызывать при переключении на next (NULL — ядро): TS ставится, если в
+ * регистрах не состояние next. */
+void fpu_switch(struct process *next);
+
+/* 1, если состояние p сейчас в регистрах какого-то CPU: такую задачу нельзя
+ * переносить на другой процессор. */
+int fpu_state_live(const struct process *p);
+
+/* Копия состояния parent для fork. -1 при нехватке памяти. */
+int fpu_fork(struct process *parent, struct process *child);
+
+/* Освободить область сохранения процесса. */
+void fpu_release(struct process *p);
+
+/* SIMD-участок в ядре: состояние владельца сохраняется, прерывания
+ * запрещены до kernel_fpu_end. Допускается вложенность. */
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+#endif /* FPU_H */
@@ -1,18 +1,31 @@
 #include "gdt.h"
+#include "cpu.h"
+#include "smp.h"
+#include "string.h"
 #include <stdint.h>
 
 /* TSS: RSP0 at offset 4 (64-bit). TSS descriptor: base at bytes 2-7, 8-11. */
 #define TSS_RSP0_OFFSET 4
+#define TSS_SIZE        104
+
+/* GDT из gdt.asm: 5 сегментов и 16-байтный дескриптор TSS. */
+#define GDT_SIZE        56
+#define TSS_DESC_OFFSET 40
+#define TSS_TYPE_AVAIL  0x89   /* ltr помечает дескриптор занятым (0x8B) */
 
 /* Внешние символы из asm. */
+extern uint8_t gdt64[];
 extern uint8_t tss64[];
 extern uint8_t tss_descriptor[];
 extern uint8_t stack_top[];
 
-/* Заполнить TSS дескриптор в GDT (база = адрес tss64). */
-static void tss_descriptor_set_base(void) {
-    uint64_t base = (uint64_t)tss64;
-    uint8_t *d = tss_descriptor;
+/* GDT и TSS процессоров, кроме BSP (тот работает на таблицах gdt.asm). */
+static uint64_t cpu_gdt[SMP_MAX_CPUS][GDT_SIZE / 8] __attribute__((aligned(16)));
+static uint8_t cpu_tss[SMP_MAX_CPUS][TSS_SIZE] __attribute__((aligned(16)));
+
+/* Заполнить базу TSS в дескрипторе GDT. */
+static void tss_descriptor_set_base(uint8_t *d, uint8_t *tss) {
+    uint64_t base = (uint64_t)tss;
     d[2] = (uint8_t)(base & 0xFF);
     d[3] = (uint8_t)((base >> 8) & 0xFF);
     d[4] = (uint8_t)((base >> 16) & 0xFF);
@@ -20,36 +33,51 @@ static void tss_descriptor_set_base(void) {
     *(uint32_t *)(d + 8) = (uint32_t)(base >> 32);
 }
 
-static inline void wrmsr(uint32_t msr, uint64_t value) {
-    uint32_t lo = (uint32_t)(value & 0xFFFFFFFF);
-    uint32_t hi = (uint32_t)(value >> 32);
-    __asm__ volatile("wrmsr" :: "c"(msr), "a"(lo), "d"(hi));
-}
-
-static inline uint64_t rdmsr(uint32_t msr) {
-    uint32_t lo, hi;
-    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
-    return ((uint64_t)hi << 32) | lo;
-}
-
-#define MSR_EFER   0xC0000080
 #define MSR_STAR   0xC0000081
 #define MSR_LSTAR  0xC0000082
 #define MSR_FMASK  0xC0000084
-#define EFER_SCE   (1 << 0)
 
 /* Селекторы из gdt.asm */
 #define SEL_KERNEL_CS  0x08
-#define SEL_USER_CS    0x18
+#define SEL_KERNEL_DS  0x10
+#define SEL_SYSRET_BASE 0x10   /* SYSRET: SS = база + 8 (0x18), CS = база + 16 (0x20) */
 #define SEL_TSS        0x28
 
 void tss_set_rsp0(uint64_t rsp) {
-    *(uint64_t *)(tss64 + TSS_RSP0_OFFSET) = rsp;
+    struct percpu *c = this_cpu();
+    *(uint64_t *)(c->tss + TSS_RSP0_OFFSET) = rsp;
+    c->kernel_rsp = rsp;    /* для syscall_entry */
+}
+
+/* MSR инструкции SYSCALL — у каждого CPU свои. */
+static void syscall_init(void) {
+    /* Включить SYSCALL в EFER */
+    uint64_t efer = rdmsr(MSR_EFER);
+    wrmsr(MSR_EFER, efer | EFER_SCE);
+
+    /* IA32_STAR: bits 47:32 = kernel CS (для SYSCALL, SS = CS + 8),
+     * bits 63:48 = база для 64-битного SYSRET. Kernel: CS=0x08, SS=0x10.
+     * User: CS=0x20|3, SS=0x18|3. */
+    wrmsr(MSR_STAR, ((uint64_t)SEL_SYSRET_BASE << 48) | ((uint64_t)SEL_KERNEL_CS << 32));
+
+    /* IA32_LSTAR — адрес точки входа syscall (устанавливается в syscall.asm) */
+    extern void syscall_entry(void);
+    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+
+    /* IA32_FMASK: флаги, снимаемые при входе в kernel. Кроме IF и DF — TF:
+     * иначе #DB от popf+syscall пришёл бы на первую инструкцию входа, до
+     * swapgs и на стеке пользователя; AC и NT пользователь тоже не должен
+     * переносить в ядро. */
+    wrmsr(MSR_FMASK, 0x44700);  /* AC | NT | DF | IF | TF */
 }
 
 void gdt_init(void) {
+    struct percpu *c = this_cpu();
+    c->gdt = (uint64_t *)gdt64;
+    c->tss = tss64;
+
     /* Заполнить базу TSS в дескрипторе GDT */
-    tss_descriptor_set_base();
+    tss_descriptor_set_base(tss_descriptor, tss64);
 
     /* TSS.RSP0 = вершина kernel stack */
     tss_set_rsp0((uint64_t)stack_top);
@@ -57,18 +85,41 @@ void gdt_init(void) {
     /* Загрузить TR селектором TSS */
     __asm__ volatile("ltr %w0" :: "r"(SEL_TSS));
 
-    /* Включить SYSCALL в EFER */
-    uint64_t efer = rdmsr(MSR_EFER);
-    wrmsr(MSR_EFER, efer | EFER_SCE);
+    syscall_init();
+}
 
-    /* IA32_STAR: bits 47:32 = kernel CS (для SYSCALL), bits 63:48 = user CS (для SYSRET).
-     * SS = CS + 8. Kernel: CS=0x08, SS=0x10. User: CS=0x18, SS=0x20. */
-    wrmsr(MSR_STAR, ((uint64_t)SEL_USER_CS << 48) | ((uint64_t)SEL_KERNEL_CS << 32));
+void gdt_init_cpu(void) {
+    struct percpu *c = this_cpu();
+    c->gdt = cpu_gdt[c->id];
+    c->tss = cpu_tss[c->id];
 
-    /* IA32_LSTAR — адрес точки входа syscall (устанавливается в syscall.asm) */
-    extern void syscall_entry(void);
-    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+    /* Копия GDT BSP со своим TSS; дескриптор BSP уже занят — сбрасываем. */
+    memcpy(c->gdt, gdt64, GDT_SIZE);
+    uint8_t *desc = (uint8_t *)c->gdt + TSS_DESC_OFFSET;
+    desc[5] = TSS_TYPE_AVAIL;
+    tss_descriptor_set_base(desc, c->tss);
+    memset(c->tss, 0, TSS_SIZE);
+    *(uint16_t *)(c->tss + 0x66) = TSS_SIZE;   /* без карты ввода-вывода */
 
-    /* IA32_FMASK: маскировать IF и DF при входе в kernel */
-    wrmsr(MSR_FMASK, 0x600);  /* IF | DF */
+    struct {
+        uint16_t limit;
+        uint64_t base;
+    } __attribute__((packed)) gdtr = { GDT_SIZE - 1, (uint64_t)(uintptr_t)c->gdt };
+
+    /* CS перезагружается дальним возвратом; GS не трогаем — в нём база
+     * области CPU. */
+    __asm__ volatile("lgdt %0\n\t"
+                     "pushq %1\n\t"
+                     "leaq 1f(%%rip), %%rax\n\t"
+                     "pushq %%rax\n\t"
+                     "lretq\n"
+                     "1:\n\t"
+                     "movw %w2, %%ax\n\t"
+                     "movw %%ax, %%ds\n\t"
+                     "movw %%ax, %%es\n\t"
+                     "movw %%ax, %%ss\n\t"
+                     :: "m"(gdtr), "i"(SEL_KERNEL_CS), "i"(SEL_KERNEL_DS) : "rax", "memory");
+
+    __asm__ volatile("ltr %w0" :: "r"(SEL_TSS));
+    syscall_init();
 }
@@ -7,7 +7,11 @@
  * Вызвать после idt_init(). Устанавливает TSS.RSP0, загружает TR, настраивает MSR. */
 void gdt_init(void);
 
-/* Обновить RSP0 в TSS (при переключении процесса — вызывать перед iret/sysret). */
+/* То же для AP: своя копия GDT со своим TSS. После smp-настройки GS. */
+void gdt_init_cpu(void);
+
+/* Обновить RSP0 в TSS этого CPU и стек ядра для syscall_entry (при
+ * переключении процесса — вызывать перед iret/sysret). */
 void tss_set_rsp0(uint64_t rsp);
 
 #endif /* GDT_H */
@@ -1,6 +1,9 @@
 #include "idt.h"
 #include "vga.h"
 #include "cpu.h"
+#include "vmm.h"
+#include "fpu.h"
+#include "irq.h"
 #include <stdint.h>
 
 /* Глобальный IDT. */
@@ -12,8 +15,12 @@ extern void isr8(void), isr9(void), isr10(void), isr11(void), isr12(void), isr13
 extern void isr16(void), isr17(void), isr18(void), isr19(void), isr20(void), isr21(void), isr22(void), isr23(void);
 extern void isr24(void), isr25(void), isr26(void), isr27(void), isr28(void), isr29(void), isr30(void), isr31(void);
 
+/* Заглушки векторов 32–255, по 16 байт каждая. */
+#define IRQ_STUB_SIZE 16
+extern uint8_t irq_stubs[];
+
 static inline void lidt(struct idt_ptr *idtr) {
-    __asm__ volatile("lidt (%0)" :: "r"(idtr));
+    __asm__ volatile("lidt (%0)" :: "r"(idtr) : "memory");
 }
 
 static void idt_set_gate(int num, void (*handler)(void)) {
@@ -39,14 +46,18 @@ static const char *exceptions[] = {
 
 void idt_handler(uint64_t vector, uint64_t error_code) {
     if (vector < 32) {
+        /* #PF в ленивой области разрешается без остановки. */
+        uint64_t cr2 = vector == 14 ? read_cr2() : 0;
+        if (vector == 14 && vmm_handle_fault(cr2, error_code) == 0) return;
+        /* #NM: ленивая загрузка FPU-состояния задачи. */
+        if (vector == 7 && fpu_handle_nm() == 0) return;
+
         vga_print("Exception ");
         vga_print_uint64(vector);
         vga_print(": ");
         vga_println(exceptions[vector]);
         if (vector == 14) {
             vga_print("  CR2=");
-            uint64_t cr2;
-            __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
             vga_print_hex64(cr2);
             vga_print(" error=");
             vga_print_hex64(error_code);
@@ -77,6 +88,14 @@ void idt_init(void) {
         idt_set_gate(i, handlers[i]);
     }
 
+    for (int v = IRQ_VECTOR_FIRST; v < IDT_MAX_ENTRIES; v++) {
+        idt_set_gate(v, (void (*)(void))(irq_stubs + (v - IRQ_VECTOR_FIRST) * IRQ_STUB_SIZE));
+    }
+
+    idt_load();
+}
+
+void idt_load(void) {
     struct idt_ptr idtr;
     idtr.limit = (uint16_t)(sizeof(idt) - 1);
     idtr.base  = (uint64_t)&idt[0];
@@ -24,7 +24,11 @@ struct idt_ptr {
 
 void idt_init(void);
 
-/* Вызывается из isr_common. vector 0–31, error_code для page fault и др. */
+/* Загрузить общую IDT в IDTR этого CPU (idt_init делает это для BSP). */
+void idt_load(void);
+
+/* Вызывается из isr_common для исключений 0–31 (error_code для page fault
+ * и др.). Векторы 32–255 идут через irq_dispatch. */
 void idt_handler(uint64_t vector, uint64_t error_code);
 
 #endif /* IDT_H */
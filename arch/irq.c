@@ -0,0 +1,63 @@
+#include "irq.h"
+#include "sched.h"
+#include <stddef.h>
+
+typedef struct irq_desc {
+    irq_handler_t handler;
+    void *ctx;
+    uint64_t count;
+} irq_desc_t;
+
+static irq_desc_t irq_table[IRQ_VECTORS];
+static const irq_chip_t *irq_chip = NULL;
+static uint64_t spurious = 0;
+static uint64_t unhandled = 0;
+
+void irq_set_chip(const irq_chip_t *chip) {
+    irq_chip = chip;
+}
+
+const irq_chip_t *irq_get_chip(void) {
+    return irq_chip;
+}
+
+int irq_register(uint8_t vector, irq_handler_t handler, void *ctx) {
+    if (vector < IRQ_VECTOR_FIRST || !handler || irq_table[vector].handler) return -1;
+    irq_table[vector].ctx = ctx;
+    irq_table[vector].handler = handler;
+    return 0;
+}
+
+void irq_unregister(uint8_t vector) {
+    irq_table[vector].handler = NULL;
+    irq_table[vector].ctx = NULL;
+}
+
+uint64_t irq_count(uint8_t vector) {
+    return irq_table[vector].count;
+}
+
+uint64_t irq_spurious_count(void) {
+    return spurious;
+}
+
+uint64_t irq_unhandled_count(void) {
+    return unhandled;
+}
+
+void irq_dispatch(uint64_t vector) {
+    if (irq_chip && irq_chip->spurious && irq_chip->spurious((uint8_t)vector)) {
+        __atomic_fetch_add(&spurious, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    irq_desc_t *d = &irq_table[vector & (IRQ_VECTORS - 1)];
+    __atomic_fetch_add(&d->count, 1, __ATOMIC_RELAXED);
+    if (d->handler) d->handler((uint8_t)vector, d->ctx);
+    else __atomic_fetch_add(&unhandled, 1, __ATOMIC_RELAXED);
+
+    if (irq_chip) irq_chip->eoi((uint8_t)vector);
+
+    /* После EOI: обработчик мог разбудить задачу важнее текущей. */
+    sched_irq_exit();
+}
@@ -0,0 +1,40 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+/* Векторы 32–255: таблица обработчиков с контекстом и счётчиками. Вход —
+ * короткие заглушки из isr.asm, сохраняющие только caller-saved регистры. */
+
+#define IRQ_VECTOR_FIRST 32
+#define IRQ_VECTORS      256
+
+typedef void (*irq_handler_t)(uint8_t vector, void *ctx);
+
+/* Активный контроллер прерываний (8259, позже APIC). */
+typedef struct irq_chip {
+    const char *name;
+    void (*eoi)(uint8_t vector);
+    /* 1, если прерывание ложное: обработчик не вызывается, EOI — на
+     * совести контроллера. */
+    int (*spurious)(uint8_t vector);
+} irq_chip_t;
+
+void irq_set_chip(const irq_chip_t *chip);
+const irq_chip_t *irq_get_chip(void);
+
+/* Подключить обработчик. -1 для векторов исключений и занятых векторов. */
+int irq_register(uint8_t vector, irq_handler_t handler, void *ctx);
+void irq_unregister(uint8_t vector);
+
+/* Сколько раз пришёл вектор (без ложных). */
+uint64_t irq_count(uint8_t vector);
+
+/* Ложные прерывания и прерывания без обработчика. */
+uint64_t irq_spurious_count(void);
+uint64_t irq_unhandled_count(void);
+
+/* Вызывается из irq_common в isr.asm. */
+void irq_dispatch(uint64_t vector);
+
+#endif /* IRQ_H */
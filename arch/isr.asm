@@ -1,9 +1,58 @@
-; isr.asm - заглушки прерываний для передачи в C-обработчик
+; isr.asm - заглушки исключений и векторов 32–255 для передачи в C-обработчики
 ; CPU при прерывании без error code пушит: SS, RSP, RFLAGS, CS, RIP
 ; С error code (8,10,11,12,13,14): error_code, SS, RSP, RFLAGS, CS, RIP
+;
+; Заглушки дополняют кадр до общего struct pt_regs (regs.h): код ошибки
+; (0, если CPU его не положил) и номер вектора. Из ring 3 вход и выход
+; делают swapgs — в ядре база GS всегда указывает на область CPU.
 
 BITS 64
 
+; Регистры в порядке struct pt_regs (как в syscall.asm).
+%macro PUSH_REGS 0
+    push rdi
+    push rsi
+    push rdx
+    push rcx
+    push rax
+    push r8
+    push r9
+    push r10
+    push r11
+    push rbx
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+%endmacro
+
+%macro POP_REGS 0
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    pop rbx
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rax
+    pop rcx
+    pop rdx
+    pop rsi
+    pop rdi
+%endmacro
+
+; Кадр CPU выше vector и error_code: CS — в [rsp + 24].
+%macro SWAPGS_IF_USER 1
+    test byte [rsp + %1], 3
+    jz %%kernel
+    swapgs
+%%kernel:
+%endmacro
+
 %macro ISR_NOERR 1
 global isr%1
 isr%1:
@@ -54,41 +103,67 @@ ISR_NOERR 31
 
 extern idt_handler
 isr_common:
-    push rax
-    push rbx
-    push rcx
-    push rdx
-    push rsi
+    SWAPGS_IF_USER 24
+    PUSH_REGS
+
+    cld
+    mov rdi, [rsp + 15*8]       ; vector
+    mov rsi, [rsp + 16*8]       ; error_code
+    call idt_handler
+
+    POP_REGS
+    add rsp, 16                 ; vector + error_code
+    SWAPGS_IF_USER 8
+    iretq
+
+; --- Векторы 32–255: заглушки по 16 байт подряд, адрес вектора v —
+; irq_stubs + (v - 32) * 16 (см. idt_init).
+
+extern irq_dispatch
+
+align 16
+global irq_stubs
+irq_stubs:
+%assign v 32
+%rep 224
+    push 0                      ; error_code
+    push v
+    jmp irq_common
+    align 16
+%assign v v+1
+%endrep
+
+; Быстрый вход: обработчики на C сами сохраняют callee-saved регистры,
+; поэтому здесь только caller-saved — верхняя часть struct pt_regs
+; (9 регистров вместо 15 в isr_common).
+irq_common:
+    SWAPGS_IF_USER 24
     push rdi
-    push rbp
+    push rsi
+    push rdx
+    push rcx
+    push rax
     push r8
     push r9
     push r10
     push r11
-    push r12
-    push r13
-    push r14
-    push r15
 
-    mov rdi, [rsp + 15*8]       ; vector
-    mov rsi, [rsp + 16*8]       ; error_code
-    call idt_handler
+    cld
+    mov rdi, [rsp + 9*8]        ; vector
+    ; Кадр CPU (40 байт, стек выровнен до него) + 2 слова + 9 регистров —
+    ; 16 слов, выравнивать не нужно.
+    call irq_dispatch
 
-    pop r15
-    pop r14
-    pop r13
-    pop r12
     pop r11
     pop r10
     pop r9
     pop r8
-    pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rbx
     pop rax
+    pop rcx
+    pop rdx
+    pop rsi
+    pop rdi
 
     add rsp, 16                 ; vector + error_code
+    SWAPGS_IF_USER 8
     iretq
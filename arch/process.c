@@ -1,24 +1,170 @@
 #include "process.h"
+#include "fpu.h"
+#include "pmm.h"
+#include "sched.h"
+#include "syscall.h"
+#include "string.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "vdso.h"
 #include <stddef.h>
 
+/* Точки первого входа в задачу (switch.asm, syscall.asm). */
+extern void task_start(void);
+extern void fork_child_start(void);
+
+/* Загрузочный стек (boot.asm): на нём работает процесс 1. */
+extern uint8_t stack_top[];
+
 static struct process procs[PROC_MAX];
-static struct process *current_proc;
+static spinlock_t procs_lock = SPINLOCK_INIT;
 static uint64_t next_pid = 1;
 
 struct process *process_current(void) {
-    return current_proc;
+    return this_cpu()->current;
+}
+
+void process_set_current(struct process *p) {
+    this_cpu()->current = p;
+}
+
+struct process *process_at(int slot) {
+    if (slot < 0 || slot >= PROC_MAX || procs[slot].state == PROC_FREE) return NULL;
+    return &procs[slot];
+}
+
+static void set_name(struct process *p, const char *name) {
+    size_t i = 0;
+    for (; name && name[i] && i < PROC_NAME_LEN - 1; i++) p->name[i] = name[i];
+    p->name[i] = '\0';
+}
+
+/* Свободный слот с обнулёнными полями. Слот занят (BLOCKED — планировщик
+ * его не тронет), пока вызывающий не закончит настройку или не вернёт его
+ * через proc_free. */
+static struct process *proc_alloc(void) {
+    uint64_t flags = spin_lock_irqsave(&procs_lock);
+    for (int i = 0; i < PROC_MAX; i++) {
+        if (procs[i].state == PROC_FREE) {
+            memset(&procs[i], 0, sizeof(procs[i]));
+            procs[i].prio = SCHED_PRIO_DEFAULT;
+            procs[i].state = PROC_BLOCKED;
+            spin_unlock_irqrestore(&procs_lock, flags);
+            return &procs[i];
+        }
+    }
+    spin_unlock_irqrestore(&procs_lock, flags);
+    return NULL;
+}
+
+static void proc_free(struct process *p) {
+    __atomic_store_n(&p->state, PROC_FREE, __ATOMIC_RELEASE);
+}
+
+static int kstack_alloc(struct process *p) {
+    uint64_t stack = pmm_alloc_order(KSTACK_ORDER);
+    if (!stack) return -1;
+    p->kstack = stack;
+    p->kstack_top = stack + KSTACK_SIZE;
+    return 0;
+}
+
+/* Кадр switch_to: callee-saved регистры и адрес возврата. */
+static uint64_t *push_switch_frame(uint64_t *sp, void (*entry)(void), uint64_t r12, uint64_t r13) {
+    *--sp = (uint64_t)(uintptr_t)entry;  /* ret */
+    *--sp = 0;                           /* rbx */
+    *--sp = 0;                           /* rbp */
+    *--sp = r12;
+    *--sp = r13;
+    *--sp = 0;                           /* r14 */
+    *--sp = 0;                           /* r15 */
+    return sp;
+}
+
+struct process *process_create_kernel(const char *name, void (*fn)(void *), void *arg) {
+    struct process *p = proc_alloc();
+    if (!p) return NULL;
+    if (kstack_alloc(p) != 0) {
+        proc_free(p);
+        return NULL;
+    }
+
+    uint64_t *sp = (uint64_t *)(uintptr_t)p->kstack_top;
+    p->rsp = (uint64_t)(uintptr_t)push_switch_frame(sp, task_start, (uint64_t)(uintptr_t)fn,
+                                                    (uint64_t)(uintptr_t)arg);
+    p->pid = process_next_pid();
+    p->space = vmm_kernel_space();
+    struct process *creator = process_current();
+    p->cpu = cpu_id();
+    p->pinned = creator ? creator->pinned : 0;
+    set_name(p, name);
+    p->state = PROC_READY;
+    return p;
+}
+
+struct process *process_fork(struct process *parent) {
+    if (!parent || !parent->kstack_top) return NULL;
+
+    struct process *child = proc_alloc();
+    if (!child) return NULL;
+
+    vm_space_t *space = vmm_space_fork(parent->space);
+    if (!space) {
+        proc_free(child);
+        return NULL;
+    }
+    if (fpu_fork(parent, child) != 0) {
+        vmm_space_destroy(space);
+        proc_free(child);
+        return NULL;
+    }
+    child->pid = process_next_pid();
+    if (vdso_map(space, child->pid) != 0 || kstack_alloc(child) != 0) {
+        fpu_release(child);
+        vmm_space_destroy(space);
+        proc_free(child);
+        return NULL;
+    }
+
+    /* Ребёнок получает копию кадра syscall родителя и выходит через
+     * fork_child_start с RAX = 0. */
+    struct pt_regs *cf = syscall_regs(child);
+    *cf = *syscall_regs(parent);
+    cf->rax = 0;
+    child->rsp = (uint64_t)(uintptr_t)push_switch_frame((uint64_t *)cf, fork_child_start, 0, 0);
+
+    child->space = space;
+    child->prio = parent->prio;
+    child->cpu = parent->cpu;
+    child->pinned = parent->pinned;
+    set_name(child, parent->name);
+    child->state = PROC_READY;
+    return child;
+}
+
+void process_release(struct process *p) {
+    if (!p || p == process_current()) return;
+    if (p->space && p->space != vmm_kernel_space()) vmm_space_destroy(p->space);
+    fpu_release(p);
+    if (p->kstack) pmm_free_order(p->kstack, KSTACK_ORDER);
+    p->kstack = 0;
+    p->space = NULL;
+    proc_free(p);
 }
 
 uint64_t process_next_pid(void) {
-    return next_pid++;
+    return __atomic_fetch_add(&next_pid, 1, __ATOMIC_RELAXED);
 }
 
 void process_init(void) {
     for (int i = 0; i < PROC_MAX; i++) {
-        procs[i].state = 0;
+        procs[i].state = PROC_FREE;
     }
-    procs[0].pid = 1;
-    procs[0].state = 1;
-    procs[0].rsp = 0;
-    current_proc = &procs[0];
+    struct process *init = proc_alloc();
+    init->pid = process_next_pid();
+    init->space = vmm_kernel_space();
+    init->kstack_top = (uint64_t)(uintptr_t)stack_top;
+    set_name(init, "init");
+    init->state = PROC_RUNNING;
+    process_set_current(init);
 }
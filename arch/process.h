@@ -2,22 +2,70 @@
 #define PROCESS_H
 
 #include <stdint.h>
+#include "vmm.h"
+#include "paging.h"
 
 #define PROC_MAX 64
 
-/* Минимальная структура процесса. */
+/* Стек ядра задачи: 16 KiB (4 фрейма подряд). */
+#define KSTACK_ORDER 2
+#define KSTACK_SIZE  (PAGE_SIZE << KSTACK_ORDER)
+
+#define PROC_NAME_LEN 16
+
+/* Состояния задачи. */
+#define PROC_FREE     0
+#define PROC_RUNNING  1
+#define PROC_ZOMBIE   2
+#define PROC_READY    3   /* в очереди планировщика */
+#define PROC_BLOCKED  4   /* ждёт таймера или события */
+
+/* Задача: процесс пользователя или поток ядра. */
 struct process {
     uint64_t pid;
-    uint64_t rsp;       /* kernel stack для переключения */
-    uint8_t  state;     /* 0=free, 1=running, 2=zombie */
+    uint64_t rsp;       /* сохранённый RSP ядра (switch_to) */
+    uint8_t  state;     /* PROC_* */
+    uint8_t  prio;      /* 0 — высший, см. sched.h */
+    vm_space_t *space;  /* адресное пространство (CR3 + PCID) */
+    uint64_t minor_faults;  /* #PF без выделения памяти (устаревший TLB) */
+    uint64_t major_faults;  /* #PF с выделением и заполнением фрейма */
+    void    *fpu_state;     /* область XSAVE; выделяется при первом использовании FPU */
+    uint64_t kstack;        /* база стека ядра (0 — загрузочный стек) */
+    uint64_t kstack_top;    /* TSS.RSP0, пока задача на CPU */
+    uint64_t cpu_ns;        /* время на CPU */
+    uint64_t run_start;     /* ktime последнего включения */
+    int32_t  preempt_count; /* >0 — вытеснение по таймеру запрещено */
+    int32_t  exit_code;
+    uint32_t cpu;           /* в чью очередь ставится (см. sched.h) */
+    volatile uint8_t on_cpu; /* контекст ещё в регистрах какого-то CPU */
+    uint8_t  pinned;        /* не переносить на другой CPU; наследуется */
+    struct process *next;   /* очередь планировщика или ожидания */
+    char     name[PROC_NAME_LEN];
 };
 
-/* Текущий процесс (NULL = kernel/idle). */
+/* Текущий процесс этого CPU (NULL до process_init). */
 struct process *process_current(void);
+void process_set_current(struct process *p);
+
+/* Процесс в слоте slot таблицы или NULL, если слот свободен. */
+struct process *process_at(int slot);
 
-/* Инициализация: создать процесс 1 (init). */
+/* Инициализация: процесс 1 (init) — это сам kernel_main на загрузочном стеке. */
 void process_init(void);
 
+/* Поток ядра: при первом переключении вызовет fn(arg), по возврату —
+ * sched_exit(0). Состояние ready, в очередь не ставится. CPU и привязку
+ * наследует от создателя. */
+struct process *process_create_kernel(const char *name, void (*fn)(void *), void *arg);
+
+/* Дочерний процесс с copy-on-write копией пространства parent (состояние
+ * ready). Вызывать из syscall: ребёнок вернётся из него в user mode с 0.
+ * NULL, если нет свободного слота или памяти. */
+struct process *process_fork(struct process *parent);
+
+/* Освободить слот, стек ядра и адресное пространство процесса. */
+void process_release(struct process *p);
+
 /* Следующий свободный PID. */
 uint64_t process_next_pid(void);
 
@@ -0,0 +1,23 @@
+#ifndef REGS_H
+#define REGS_H
+
+#include <stdint.h>
+
+/* Регистры прерванного кода на стеке ядра (от младших адресов). Общий кадр
+ * для входа через SYSCALL (syscall.asm) и через IDT (isr.asm): сверху —
+ * кадр iretq, под ним номер вектора (для syscall — номер вызова) и код
+ * ошибки, ниже — регистры. irq_common сохраняет только caller-saved часть
+ * (от r11 и выше): callee-saved сохранят обработчики на C. */
+struct pt_regs {
+    uint64_t r15, r14, r13, r12, rbp, rbx;          /* callee-saved */
+    uint64_t r11, r10, r9, r8, rax, rcx, rdx, rsi, rdi;
+    uint64_t vector;        /* вектор прерывания или номер syscall */
+    uint64_t error_code;    /* 0, если CPU его не кладёт */
+    uint64_t rip, cs, rflags, rsp, ss;
+};
+
+/* Смещения для asm (syscall.asm, isr.asm). */
+#define PT_REGS_RAX     80
+#define PT_REGS_SIZE    176
+
+#endif /* REGS_H */
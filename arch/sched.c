@@ -0,0 +1,435 @@
+#include "sched.h"
+#include "process.h"
+#include "timer.h"
+#include "clock.h"
+#include "gdt.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "irq.h"
+#include "smp.h"
+#include "vmm.h"
+#include <stddef.h>
+
+#define PRIO_IDLE SCHED_PRIO_LEVELS   /* ниже любой очереди */
+
+extern void switch_to(uint64_t *prev_rsp, uint64_t next_rsp);
+
+/* Очередь готовых задач одного CPU. Блокировка держится от выбора задачи
+ * до конца switch_to и снимается уже в новой задаче (sched_tail): пока
+ * контекст prev не сохранён, другой CPU не может его запустить. */
+typedef struct run_queue {
+    spinlock_t lock;
+    struct process *head[SCHED_PRIO_LEVELS];
+    struct process *tail[SCHED_PRIO_LEVELS];
+    uint32_t bitmap;                /* бит i — очередь приоритета i непуста */
+    volatile uint32_t nr_ready;
+    struct process *idle;
+    struct process *prev;           /* снятая с CPU задача, для sched_tail */
+    struct process *dead;           /* завершившаяся; освободит следующая */
+    hrtimer_t quantum;
+    uint64_t switches;
+    uint64_t steals;
+} __attribute__((aligned(64))) run_queue_t;
+
+static run_queue_t rqs[SMP_MAX_CPUS];
+static volatile uint64_t idle_mask = 0;   /* бит cpu — CPU в idle и может красть */
+static int active = 0;
+
+static run_queue_t *this_rq(void) {
+    return &rqs[cpu_id()];
+}
+
+static void rq_push(run_queue_t *rq, struct process *p) {
+    p->next = NULL;
+    if (rq->tail[p->prio]) rq->tail[p->prio]->next = p;
+    else rq->head[p->prio] = p;
+    rq->tail[p->prio] = p;
+    rq->bitmap |= 1u << p->prio;
+    rq->nr_ready++;
+}
+
+/* Снять p, перед которым в очереди стоит before (NULL — p первая). */
+static void rq_unlink(run_queue_t *rq, struct process *p, struct process *before) {
+    unsigned prio = p->prio;
+    if (before) before->next = p->next;
+    else rq->head[prio] = p->next;
+    if (rq->tail[prio] == p) rq->tail[prio] = before;
+    if (!rq->head[prio]) rq->bitmap &= ~(1u << prio);
+    rq->nr_ready--;
+    p->next = NULL;
+}
+
+static struct process *rq_pop(run_queue_t *rq) {
+    if (!rq->bitmap) return NULL;
+    struct process *p = rq->head[__builtin_ctz(rq->bitmap)];
+    rq_unlink(rq, p, NULL);
+    return p;
+}
+
+/* Задачу можно перенести на другой CPU: её контекст сохранён, FPU-состояние
+ * не осталось в регистрах прежнего CPU, и это поток ядра. */
+static int can_migrate(const struct process *p) {
+    return !p->on_cpu && !p->pinned && p->space == vmm_kernel_space() && !fpu_state_live(p);
+}
+
+/* Самая важная из переносимых задач очереди rq. */
+static struct process *rq_take_migratable(run_queue_t *rq) {
+    for (uint32_t bits = rq->bitmap; bits; bits &= bits - 1) {
+        struct process *before = NULL;
+        for (struct process *p = rq->head[__builtin_ctz(bits)]; p; before = p, p = p->next) {
+            if (can_migrate(p)) {
+                rq_unlink(rq, p, before);
+                return p;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Флаг перепланирования — в области CPU: его проверяет и выход из
+ * syscall (syscall.asm). Ставится только своим CPU. */
+static void quantum_expired(hrtimer_t *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    this_cpu()->need_resched = 1;
+}
+
+/* В очереди этого CPU появилась задача: вытеснить текущую, если та менее
+ * важна, или начать делить с ней CPU квантами при равном приоритете.
+ * Под rq->lock. */
+static void check_preempt(run_queue_t *rq) {
+    struct process *cur = process_current();
+    if (!rq->bitmap || !cur) return;
+    unsigned best = (unsigned)__builtin_ctz(rq->bitmap);
+    if (cur == rq->idle || best < cur->prio)
+        this_cpu()->need_resched = 1;
+    else if (best == cur->prio && !hrtimer_active(&rq->quantum))
+        hrtimer_start(&rq->quantum, ktime_get_ns() + SCHED_QUANTUM_NS);
+}
+
+/* Разбудить один простаивающий CPU, кроме except: он заберёт задачу. */
+static void kick_idle(uint32_t except) {
+    /* Парный барьер к idle_loop: либо мы видим его бит, либо он — нашу
+     * задачу в очереди. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t mask = idle_mask & ~(1ull << except) & ~(1ull << cpu_id());
+    if (mask) smp_send_resched((uint32_t)__builtin_ctzll(mask));
+}
+
+void sched_enqueue(struct process *p) {
+    uint32_t cpu = p->cpu;
+    run_queue_t *rq = &rqs[cpu];
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    p->state = PROC_READY;
+    rq_push(rq, p);
+    if (cpu == cpu_id()) check_preempt(rq);
+    spin_unlock(&rq->lock);
+
+    if (active) {
+        /* Чужой CPU сам решит про вытеснение; если p придётся ждать там,
+         * пусть её заберёт простаивающий. */
+        struct process *cur = smp_cpu(cpu)->current;
+        int runs_now = cur == rq->idle || p->prio < cur->prio;
+        if (cpu != cpu_id() && (runs_now || p->prio == cur->prio)) smp_send_resched(cpu);
+        if (!runs_now) kick_idle(cpu);
+    }
+    cpu_irq_restore(flags);
+}
+
+void sched_wake(struct process *p) {
+    uint8_t expected = PROC_BLOCKED;
+    if (p && __atomic_compare_exchange_n(&p->state, &expected, PROC_READY, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        sched_enqueue(p);
+}
+
+void sched_tail(void) {
+    run_queue_t *rq = this_rq();
+    struct process *prev = rq->prev;
+    struct process *dead = rq->dead;
+    rq->prev = NULL;
+    rq->dead = NULL;
+    /* Контекст prev сохранён — теперь его может взять другой CPU. */
+    if (prev) __atomic_store_n(&prev->on_cpu, 0, __ATOMIC_RELEASE);
+    spin_unlock(&rq->lock);
+    if (dead) process_release(dead);
+}
+
+static void context_switch(run_queue_t *rq, struct process *prev, struct process *next) {
+    uint64_t now = ktime_get_ns();
+    prev->cpu_ns += now - prev->run_start;
+    next->run_start = now;
+    rq->switches++;
+
+    next->on_cpu = 1;
+    rq->prev = prev;
+    process_set_current(next);
+    tss_set_rsp0(next->kstack_top);
+    /* Потоки ядра работают в любом пространстве — CR3 не трогаем. */
+    if (next->space != vmm_kernel_space() && next->space != vmm_space_current())
+        vmm_space_switch(next->space);
+    fpu_switch(next);
+
+    switch_to(&prev->rsp, next->rsp);
+    /* Сюда возвращаемся, когда prev снова выбран (возможно, другим CPU). */
+    sched_tail();
+}
+
+/* Выбрать следующую задачу этого CPU и переключиться. Вызывается под
+ * rq->lock с запрещёнными прерываниями; возвращается без блокировки. */
+static void pick_next(run_queue_t *rq) {
+    struct process *prev = process_current();
+    this_cpu()->need_resched = 0;
+
+    /* READY — prev разбудили, пока она засыпала: она уже в очереди. */
+    if (prev->state == PROC_RUNNING && prev != rq->idle) {
+        prev->state = PROC_READY;
+        rq_push(rq, prev);
+    }
+    struct process *next = rq_pop(rq);
+    if (!next) next = rq->idle;
+    next->state = PROC_RUNNING;
+
+    /* Квант нужен, только если есть готовые того же приоритета. */
+    if (next != rq->idle && (rq->bitmap & (1u << next->prio)))
+        hrtimer_start(&rq->quantum, ktime_get_ns() + SCHED_QUANTUM_NS);
+    else
+        hrtimer_cancel(&rq->quantum);
+
+    if (next != prev) context_switch(rq, prev, next);
+    else spin_unlock(&rq->lock);
+}
+
+void schedule(void) {
+    if (!active) return;
+    uint64_t flags = cpu_irq_save();
+    run_queue_t *rq = this_rq();
+    spin_lock(&rq->lock);
+    pick_next(rq);
+    cpu_irq_restore(flags);
+}
+
+void sched_irq_exit(void) {
+    if (!active) return;
+    struct process *cur = process_current();
+    if (this_cpu()->need_resched && cur->preempt_count == 0) schedule();
+}
+
+void preempt_disable(void) {
+    struct process *cur = process_current();
+    if (cur) cur->preempt_count++;
+}
+
+void preempt_enable(void) {
+    struct process *cur = process_current();
+    if (cur && --cur->preempt_count == 0 && active && this_cpu()->need_resched) schedule();
+}
+
+static void resched_ipi(uint8_t vector, void *ctx) {
+    (void)vector;
+    (void)ctx;
+    run_queue_t *rq = this_rq();
+    spin_lock(&rq->lock);
+    check_preempt(rq);
+    spin_unlock(&rq->lock);
+}
+
+static void sleep_expired(hrtimer_t *t, void *ctx) {
+    (void)t;
+    sched_wake((struct process *)ctx);
+}
+
+void sched_sleep_ns(uint64_t ns) {
+    if (!active) {
+        timer_sleep_ns(ns);
+        return;
+    }
+    struct process *cur = process_current();
+    uint64_t now = ktime_get_ns();
+    uint64_t deadline = ns > UINT64_MAX - now ? UINT64_MAX : now + ns;
+    hrtimer_t t;
+    hrtimer_init(&t, sleep_expired, cur);
+
+    uint64_t flags = cpu_irq_save();
+    if (hrtimer_start(&t, deadline) != 0) {
+        /* Куча таймеров полна — ждём без сна. */
+        cpu_irq_restore(flags);
+        timer_sleep_ns(ns);
+        return;
+    }
+    /* Таймер в куче этого CPU и не сработает, пока мы не уйдём с него. */
+    while (hrtimer_active(&t)) {
+        cur->state = PROC_BLOCKED;
+        schedule();
+    }
+    cpu_irq_restore(flags);
+}
+
+void sched_wait(wait_queue_t *wq, int (*cond)(void *), void *arg) {
+    uint64_t flags = cpu_irq_save();
+    while (!cond(arg)) {
+        if (!active) {
+            cpu_wait_irq();
+            continue;
+        }
+        struct process *cur = process_current();
+        spin_lock(&wq->lock);
+        cur->state = PROC_BLOCKED;
+        cur->next = wq->head;
+        wq->head = cur;
+        spin_unlock(&wq->lock);
+
+        if (!cond(arg)) {
+            schedule();
+            continue;
+        }
+        /* Условие выполнилось само: выйти из очереди. Если нас уже
+         * разбудили, мы стоим в очереди CPU — отдаём его штатно. */
+        spin_lock(&wq->lock);
+        uint8_t expected = PROC_BLOCKED;
+        if (__atomic_compare_exchange_n(&cur->state, &expected, PROC_RUNNING, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            struct process **link = &wq->head;
+            while (*link != cur) link = &(*link)->next;
+            *link = cur->next;
+            cur->next = NULL;
+            spin_unlock(&wq->lock);
+        } else {
+            spin_unlock(&wq->lock);
+            schedule();
+        }
+    }
+    cpu_irq_restore(flags);
+}
+
+void sched_wake_all(wait_queue_t *wq) {
+    /* Под блокировкой очереди: ждущий, передумавший спать, не должен
+     * увидеть себя наполовину разбуженным. */
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    struct process *p = wq->head;
+    wq->head = NULL;
+    while (p) {
+        struct process *next = p->next;
+        sched_wake(p);
+        p = next;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void sched_exit(int code) {
+    cpu_irq_save();
+    struct process *cur = process_current();
+    run_queue_t *rq = this_rq();
+    spin_lock(&rq->lock);
+    cur->exit_code = code;
+    cur->state = PROC_ZOMBIE;
+    /* Свой стек освободить нельзя — это сделает sched_tail следующей задачи. */
+    rq->dead = cur;
+    pick_next(rq);
+    for (;;) cpu_halt();
+}
+
+struct process *sched_spawn(const char *name, void (*fn)(void *), void *arg, uint8_t prio) {
+    struct process *p = process_create_kernel(name, fn, arg);
+    if (!p) return NULL;
+    p->prio = prio < SCHED_PRIO_LEVELS ? prio : SCHED_PRIO_LOW;
+    sched_enqueue(p);
+    return p;
+}
+
+/* Забрать готовую задачу у другого CPU в свою очередь. 1 — удалось. */
+static int steal_task(run_queue_t *rq) {
+    uint32_t me = cpu_id();
+    uint32_t n = smp_cpu_count();
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t victim = (me + i) % n;
+        run_queue_t *vq = &rqs[victim];
+        if (!vq->nr_ready) continue;
+
+        spin_lock(&vq->lock);
+        struct process *p = rq_take_migratable(vq);
+        spin_unlock(&vq->lock);
+        if (!p) continue;
+
+        p->cpu = me;
+        spin_lock(&rq->lock);
+        rq_push(rq, p);
+        rq->steals++;
+        spin_unlock(&rq->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static void idle_loop(void *arg) {
+    (void)arg;
+    uint64_t bit = 1ull << cpu_id();
+    for (;;) {
+        __asm__ volatile("cli" ::: "memory");
+        run_queue_t *rq = this_rq();
+        if (rq->bitmap || this_cpu()->need_resched || steal_task(rq)) {
+            schedule();
+            continue;
+        }
+        /* Сначала объявить себя свободным, потом проверить ещё раз: задача,
+         * поставленная в очередь между проверками, не останется без CPU. */
+        __atomic_fetch_or(&idle_mask, bit, __ATOMIC_SEQ_CST);
+        if (!rq->bitmap && !steal_task(rq)) cpu_wait_irq();
+        __atomic_fetch_and(&idle_mask, ~bit, __ATOMIC_SEQ_CST);
+    }
+}
+
+struct process *sched_prepare_cpu(uint32_t cpu) {
+    run_queue_t *rq = &rqs[cpu];
+    if (rq->idle) return rq->idle;
+    struct process *idle = process_create_kernel("idle", idle_loop, NULL);
+    if (!idle) return NULL;
+    idle->prio = PRIO_IDLE;
+    idle->cpu = cpu;
+    idle->pinned = 1;
+    hrtimer_init(&rq->quantum, quantum_expired, rq);
+    rq->idle = idle;
+    return idle;
+}
+
+void sched_start_cpu(void) {
+    run_queue_t *rq = this_rq();
+    struct process *idle = rq->idle;
+    idle->state = PROC_RUNNING;
+    idle->on_cpu = 1;
+    idle->run_start = ktime_get_ns();
+    process_set_current(idle);
+    tss_set_rsp0(idle->kstack_top);
+    idle_loop(NULL);
+    for (;;) cpu_halt();
+}
+
+void sched_init(void) {
+    if (!sched_prepare_cpu(0)) return;
+    irq_register(IPI_RESCHED_VECTOR, resched_ipi, NULL);
+    struct process *cur = process_current();
+    cur->run_start = ktime_get_ns();
+    cur->on_cpu = 1;
+    active = 1;
+}
+
+uint64_t sched_cpu_ns(const struct process *p) {
+    uint64_t ns = p->cpu_ns;
+    if (p->state == PROC_RUNNING) ns += ktime_get_ns() - p->run_start;
+    return ns;
+}
+
+uint64_t sched_switches(void) {
+    uint64_t n = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) n += rqs[cpu].switches;
+    return n;
+}
+
+void sched_get_stats(uint32_t cpu, sched_stats_t *st) {
+    if (!st || cpu >= SMP_MAX_CPUS) return;
+    struct percpu *c = smp_cpu(cpu);
+    st->switches = rqs[cpu].switches;
+    st->steals = rqs[cpu].steals;
+    st->ready = rqs[cpu].nr_ready;
+    st->current = c ? c->current : NULL;
+}
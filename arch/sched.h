@@ -0,0 +1,95 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "spinlock.h"
+
+struct process;
+
+/* Вытесняющий планировщик с приоритетами. У каждого CPU своя очередь
+ * готовых задач: FIFO-очереди по приоритету, непустые отмечены битами в
+ * слове, так что выбор следующей — один tzcnt при любом числе задач. Внутри
+ * приоритета — round-robin с квантом на hrtimer; квант заводится, только
+ * если есть с кем делить CPU. Когда готовых нет, работает idle: она
+ * забирает задачу из очереди занятого CPU, а если красть нечего — hlt.
+ *
+ * Задача разбуженная или созданная ставится в очередь «своего» CPU
+ * (p->cpu); переезжает она только при краже. Потоки пользователя остаются
+ * на своём CPU: их PCID-записи в TLB других CPU никто не сбрасывает. */
+
+#define SCHED_PRIO_LEVELS   32
+#define SCHED_PRIO_DEFAULT  16
+#define SCHED_PRIO_LOW      (SCHED_PRIO_LEVELS - 1)
+#define SCHED_QUANTUM_NS    (10 * 1000000ull)
+
+/* Очередь задач, ждущих события. */
+typedef struct wait_queue {
+    spinlock_t lock;
+    struct process *head;
+} wait_queue_t;
+
+/* Счётчики одного CPU. */
+typedef struct sched_stats {
+    uint64_t switches;     /* переключений контекста */
+    uint64_t steals;       /* задач, забранных у других CPU */
+    uint32_t ready;        /* задач в очереди сейчас */
+    struct process *current;
+} sched_stats_t;
+
+/* Создать idle BSP и запустить планирование. После process_init и
+ * timer_init. */
+void sched_init(void);
+
+/* Idle-задача для CPU cpu: на её стеке AP выходит из трамплина. */
+struct process *sched_prepare_cpu(uint32_t cpu);
+
+/* Начать планирование на AP (текущая задача — его idle). Не возвращается. */
+void sched_start_cpu(void) __attribute__((noreturn));
+
+/* Поставить готовую задачу в очередь её CPU. */
+void sched_enqueue(struct process *p);
+
+/* Поток ядра с приоритетом prio; сразу готов к запуску. NULL при нехватке. */
+struct process *sched_spawn(const char *name, void (*fn)(void *), void *arg, uint8_t prio);
+
+/* Отдать CPU: текущая задача (если она RUNNING) встаёт в конец очереди. */
+void schedule(void);
+
+/* Усыпить текущую задачу на ns наносекунд. */
+void sched_sleep_ns(uint64_t ns);
+
+/* Завершить текущую задачу; ресурсы освобождает следующая. */
+void sched_exit(int code) __attribute__((noreturn));
+
+/* Ждать на wq, пока cond(arg) не станет истинным. Условие проверяется уже
+ * после постановки в очередь, так что пробуждение с другого CPU между
+ * проверкой и сном не теряется. До sched_init — hlt. */
+void sched_wait(wait_queue_t *wq, int (*cond)(void *), void *arg);
+
+/* Разбудить всех ждущих на wq. Можно из обработчика прерывания. */
+void sched_wake_all(wait_queue_t *wq);
+
+/* Сделать BLOCKED-задачу готовой. */
+void sched_wake(struct process *p);
+
+/* Запрет вытеснения текущей задачи по таймеру; блокироваться можно. */
+void preempt_disable(void);
+void preempt_enable(void);
+
+/* Вызывается из irq_dispatch после EOI: переключиться, если нужно. */
+void sched_irq_exit(void);
+
+/* После switch_to в новой задаче: снять блокировку очереди, освободить
+ * завершившуюся задачу. */
+void sched_tail(void);
+
+/* Время задачи на CPU, включая текущий запуск. */
+uint64_t sched_cpu_ns(const struct process *p);
+
+/* Переключений контекста с загрузки (все CPU). */
+uint64_t sched_switches(void);
+
+/* Счётчики CPU cpu. */
+void sched_get_stats(uint32_t cpu, sched_stats_t *st);
+
+#endif /* SCHED_H */
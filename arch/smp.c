@@ -0,0 +1,146 @@
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "clock.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "gdt.h"
+#include "idt.h"
+#include "process.h"
+#include "sched.h"
+#include "timer.h"
+#include "vmm.h"
+#include "vga.h"
+#include "string.h"
+
+#define INIT_DELAY_NS     (10 * NSEC_PER_MSEC)
+#define SIPI_DELAY_NS     (200 * NSEC_PER_USEC)
+#define AP_TIMEOUT_NS     (100 * NSEC_PER_MSEC)
+
+/* Трамплин (ap_boot.asm) и то, что он читает при старте очередного AP. */
+extern uint8_t ap_trampoline_start[], ap_trampoline_end[];
+volatile uint64_t ap_boot_efer;
+volatile uint64_t ap_boot_cr3;
+volatile uint64_t ap_boot_stack;
+volatile uint32_t ap_boot_cpu;
+
+_Static_assert(offsetof(struct percpu, kernel_rsp) == PERCPU_KERNEL_RSP, "syscall.asm");
+_Static_assert(offsetof(struct percpu, user_rsp) == PERCPU_USER_RSP, "syscall.asm");
+_Static_assert(offsetof(struct percpu, need_resched) == PERCPU_NEED_RESCHED, "syscall.asm");
+
+static struct percpu cpus[SMP_MAX_CPUS];
+static volatile uint32_t cpu_count = 1;
+
+/* Регистры, которые AP копирует у BSP. */
+static uint64_t bsp_cr4;
+static uint64_t bsp_pat;
+
+void ap_main(uint32_t id);
+
+void smp_init_bsp(void) {
+    struct percpu *c = &cpus[0];
+    c->self = c;
+    c->id = 0;
+    c->online = 1;
+    wrmsr(MSR_GS_BASE, (uint64_t)(uintptr_t)c);
+    wrmsr(MSR_KERNEL_GS_BASE, 0);   /* база GS пользователя */
+}
+
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+struct percpu *smp_cpu(uint32_t id) {
+    if (id >= cpu_count) return NULL;
+    return &cpus[id];
+}
+
+void smp_send_resched(uint32_t id) {
+    if (id < cpu_count && cpus[id].online)
+        lapic_send_ipi(cpus[id].apic_id, ICR_FIXED | IPI_RESCHED_VECTOR);
+}
+
+static void delay_ns(uint64_t ns) {
+    uint64_t t0 = ktime_get_ns();
+    while (ktime_get_ns() - t0 < ns) cpu_pause();
+}
+
+/* Точка входа AP из ap_boot.asm: стек — idle-задача CPU id. */
+void ap_main(uint32_t id) {
+    struct percpu *c = &cpus[id];
+    wrmsr(MSR_GS_BASE, (uint64_t)(uintptr_t)c);
+    wrmsr(MSR_KERNEL_GS_BASE, 0);
+
+    /* PGE/PCIDE/OSFXSR и PAT — как у BSP: таблицы страниц общие. */
+    write_cr4(bsp_cr4);
+    write_cr0(read_cr0() | CR0_WP);
+    if (cpu_has(CPU_FEAT_PAT)) {
+        wbinvd();
+        wrmsr(MSR_PAT, bsp_pat);
+    }
+    fpu_init_cpu();
+    gdt_init_cpu();
+    idt_load();
+    lapic_init_cpu();
+    timer_init_cpu();
+
+    c->online = 1;
+    sched_start_cpu();
+}
+
+/* Разбудить AP apic_id как CPU id. 0 — он вышел на связь. */
+static int ap_start(uint32_t id, uint32_t apic_id) {
+    struct percpu *c = &cpus[id];
+    struct process *idle = sched_prepare_cpu(id);
+    if (!idle) return -1;
+
+    c->self = c;
+    c->id = id;
+    c->apic_id = apic_id;
+    c->current = idle;
+    c->online = 0;
+    ap_boot_stack = idle->kstack_top;
+    ap_boot_cpu = id;
+
+    /* INIT, 10 ms, затем SIPI дважды (второй — если первый потерялся). */
+    lapic_send_ipi(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    delay_ns(INIT_DELAY_NS);
+    for (int i = 0; i < 2 && !c->online; i++) {
+        lapic_send_ipi(apic_id, ICR_STARTUP | (SMP_TRAMPOLINE >> 12));
+        delay_ns(SIPI_DELAY_NS);
+    }
+
+    uint64_t t0 = ktime_get_ns();
+    while (!c->online && ktime_get_ns() - t0 < AP_TIMEOUT_NS) cpu_pause();
+    return c->online ? 0 : -1;
+}
+
+void smp_init(void) {
+    const acpi_madt_info_t *madt = acpi_get_madt();
+    if (!madt || !apic_enabled() || !clock_tsc_hz()) return;
+
+    cpus[0].apic_id = lapic_id();
+    memcpy((void *)(uintptr_t)SMP_TRAMPOLINE, ap_trampoline_start,
+           (size_t)(ap_trampoline_end - ap_trampoline_start));
+    ap_boot_efer = rdmsr(MSR_EFER) & ~(uint64_t)EFER_LMA;
+    ap_boot_cr3 = read_cr3() & ~0xFFFull;   /* без PCID: у AP он ещё выключен */
+    bsp_cr4 = read_cr4();
+    bsp_pat = cpu_has(CPU_FEAT_PAT) ? rdmsr(MSR_PAT) : 0;
+
+    for (uint32_t i = 0; i < madt->cpu_count && cpu_count < SMP_MAX_CPUS; i++) {
+        uint32_t apic_id = madt->cpu_apic_id[i];
+        if (apic_id == cpus[0].apic_id) continue;
+        uint32_t id = cpu_count;
+        /* Считаем CPU до ответа: ap_main читает cpus[id], а планировщик
+         * должен видеть его очередь, как только AP включит прерывания. */
+        cpu_count = id + 1;
+        if (ap_start(id, apic_id) != 0) {
+            /* AP может проснуться позже и взять тот же стек — дальше не идём. */
+            vga_print("smp: cpu with apic id ");
+            vga_print_uint64(apic_id);
+            vga_println(" did not start");
+            cpu_count = id;
+            break;
+        }
+    }
+}
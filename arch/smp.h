@@ -0,0 +1,72 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct process;
+
+/* Многопроцессорность. BSP находит остальные процессоры (AP) в MADT и будит
+ * каждый последовательностью INIT-SIPI-SIPI: AP начинает в real mode с
+ * трамплина по адресу SMP_TRAMPOLINE, проходит в long mode и попадает в
+ * ap_main на стеке своей idle-задачи.
+ *
+ * У каждого CPU своя область struct percpu; её адрес — база GS, а первое
+ * поле указывает на саму область, поэтому this_cpu() — одно чтение gs:0.
+ * В user mode база GS пользовательская: входы в ядро из ring 3 (syscall,
+ * прерывания) делают swapgs, и область снова в GS, а её адрес — в
+ * MSR_KERNEL_GS_BASE, пока CPU в user mode.
+ * Номер CPU (id) — индекс в массивах по CPU у планировщика, таймеров, FPU. */
+
+#define SMP_MAX_CPUS        16
+#define SMP_TRAMPOLINE      0x8000    /* ниже 1 MiB; вектор SIPI — номер страницы */
+
+#define IPI_RESCHED_VECTOR  0xFD      /* «посмотри в свою очередь» */
+
+/* Смещения полей, которые читает syscall.asm (проверяются в smp.c). */
+#define PERCPU_KERNEL_RSP   16
+#define PERCPU_USER_RSP     24
+#define PERCPU_NEED_RESCHED 32
+
+struct percpu {
+    struct percpu *self;          /* gs:0 */
+    struct process *current;      /* задача на этом CPU */
+    uint64_t kernel_rsp;          /* вершина стека ядра текущей задачи (= TSS.RSP0) */
+    uint64_t user_rsp;            /* RSP пользователя на время входа в syscall */
+    volatile uint32_t need_resched; /* перед возвратом в user mode — schedule() */
+    uint32_t id;                  /* 0 — BSP, дальше по порядку запуска */
+    uint32_t apic_id;
+    uint64_t *gdt;                /* своя GDT: у каждого CPU свой TSS */
+    uint8_t  *tss;
+    volatile int online;
+} __attribute__((aligned(64)));
+
+static inline struct percpu *this_cpu(void) {
+    struct percpu *c;
+    __asm__ volatile("mov %%gs:0, %0" : "=r"(c));
+    return c;
+}
+
+static inline uint32_t cpu_id(void) {
+    uint32_t id;
+    __asm__ volatile("movl %%gs:%c1, %0" : "=r"(id) : "i"(offsetof(struct percpu, id)));
+    return id;
+}
+
+/* Область BSP и база GS. Сразу после cpu_init — до всего, что зовёт
+ * process_current. */
+void smp_init_bsp(void);
+
+/* Запустить AP из MADT. После sched_init; без APIC ничего не делает. */
+void smp_init(void);
+
+/* Процессоров в работе (не меньше 1). */
+uint32_t smp_cpu_count(void);
+
+/* Область CPU id или NULL, если такого нет. */
+struct percpu *smp_cpu(uint32_t id);
+
+/* IPI_RESCHED_VECTOR на CPU id. */
+void smp_send_resched(uint32_t id);
+
+#endif /* SMP_H */
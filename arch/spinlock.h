@@ -0,0 +1,42 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+/* Спинлок test-and-test-and-set: ждущий крутится на чтении, не занимая
+ * линию кэша записью. Данные, которые трогает и обработчик прерывания,
+ * защищаются вариантом _irqsave. */
+
+typedef struct spinlock {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock(spinlock_t *l) {
+    while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (l->locked) cpu_pause();
+    }
+}
+
+static inline int spin_trylock(spinlock_t *l) {
+    return !l->locked && !__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_unlock(spinlock_t *l) {
+    __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *l) {
+    uint64_t flags = cpu_irq_save();
+    spin_lock(l);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *l, uint64_t flags) {
+    spin_unlock(l);
+    cpu_irq_restore(flags);
+}
+
+#endif /* SPINLOCK_H */
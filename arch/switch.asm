@@ -0,0 +1,41 @@
+; switch.asm - переключение контекста задач ядра
+
+BITS 64
+
+SECTION .text
+
+global switch_to
+global task_start
+extern sched_tail
+extern sched_exit
+
+; void switch_to(uint64_t *prev_rsp, uint64_t next_rsp)
+; Caller-saved регистры сохранил вызывающий (C ABI), здесь — только
+; callee-saved. Вызывается с запрещёнными прерываниями; RFLAGS новой
+; задачи восстановит её собственный cpu_irq_restore (или sti в task_start).
+switch_to:
+    push rbx
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+    mov [rdi], rsp
+    mov rsp, rsi
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    pop rbx
+    ret
+
+; Первое включение потока ядра: R12 = функция, R13 = аргумент
+; (см. process_create_kernel). Стек выровнен на 16.
+task_start:
+    call sched_tail
+    sti
+    mov rdi, r13
+    call r12
+    xor edi, edi
+    call sched_exit                  ; не возвращается
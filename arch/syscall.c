@@ -3,23 +3,53 @@
 #include "keyboard.h"
 #include "process.h"
 #include "cpu.h"
+#include "clock.h"
+#include "timer.h"
+#include "sched.h"
 #include <stdint.h>
+#include <stddef.h>
 
 #define MAX_WRITE_LEN 4096
 
+_Static_assert(sizeof(struct pt_regs) == PT_REGS_SIZE, "regs.h");
+_Static_assert(offsetof(struct pt_regs, rax) == PT_REGS_RAX, "regs.h");
+
+struct pt_regs *syscall_regs(const struct process *p) {
+    return (struct pt_regs *)(uintptr_t)(p->kstack_top - sizeof(struct pt_regs));
+}
+
 static int64_t do_write(uint64_t fd, const void *buf, uint64_t len) {
     if (len > MAX_WRITE_LEN)
         return -EINVAL;
 
     if (fd == 1 || fd == 2) {
-        const char *p = (const char *)buf;
-        for (uint64_t i = 0; i < len; i++)
-            vga_putc(p[i]);
+        vga_write((const char *)buf, len);
         return (int64_t)len;
     }
     return -EBADF;
 }
 
+/* Все сегменты выводятся за одну отрисовку консоли. */
+static int64_t do_writev(uint64_t fd, const struct iovec *iov, uint64_t iovcnt) {
+    if (iovcnt > IOV_MAX)
+        return -EINVAL;
+    if (fd != 1 && fd != 2)
+        return -EBADF;
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+        if (iov[i].iov_len > MAX_WRITE_LEN || total > MAX_WRITE_LEN)
+            return -EINVAL;
+    }
+
+    vga_begin();
+    for (uint64_t i = 0; i < iovcnt; i++)
+        vga_write((const char *)iov[i].iov_base, iov[i].iov_len);
+    vga_end();
+    return (int64_t)total;
+}
+
 static int64_t do_read(uint64_t fd, void *buf, uint64_t count) {
     if (fd != 0)
         return -EBADF;
@@ -39,28 +69,149 @@ static int64_t do_read(uint64_t fd, void *buf, uint64_t count) {
     return (int64_t)n;
 }
 
-uint64_t syscall_dispatch(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3,
-                          uint64_t a4, uint64_t a5) {
-    (void)a4;
-    (void)a5;
+static int64_t do_clock_gettime(uint64_t clk, struct timespec *ts) {
+    uint64_t ns;
+    if (!ts || clock_get_ns((int)clk, &ns) != 0)
+        return -EINVAL;
+    ts->tv_sec = (int64_t)(ns / NSEC_PER_SEC);
+    ts->tv_nsec = (int64_t)(ns % NSEC_PER_SEC);
+    return 0;
+}
 
-    switch (num) {
-    case SYS_getpid: {
-        struct process *p = process_current();
-        return p ? p->pid : 0;
+static int64_t do_nanosleep(const struct timespec *req, struct timespec *rem) {
+    if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= (int64_t)NSEC_PER_SEC)
+        return -EINVAL;
+    /* ~292 года в нс; дальше считаем «навсегда». */
+    uint64_t ns = (uint64_t)req->tv_sec >= UINT64_MAX / NSEC_PER_SEC
+                      ? UINT64_MAX
+                      : (uint64_t)req->tv_sec * NSEC_PER_SEC + (uint64_t)req->tv_nsec;
+    sched_sleep_ns(ns);
+    /* Сигналов нет — сон не прерывается, остаток всегда 0. */
+    if (rem) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
     }
+    return 0;
+}
 
-    case SYS_write:
-        return (uint64_t)(int64_t)do_write(a1, (const void *)a2, a3);
+static int64_t do_gettimeofday(struct timeval *tv, void *tz) {
+    if (tv) {
+        uint64_t ns = ktime_get_real_ns();
+        tv->tv_sec = (int64_t)(ns / NSEC_PER_SEC);
+        tv->tv_usec = (int64_t)(ns % NSEC_PER_SEC / NSEC_PER_USEC);
+    }
+    /* Часовых поясов нет: struct timezone всегда нулевая. */
+    if (tz) *(uint64_t *)tz = 0;
+    return 0;
+}
 
-    case SYS_read:
-        return (uint64_t)(int64_t)do_read(a1, (void *)a2, a3);
+/* --- Таблица вызовов. Аргументы — из кадра: RDI, RSI, RDX, R10, R8, R9. --- */
 
-    case SYS_exit:
-        cpu_halt();
-        return 0;  /* не достигается */
+static int64_t sys_getpid(const struct pt_regs *regs) {
+    (void)regs;
+    struct process *p = process_current();
+    return p ? (int64_t)p->pid : 0;
+}
 
-    default:
-        return (uint64_t)(int64_t)-EINVAL;
-    }
+static int64_t sys_fork(const struct pt_regs *regs) {
+    (void)regs;
+    /* Ребёнок получает copy-on-write копию пространства. */
+    struct process *child = process_fork(process_current());
+    if (!child) return -EAGAIN;
+    sched_enqueue(child);
+    return (int64_t)child->pid;
+}
+
+static int64_t sys_write(const struct pt_regs *regs) {
+    return do_write(regs->rdi, (const void *)regs->rsi, regs->rdx);
+}
+
+static int64_t sys_writev(const struct pt_regs *regs) {
+    return do_writev(regs->rdi, (const struct iovec *)regs->rsi, regs->rdx);
+}
+
+static int64_t sys_read(const struct pt_regs *regs) {
+    return do_read(regs->rdi, (void *)regs->rsi, regs->rdx);
+}
+
+static int64_t sys_clock_gettime(const struct pt_regs *regs) {
+    return do_clock_gettime(regs->rdi, (struct timespec *)regs->rsi);
+}
+
+static int64_t sys_gettimeofday(const struct pt_regs *regs) {
+    return do_gettimeofday((struct timeval *)regs->rdi, (void *)regs->rsi);
+}
+
+static int64_t sys_nanosleep(const struct pt_regs *regs) {
+    return do_nanosleep((const struct timespec *)regs->rdi, (struct timespec *)regs->rsi);
+}
+
+static int64_t sys_sched_yield(const struct pt_regs *regs) {
+    (void)regs;
+    schedule();
+    return 0;
+}
+
+static int64_t sys_exit(const struct pt_regs *regs) {
+    sched_exit((int)regs->rdi);
+}
+
+typedef struct syscall_desc {
+    const char *name;
+    int64_t (*fn)(const struct pt_regs *regs);
+} syscall_desc_t;
+
+static const syscall_desc_t syscall_table[SYSCALL_MAX] = {
+    [SYS_read]          = { "read", sys_read },
+    [SYS_write]         = { "write", sys_write },
+    [SYS_writev]        = { "writev", sys_writev },
+    [SYS_sched_yield]   = { "sched_yield", sys_sched_yield },
+    [SYS_nanosleep]     = { "nanosleep", sys_nanosleep },
+    [SYS_getpid]        = { "getpid", sys_getpid },
+    [SYS_fork]          = { "fork", sys_fork },
+    [SYS_exit]          = { "exit", sys_exit },
+    [SYS_gettimeofday]  = { "gettimeofday", sys_gettimeofday },
+    [SYS_clock_gettime] = { "clock_gettime", sys_clock_gettime },
+};
+
+/* Счётчики вызовов: общие для всех CPU, обновляются атомарно. */
+typedef struct syscall_counters {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t hist[SYSCALL_HIST_BUCKETS];
+} syscall_counters_t;
+
+static syscall_counters_t counters[SYSCALL_MAX];
+
+/* Бакет гистограммы: [2^(b+SHIFT-1), 2^(b+SHIFT)) тактов, крайние — открытые. */
+static unsigned hist_bucket(uint64_t cycles) {
+    uint64_t v = cycles >> SYSCALL_HIST_SHIFT;
+    unsigned b = v ? 64 - (unsigned)__builtin_clzll(v) : 0;
+    return b < SYSCALL_HIST_BUCKETS ? b : SYSCALL_HIST_BUCKETS - 1;
+}
+
+/* exit не возвращается — у него только счётчик вызовов. */
+int64_t syscall_dispatch(struct pt_regs *regs) {
+    uint64_t num = regs->vector;
+    if (num >= SYSCALL_MAX || !syscall_table[num].fn)
+        return -EINVAL;
+
+    syscall_counters_t *c = &counters[num];
+    __atomic_fetch_add(&c->calls, 1, __ATOMIC_RELAXED);
+    uint64_t t0 = rdtsc();
+    int64_t ret = syscall_table[num].fn(regs);
+    uint64_t dt = rdtsc() - t0;
+    __atomic_fetch_add(&c->cycles, dt, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->hist[hist_bucket(dt)], 1, __ATOMIC_RELAXED);
+    return ret;
+}
+
+int syscall_get_stats(uint64_t num, syscall_stats_t *st) {
+    if (num >= SYSCALL_MAX || !syscall_table[num].fn || !st) return -1;
+    const syscall_counters_t *c = &counters[num];
+    st->name = syscall_table[num].name;
+    st->calls = c->calls;
+    st->cycles = c->cycles;
+    for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) st->hist[b] = c->hist[b];
+    return 0;
 }
@@ -2,19 +2,65 @@
 #define SYSCALL_H
 
 #include <stdint.h>
+#include "regs.h"
+
+struct process;
 
 /* Номера syscall (Linux-совместимые). */
 #define SYS_exit   60
 #define SYS_read   63
 #define SYS_write  64
+#define SYS_writev 66
 #define SYS_getpid 39
+#define SYS_fork   57
+#define SYS_sched_yield 24
+#define SYS_nanosleep 35
+#define SYS_gettimeofday 96
+#define SYS_clock_gettime 228
+
+/* Размер таблицы вызовов: номера не меньше — -EINVAL. */
+#define SYSCALL_MAX 256
 
 /* Коды ошибок. */
 #define EINVAL 22
 #define EBADF  9
+#define EAGAIN 11
+
+/* Элемент вектора для writev. */
+struct iovec {
+    void    *iov_base;
+    uint64_t iov_len;
+};
+
+#define IOV_MAX 1024
+
+/* Задержка вызовов — гистограмма по степеням двойки в тактах TSC:
+ * бакет 0 — меньше 2^SYSCALL_HIST_SHIFT, бакет b — [2^(b+SHIFT-1), 2^(b+SHIFT)),
+ * последний — всё, что дольше. */
+#define SYSCALL_HIST_BUCKETS 16
+#define SYSCALL_HIST_SHIFT   7
+
+typedef struct syscall_stats {
+    const char *name;
+    uint64_t calls;
+    uint64_t cycles;        /* сумма по завершившимся вызовам */
+    uint64_t hist[SYSCALL_HIST_BUCKETS];
+} syscall_stats_t;
+
+/* Диспетчер: вызывается из syscall_entry с кадром struct pt_regs (regs.h)
+ * на вершине стека ядра задачи; для fork ребёнок получает его копию.
+ * Номер вызова — regs->vector, аргументы — RDI, RSI, RDX, R10, R8, R9. */
+int64_t syscall_dispatch(struct pt_regs *regs);
+
+/* Счётчики вызова num; -1, если в таблице его нет. */
+int syscall_get_stats(uint64_t num, syscall_stats_t *st);
+
+/* Кадр входа из user mode задачи p — на вершине её стека ядра. */
+struct pt_regs *syscall_regs(const struct process *p);
 
-/* Диспетчер: вызывается из syscall_entry. */
-uint64_t syscall_dispatch(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3,
-                          uint64_t a4, uint64_t a5);
+/* Перейти в ring 3 на rip со стеком rsp (syscall.asm). Стек ядра текущей
+ * задачи начинается заново; из user mode задача вернётся только через
+ * syscall или прерывание. */
+void syscall_enter_user(uint64_t rip, uint64_t rsp) __attribute__((noreturn));
 
 #endif /* SYSCALL_H */
@@ -0,0 +1,291 @@
+#include "timer.h"
+#include "clock.h"
+#include "apic.h"
+#include "pic.h"
+#include "pit.h"
+#include "irq.h"
+#include "cpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include <stddef.h>
+
+#define LVT_TIMER_TSC_DEADLINE  (2u << 17)
+#define LAPIC_DIV_16            0x3
+#define LAPIC_CALIBRATE_NS      (10 * NSEC_PER_MSEC)
+
+/* Ближе этого срок LAPIC/PIT не заводим: прерывание пришло бы раньше,
+ * чем закончится сам обработчик. */
+#define MIN_DELTA_NS            2000
+
+/* Дальше этого срок TSC-deadline не заводим: ns_to_cycles от огромного
+ * delta переполняется, и дедлайн оказывается в прошлом. Дальний таймер
+ * доходит промежуточными прерываниями. */
+#define MAX_DELTA_NS            (4 * NSEC_PER_SEC)
+
+enum { SRC_NONE, SRC_TSC_DEADLINE, SRC_LAPIC, SRC_PIT };
+
+static const char *const source_names[] = { "none", "tsc-deadline", "lapic", "pit" };
+
+static int source = SRC_NONE;
+static uint64_t lapic_mult = 0;    /* тиков LAPIC на нс, << 32 */
+
+/* Таймеры одного CPU. Аппаратный таймер у каждого CPU свой, поэтому таймер
+ * срабатывает на том CPU, где его запустили. */
+typedef struct timer_base {
+    spinlock_t lock;
+    hrtimer_t *heap[HRTIMER_MAX];
+    uint32_t n;
+    int in_expiry;                 /* обработчик сам заведёт таймер в конце */
+    uint64_t interrupts;
+    uint64_t expired;
+} timer_base_t;
+
+static timer_base_t bases[SMP_MAX_CPUS];
+
+/* --- Min-куча по expires --- */
+
+static void heap_set(timer_base_t *b, uint32_t i, hrtimer_t *t) {
+    b->heap[i] = t;
+    t->slot = (int32_t)i;
+}
+
+static void sift_up(timer_base_t *b, uint32_t i) {
+    hrtimer_t *t = b->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (b->heap[parent]->expires <= t->expires) break;
+        heap_set(b, i, b->heap[parent]);
+        i = parent;
+    }
+    heap_set(b, i, t);
+}
+
+static void sift_down(timer_base_t *b, uint32_t i) {
+    hrtimer_t *t = b->heap[i];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= b->n) break;
+        if (child + 1 < b->n && b->heap[child + 1]->expires < b->heap[child]->expires) child++;
+        if (t->expires <= b->heap[child]->expires) break;
+        heap_set(b, i, b->heap[child]);
+        i = child;
+    }
+    heap_set(b, i, t);
+}
+
+static void heap_remove(timer_base_t *b, uint32_t i) {
+    b->heap[i]->slot = -1;
+    if (i == --b->n) return;
+    /* Последний элемент на место удалённого — он может уйти в любую сторону. */
+    hrtimer_t *moved = b->heap[b->n];
+    heap_set(b, i, moved);
+    sift_down(b, i);
+    sift_up(b, (uint32_t)moved->slot);
+}
+
+/* Снять t с кучи того CPU, где он запущен. 1 — был запущен. */
+static int timer_detach(hrtimer_t *t) {
+    while (t->slot >= 0) {
+        timer_base_t *b = &bases[t->cpu];
+        spin_lock(&b->lock);
+        if (t->slot >= 0 && &bases[t->cpu] == b) {
+            heap_remove(b, (uint32_t)t->slot);
+            spin_unlock(&b->lock);
+            return 1;
+        }
+        spin_unlock(&b->lock);
+    }
+    return 0;
+}
+
+/* --- Аппаратный таймер --- */
+
+static void program_next(timer_base_t *b) {
+    if (!b->n) {
+        /* Таймеров нет — и прерываний нет. Выстрел PIT отменить нельзя,
+         * он придёт один раз и ничего не найдёт. */
+        if (source == SRC_TSC_DEADLINE) wrmsr(MSR_TSC_DEADLINE, 0);
+        else if (source == SRC_LAPIC) lapic_write(LAPIC_TIMER_INIT, 0);
+        return;
+    }
+
+    uint64_t now = ktime_get_ns();
+    uint64_t expires = b->heap[0]->expires;
+    uint64_t delta = expires > now ? expires - now : 0;
+
+    switch (source) {
+    case SRC_TSC_DEADLINE: {
+        /* От текущего TSC, а не от абсолютного ktime: ошибка округления
+         * масштабируется с интервалом, а не с временем с загрузки. Срок в
+         * прошлом срабатывает сразу. */
+        if (delta > MAX_DELTA_NS) delta = MAX_DELTA_NS;
+        uint64_t tsc = rdtsc();
+        uint64_t cycles = ns_to_cycles(delta) + 1;
+        wrmsr(MSR_TSC_DEADLINE, tsc > UINT64_MAX - cycles ? UINT64_MAX : tsc + cycles);
+        break;
+    }
+    case SRC_LAPIC: {
+        if (delta < MIN_DELTA_NS) delta = MIN_DELTA_NS;
+        uint64_t count = (uint64_t)(((unsigned __int128)delta * lapic_mult) >> 32) + 1;
+        /* Дальний срок — промежуточное прерывание и повторный завод. */
+        if (count > 0xFFFFFFFFull) count = 0xFFFFFFFFull;
+        lapic_write(LAPIC_TIMER_INIT, (uint32_t)count);
+        break;
+    }
+    case SRC_PIT: {
+        uint64_t us = (delta + NSEC_PER_USEC - 1) / NSEC_PER_USEC;
+        if (us * NSEC_PER_USEC < MIN_DELTA_NS) us = MIN_DELTA_NS / NSEC_PER_USEC;
+        if (us > PIT_MAX_US) us = PIT_MAX_US;
+        pit_oneshot((uint32_t)us);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void timer_irq(uint8_t vector, void *ctx) {
+    (void)vector;
+    (void)ctx;
+    timer_base_t *b = &bases[cpu_id()];
+    b->interrupts++;
+
+    spin_lock(&b->lock);
+    b->in_expiry = 1;
+    uint64_t now = ktime_get_ns();
+    while (b->n && b->heap[0]->expires <= now) {
+        hrtimer_t *t = b->heap[0];
+        heap_remove(b, 0);
+        b->expired++;
+        /* Без блокировки: обработчик может запустить таймер снова. */
+        spin_unlock(&b->lock);
+        t->fn(t, t->ctx);
+        spin_lock(&b->lock);
+        now = ktime_get_ns();
+    }
+    b->in_expiry = 0;
+    program_next(b);
+    spin_unlock(&b->lock);
+}
+
+/* Частота таймера LAPIC (делитель 16) по TSC. */
+static uint64_t lapic_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFFu);
+    uint64_t t0 = ktime_get_ns();
+    while (ktime_get_ns() - t0 < LAPIC_CALIBRATE_NS) {}
+    uint32_t left = lapic_read(LAPIC_TIMER_CUR);
+    uint64_t dt = ktime_get_ns() - t0;
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    return (uint64_t)(0xFFFFFFFFu - left) * NSEC_PER_SEC / dt;
+}
+
+void timer_init(void) {
+    if (!clock_tsc_hz()) return;
+
+    if (apic_enabled()) {
+        if (irq_register(TIMER_VECTOR, timer_irq, NULL) != 0) return;
+        if (cpu_has(CPU_FEAT_TSC_DEADLINE)) {
+            lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR | LVT_TIMER_TSC_DEADLINE);
+            /* Запись LVT должна стать видимой до первой записи в MSR. */
+            __asm__ volatile("mfence" ::: "memory");
+            source = SRC_TSC_DEADLINE;
+        } else {
+            uint64_t hz = lapic_calibrate();
+            if (!hz) return;
+            lapic_mult = (hz << 32) / NSEC_PER_SEC;
+            lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR);
+            source = SRC_LAPIC;
+        }
+        return;
+    }
+
+    if (irq_register(PIC_VECTOR_BASE + 0, timer_irq, NULL) != 0) return;
+    pic_set_mask(0, 0);
+    source = SRC_PIT;
+}
+
+void timer_init_cpu(void) {
+    /* Частота таймера LAPIC у всех CPU одна — калибровка BSP подходит. */
+    if (source == SRC_TSC_DEADLINE) {
+        lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR | LVT_TIMER_TSC_DEADLINE);
+        __asm__ volatile("mfence" ::: "memory");
+    } else if (source == SRC_LAPIC) {
+        lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+        lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR);
+    }
+}
+
+const char *timer_source_name(void) {
+    return source_names[source];
+}
+
+void hrtimer_init(hrtimer_t *t, hrtimer_fn_t fn, void *ctx) {
+    t->expires = 0;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->slot = -1;
+    t->cpu = 0;
+}
+
+int hrtimer_start(hrtimer_t *t, uint64_t expires) {
+    uint64_t flags = cpu_irq_save();
+    timer_detach(t);
+    timer_base_t *b = &bases[cpu_id()];
+    spin_lock(&b->lock);
+    if (b->n == HRTIMER_MAX) {
+        spin_unlock_irqrestore(&b->lock, flags);
+        return -1;
+    }
+    t->expires = expires;
+    t->cpu = cpu_id();
+    heap_set(b, b->n++, t);
+    sift_up(b, (uint32_t)t->slot);
+    /* Аппарат перезаводим, только если сменился ближайший срок. */
+    if (t->slot == 0 && !b->in_expiry) program_next(b);
+    spin_unlock_irqrestore(&b->lock, flags);
+    return 0;
+}
+
+int hrtimer_cancel(hrtimer_t *t) {
+    uint64_t flags = cpu_irq_save();
+    /* Снятый первым таймер оставляет выстрел впустую: обработчик просто
+     * заведёт следующий срок. */
+    int was = timer_detach(t);
+    cpu_irq_restore(flags);
+    return was;
+}
+
+static void sleep_wake(hrtimer_t *t, void *ctx) {
+    (void)t;
+    *(volatile int *)ctx = 1;
+}
+
+void timer_sleep_ns(uint64_t ns) {
+    uint64_t now = ktime_get_ns();
+    uint64_t deadline = ns > UINT64_MAX - now ? UINT64_MAX : now + ns;
+    volatile int done = 0;
+    hrtimer_t t;
+    hrtimer_init(&t, sleep_wake, (void *)&done);
+
+    uint64_t flags = cpu_irq_save();
+    if (source != SRC_NONE && hrtimer_start(&t, deadline) == 0) {
+        while (!done) cpu_wait_irq();
+    } else {
+        while (ktime_get_ns() < deadline) __asm__ volatile("pause");
+    }
+    cpu_irq_restore(flags);
+}
+
+uint64_t timer_interrupts(void) {
+    uint64_t n = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) n += bases[cpu].interrupts;
+    return n;
+}
+
+uint64_t timer_expired(void) {
+    uint64_t n = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) n += bases[cpu].expired;
+    return n;
+}
@@ -0,0 +1,59 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/* Таймеры высокого разрешения без периодического тика. Ожидающие таймеры
+ * лежат в min-куче по сроку; аппаратный таймер заводится одним выстрелом
+ * только на ближайший срок: TSC-deadline LAPIC, иначе LAPIC one-shot,
+ * без LAPIC — канал 0 PIT. Пока таймеров нет, прерываний нет. Куча у каждого
+ * CPU своя: таймер срабатывает на том CPU, где запущен. */
+
+#define TIMER_VECTOR  0xEF     /* вектор таймера LAPIC */
+#define HRTIMER_MAX   256      /* одновременно запущенных таймеров */
+
+struct hrtimer;
+
+/* Вызывается из прерывания с запрещёнными прерываниями. Может снова
+ * запустить тот же таймер. */
+typedef void (*hrtimer_fn_t)(struct hrtimer *t, void *ctx);
+
+typedef struct hrtimer {
+    uint64_t expires;     /* срок, ktime_get_ns */
+    hrtimer_fn_t fn;
+    void *ctx;
+    int32_t slot;         /* позиция в куче; -1 — не запущен */
+    uint32_t cpu;         /* чья куча */
+} hrtimer_t;
+
+/* Выбрать источник прерываний и откалибровать его. После clock_init и
+ * apic_init. */
+void timer_init(void);
+
+/* Таймер LAPIC AP в режиме, выбранном timer_init. */
+void timer_init_cpu(void);
+
+/* "tsc-deadline", "lapic", "pit" или "none". */
+const char *timer_source_name(void);
+
+void hrtimer_init(hrtimer_t *t, hrtimer_fn_t fn, void *ctx);
+
+/* Запустить (или перезапустить) на абсолютный срок expires на этом CPU. -1,
+ * если куча заполнена. Один таймер не запускают с двух CPU одновременно. */
+int hrtimer_start(hrtimer_t *t, uint64_t expires);
+
+/* Снять таймер. 1 — был запущен, 0 — нет. */
+int hrtimer_cancel(hrtimer_t *t);
+
+static inline int hrtimer_active(const hrtimer_t *t) {
+    return t->slot >= 0;
+}
+
+/* Спать ns наносекунд, пока CPU стоит на hlt. */
+void timer_sleep_ns(uint64_t ns);
+
+/* Прерываний таймера и сработавших таймеров с загрузки. */
+uint64_t timer_interrupts(void);
+uint64_t timer_expired(void);
+
+#endif /* TIMER_H */
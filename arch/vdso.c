@@ -0,0 +1,93 @@
+#include "vdso.h"
+#include "clock.h"
+#include "pmm.h"
+#include "string.h"
+#include <stddef.h>
+
+_Static_assert(offsetof(struct vdso_data, seq) == VDSO_DATA_SEQ, "vdso_code.asm");
+_Static_assert(offsetof(struct vdso_data, clock_mode) == VDSO_DATA_MODE, "vdso_code.asm");
+_Static_assert(offsetof(struct vdso_data, tsc_base) == VDSO_DATA_TSC_BASE, "vdso_code.asm");
+_Static_assert(offsetof(struct vdso_data, ns_mult) == VDSO_DATA_NS_MULT, "vdso_code.asm");
+_Static_assert(offsetof(struct vdso_data, real_base_ns) == VDSO_DATA_REAL_BASE, "vdso_code.asm");
+_Static_assert(CLOCK_NS_SHIFT == 32, "vdso_code.asm");
+
+/* Код vDSO (vdso_code.asm). */
+extern uint8_t vdso_start[], vdso_end[];
+
+static uint64_t data_frame = 0;
+static uint64_t code_frame = 0;
+
+/* Запись под seqlock: читатель, увидевший нечётный или изменившийся seq,
+ * повторяет чтение. Писатель один — vdso_update_clock. */
+static void data_write_begin(struct vdso_data *d) {
+    d->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void data_write_end(struct vdso_data *d) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    d->seq++;
+}
+
+void vdso_update_clock(void) {
+    if (!data_frame) return;
+    struct vdso_data *d = (struct vdso_data *)(uintptr_t)data_frame;
+    clock_params_t p;
+    clock_get_params(&p);
+
+    data_write_begin(d);
+    d->tsc_base = p.tsc_base;
+    d->ns_mult = p.ns_mult;
+    d->real_base_ns = p.real_base_ns;
+    d->clock_mode = p.ns_mult ? VDSO_CLOCK_TSC : VDSO_CLOCK_NONE;
+    data_write_end(d);
+}
+
+void vdso_init(void) {
+    data_frame = pmm_alloc_frame();
+    code_frame = pmm_alloc_frame();
+    if (!data_frame || !code_frame) {
+        if (data_frame) pmm_free_frame(data_frame);
+        if (code_frame) pmm_free_frame(code_frame);
+        data_frame = code_frame = 0;
+        return;
+    }
+    memset((void *)(uintptr_t)data_frame, 0, PAGE_SIZE);
+    memset((void *)(uintptr_t)code_frame, 0, PAGE_SIZE);
+    memcpy((void *)(uintptr_t)code_frame, vdso_start, (size_t)(vdso_end - vdso_start));
+    vdso_update_clock();
+}
+
+/* Общая страница: у каждого отображения своя ссылка на фрейм. */
+static int map_shared(vm_space_t *space, uint64_t virt, uint64_t frame, uint32_t flags) {
+    if (vmm_translate(space, virt, 0) == 0) return 0;   /* уже есть после fork */
+    if (pmm_frame_get(frame) != 0) return -1;
+    if (vmm_map(space, virt, frame, PAGE_SIZE, flags | VMM_USER) != 0) {
+        pmm_frame_put(frame);
+        return -1;
+    }
+    return 0;
+}
+
+int vdso_map(vm_space_t *space, uint64_t pid) {
+    if (!data_frame) return 0;   /* без vDSO процессы работают через syscall */
+    if (map_shared(space, VDSO_DATA, data_frame, VMM_NOEXEC) != 0 ||
+        map_shared(space, VDSO_CODE, code_frame, 0) != 0)
+        return -1;
+
+    /* Страница процесса после fork — общая с родителем: заменить. */
+    uint64_t old;
+    if (vmm_translate(space, VDSO_PROC, &old) == 0) {
+        vmm_unmap(space, VDSO_PROC, PAGE_SIZE);
+        pmm_frame_put(old & ~(uint64_t)(PAGE_SIZE - 1));
+    }
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) return -1;
+    memset((void *)(uintptr_t)frame, 0, PAGE_SIZE);
+    ((struct vdso_proc *)(uintptr_t)frame)->pid = pid;
+    if (vmm_map(space, VDSO_PROC, frame, PAGE_SIZE, VMM_USER | VMM_NOEXEC) != 0) {
+        pmm_free_frame(frame);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+#include "vmm.h"
+#include "paging.h"
+
+/* vDSO: страницы в конце пространства пользователя, через которые
+ * clock_gettime, gettimeofday и getpid работают без входа в ядро.
+ *  VDSO_DATA — общая для всех страница данных (struct vdso_data), только
+ *              чтение; время по TSC с параметрами под seqlock;
+ *  VDSO_PROC — своя у каждого процесса (struct vdso_proc): pid;
+ *  VDSO_CODE — код (arch/vdso_code.asm), общий, чтение и исполнение.
+ * Функции вызываются по адресам из таблицы входов в начале VDSO_CODE, ABI —
+ * System V; если TSC нет, они сами делают обычный syscall. */
+
+#define VDSO_BASE   (USER_SPACE_END - 4 * PAGE_SIZE)   /* последняя страница — пустая */
+#define VDSO_DATA   VDSO_BASE
+#define VDSO_PROC   (VDSO_BASE + PAGE_SIZE)
+#define VDSO_CODE   (VDSO_BASE + 2 * PAGE_SIZE)
+
+/* Таблица входов: по 8 байт на функцию. */
+#define VDSO_CLOCK_GETTIME  (VDSO_CODE + 0)     /* int (int clk, struct timespec *) */
+#define VDSO_GETTIMEOFDAY   (VDSO_CODE + 8)     /* int (struct timeval *, void *tz) */
+#define VDSO_GETPID         (VDSO_CODE + 16)    /* int64_t (void) */
+
+#define VDSO_CLOCK_NONE     0   /* только через syscall */
+#define VDSO_CLOCK_TSC      1
+
+/* Смещения полей для vdso_code.asm (проверяются в vdso.c). */
+#define VDSO_DATA_SEQ        0
+#define VDSO_DATA_MODE       4
+#define VDSO_DATA_TSC_BASE   8
+#define VDSO_DATA_NS_MULT    16
+#define VDSO_DATA_REAL_BASE  24
+
+struct vdso_data {
+    volatile uint32_t seq;      /* нечётный — идёт запись */
+    uint32_t clock_mode;        /* VDSO_CLOCK_* */
+    uint64_t tsc_base;          /* ns = (tsc - tsc_base) * ns_mult >> 32 */
+    uint64_t ns_mult;
+    uint64_t real_base_ns;      /* CLOCK_REALTIME в момент tsc_base */
+};
+
+struct vdso_proc {
+    uint64_t pid;
+};
+
+/* Страницы данных и кода. После clock_init и pmm. */
+void vdso_init(void);
+
+/* Отобразить vDSO в space для процесса pid. Общие страницы, оставшиеся от
+ * fork, сохраняются, страница процесса всегда создаётся заново. */
+int vdso_map(vm_space_t *space, uint64_t pid);
+
+/* Переписать параметры времени из clock (под seqlock). */
+void vdso_update_clock(void);
+
+#endif /* VDSO_H */
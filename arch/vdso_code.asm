@@ -0,0 +1,140 @@
+; vdso_code.asm - код vDSO: время и pid без входа в ядро
+;
+; vdso.c копирует блок vdso_start..vdso_end в страницу VDSO_CODE; данные
+; лежат на две (VDSO_DATA) и одну (VDSO_PROC) страницы ниже, и код
+; обращается к ним только относительно RIP. Функции — по ABI System V,
+; вызываются через таблицу входов в начале страницы (vdso.h).
+;
+; Время: ns = (rdtsc - tsc_base) * ns_mult >> 32, как ktime_get_ns. Поля
+; struct vdso_data читаются под seqlock: нечётный seq — ядро пишет, seq,
+; изменившийся за время чтения, — читаем заново.
+
+BITS 64
+
+SECTION .text
+
+global vdso_start
+global vdso_end
+
+%define PAGE_SIZE           4096
+%define DATA                (vdso_start - 2 * PAGE_SIZE)
+%define PROC                (vdso_start - PAGE_SIZE)
+
+; struct vdso_data (vdso.h)
+%define D_SEQ               0
+%define D_MODE              4
+%define D_TSC_BASE          8
+%define D_NS_MULT           16
+%define D_REAL_BASE         24
+
+%define CLOCK_REALTIME      0
+%define CLOCK_MONOTONIC     1
+%define CLOCK_MONOTONIC_RAW 4
+%define CLOCK_BOOTTIME      7
+
+%define SYS_gettimeofday    96
+%define SYS_clock_gettime   228
+
+%define NSEC_PER_SEC        1000000000
+%define NSEC_PER_USEC       1000
+
+vdso_start:
+    jmp near vdso_clock_gettime
+    align 8
+    jmp near vdso_gettimeofday
+    align 8
+    jmp near vdso_getpid
+    align 8
+
+; RAX = наносекунды часов; EDI = 0 — CLOCK_REALTIME, иначе монотонные.
+; CF = 1, если TSC не годится и нужен syscall. Портит RCX, RDX, R8.
+vdso_read_ns:
+.retry:
+    mov r8d, [rel DATA + D_SEQ]
+    test r8d, 1
+    jnz .busy
+    cmp dword [rel DATA + D_MODE], 0
+    je .no_tsc
+    lfence                          ; rdtsc не раньше чтения seq
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    sub rax, [rel DATA + D_TSC_BASE]
+    mul qword [rel DATA + D_NS_MULT]
+    shrd rax, rdx, 32
+    test edi, edi
+    jnz .check
+    add rax, [rel DATA + D_REAL_BASE]
+.check:
+    cmp r8d, [rel DATA + D_SEQ]
+    jne .retry
+    clc
+    ret
+.busy:
+    pause
+    jmp .retry
+.no_tsc:
+    stc
+    ret
+
+; int clock_gettime(int clk, struct timespec *ts)
+vdso_clock_gettime:
+    cmp edi, CLOCK_REALTIME
+    je .read
+    cmp edi, CLOCK_MONOTONIC
+    je .read
+    cmp edi, CLOCK_MONOTONIC_RAW
+    je .read
+    cmp edi, CLOCK_BOOTTIME
+    jne .syscall                    ; неизвестные часы — ошибку вернёт ядро
+.read:
+    call vdso_read_ns
+    jc .syscall
+    xor edx, edx
+    mov ecx, NSEC_PER_SEC
+    div rcx
+    mov [rsi], rax                  ; tv_sec
+    mov [rsi + 8], rdx              ; tv_nsec
+    xor eax, eax
+    ret
+.syscall:
+    mov eax, SYS_clock_gettime
+    syscall
+    ret
+
+; int gettimeofday(struct timeval *tv, void *tz)
+vdso_gettimeofday:
+    mov r9, rdi                     ; tv
+    xor edi, edi                    ; CLOCK_REALTIME
+    call vdso_read_ns
+    mov rdi, r9
+    jc .syscall
+    test rdi, rdi
+    jz .tz
+    xor edx, edx
+    mov ecx, NSEC_PER_SEC
+    div rcx
+    mov [rdi], rax                  ; tv_sec
+    mov rax, rdx
+    xor edx, edx
+    mov ecx, NSEC_PER_USEC
+    div rcx
+    mov [rdi + 8], rax              ; tv_usec
+.tz:
+    test rsi, rsi
+    jz .done
+    mov qword [rsi], 0              ; часовых поясов нет
+.done:
+    xor eax, eax
+    ret
+.syscall:
+    mov eax, SYS_gettimeofday
+    syscall
+    ret
+
+; int64_t getpid(void)
+vdso_getpid:
+    mov rax, [rel PROC]
+    ret
+
+vdso_end:
@@ -0,0 +1,117 @@
+; ap_boot.asm - старт AP (application processor) после INIT-SIPI-SIPI
+;
+; smp_init копирует блок ap_trampoline_start..ap_trampoline_end на адрес
+; SMP_TRAMPOLINE (0x8000) и шлёт SIPI с вектором 0x08: AP начинает в real mode
+; с CS:IP = 0800:0000. Дальше:
+;  - 16 бит: своя GDT трамплина, protected mode;
+;  - 32 бита: PAE, загрузочный PML4 (identity 4 GiB, без NX), EFER как у BSP,
+;    paging — и дальний переход в 64-битный сегмент;
+;  - 64 бита (уже в .text ядра): CR3 ядра, стек idle-задачи, ap_main(cpu).
+; Код трамплина адресуется только разностями меток — он не зависит от того,
+; где лежит в образе ядра.
+
+BITS 16
+
+SECTION .text
+
+global ap_trampoline_start
+global ap_trampoline_end
+extern pml4
+extern ap_boot_efer
+extern ap_boot_cr3
+extern ap_boot_stack
+extern ap_boot_cpu
+extern ap_main
+
+%define TRAMPOLINE      0x8000
+%define T(label)        (TRAMPOLINE + (label) - ap_trampoline_start)
+
+%define CR0_PE          0x00000001
+%define CR0_NW          0x20000000
+%define CR0_CD          0x40000000
+%define CR0_PG          0x80000000
+%define CR4_PAE         0x00000020
+%define MSR_EFER        0xC0000080
+
+%define SEL_CODE32      0x08
+%define SEL_DATA        0x10
+%define SEL_CODE64      0x18
+
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [T(tramp_gdt_desc)]
+    mov eax, cr0
+    or eax, CR0_PE
+    mov cr0, eax
+    jmp dword SEL_CODE32:T(ap_pm32)
+
+BITS 32
+ap_pm32:
+    mov ax, SEL_DATA
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    mov eax, cr4
+    or eax, CR4_PAE
+    mov cr4, eax
+
+    ; Загрузочные таблицы лежат ниже 4 GiB и отображают и трамплин, и ядро.
+    mov eax, pml4
+    mov cr3, eax
+
+    ; LME и NXE (в таблицах ядра есть NX) — из EFER BSP.
+    mov ecx, MSR_EFER
+    mov eax, [ap_boot_efer]
+    xor edx, edx
+    wrmsr
+
+    ; После INIT кэш выключен (CD, NW) — включаем вместе с paging.
+    mov eax, cr0
+    and eax, ~(CR0_CD | CR0_NW)
+    or eax, CR0_PG | CR0_PE
+    mov cr0, eax
+
+    jmp SEL_CODE64:ap_long_entry
+
+align 8
+tramp_gdt:
+    dq 0x0000000000000000       ; null
+    dq 0x00CF9A000000FFFF       ; 0x08 code 32
+    dq 0x00CF92000000FFFF       ; 0x10 data
+    dq 0x00209A0000000000       ; 0x18 code 64
+tramp_gdt_end:
+
+tramp_gdt_desc:
+    dw tramp_gdt_end - tramp_gdt - 1
+    dd T(tramp_gdt)
+
+ap_trampoline_end:
+
+; Дальше — обычный код ядра по своему адресу. Трамплин копируется заново
+; для каждого AP, поэтому GDT трамплина нужна только до gdt_init_cpu.
+BITS 64
+ap_long_entry:
+    mov ax, SEL_DATA
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    xor eax, eax
+    mov fs, ax
+    mov gs, ax
+
+    ; Таблицы ядра: прямое отображение с NX, трамплин в нём не исполним —
+    ; поэтому CR3 меняем только здесь.
+    mov rax, [rel ap_boot_cr3]
+    mov cr3, rax
+    mov rsp, [rel ap_boot_stack]
+    xor ebp, ebp
+    mov edi, [rel ap_boot_cpu]
+    call ap_main                    ; не возвращается
+.halt:
+    cli
+    hlt
+    jmp .halt
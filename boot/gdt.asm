@@ -4,15 +4,18 @@
 ;   0x00 - null
 ;   0x08 - kernel code (DPL 0)
 ;   0x10 - kernel data (DPL 0)
-;   0x18 - user code (DPL 3)
-;   0x20 - user data (DPL 3)
+;   0x18 - user data (DPL 3)
+;   0x20 - user code (DPL 3)
 ;   0x28 - TSS
+; Данные пользователя перед кодом: SYSRET берёт SS = STAR[63:48] + 8 и
+; CS = STAR[63:48] + 16 (см. syscall_init в gdt.c).
 
 BITS 32
 
 SECTION .data
 align 8
 
+global gdt64
 global gdt64_descriptor
 global tss64
 global tss_descriptor
@@ -37,10 +40,10 @@ gdt64:
     dq 0x00209A0000000000       ; 0x08
     ; kernel data: type=0x92
     dq 0x0000920000000000       ; 0x10
-    ; user code: type=0xFA (DPL=3)
-    dq 0x0020FA0000000000       ; 0x18
     ; user data: type=0xF2 (DPL=3)
-    dq 0x0000F20000000000       ; 0x20
+    dq 0x0000F20000000000       ; 0x18
+    ; user code: type=0xFA (DPL=3)
+    dq 0x0020FA0000000000       ; 0x20
     ; TSS descriptor (16 bytes) — база заполняется в gdt_init()
 tss_descriptor:
     dw 103                      ; limit 15:0
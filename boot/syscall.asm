@@ -2,53 +2,138 @@
 ;
 ; При SYSCALL: RCX=user RIP, R11=user RFLAGS. Стек не переключается — делаем вручную.
 ; Аргументы: RAX=номер, RDI,RSI,RDX,R10,R8,R9 (R10 вместо RCX в ABI).
+;
+; Всё состояние входа — в области CPU (struct percpu, smp.h), до которой
+; доступ через GS после swapgs: глобальных ячеек нет, поэтому вход годится
+; для любого числа CPU. FMASK (gdt.c) снимает IF, TF, DF, NT и AC: до
+; сохранения RSP пользователя в кадр ничто не вклинится — ни прерывание, ни
+; #DB пошагового режима, который иначе пришёл бы в ring 0 до swapgs.
 
 BITS 64
 
 SECTION .text
 
 global syscall_entry
+global syscall_return
+global syscall_enter_user
+global fork_child_start
 extern syscall_dispatch
-extern tss64
+extern schedule
+extern sched_tail
 
-; Временное сохранение user RSP (однопроцессорно)
-SECTION .bss
-align 8
-user_rsp_save: resq 1
+; Поля struct percpu (smp.h).
+%define PERCPU_KERNEL_RSP   16
+%define PERCPU_USER_RSP     24
+%define PERCPU_NEED_RESCHED 32
 
-SECTION .text
+; Селекторы пользователя из gdt.asm с RPL 3.
+%define USER_DS     0x1B
+%define USER_CS     0x23
 
-syscall_entry:
-    ; Сохраняем user RSP (SYSCALL не переключает стек)
-    mov [rel user_rsp_save], rsp
+%define PT_REGS_RAX 80          ; struct pt_regs (regs.h)
+%define RFLAGS_USER 0x202       ; IF и всегда установленный бит 1
 
-    ; Переключаемся на kernel stack из TSS.RSP0 (offset 4)
-    mov rsp, [rel tss64 + 4]
+; Регистры в порядке struct pt_regs: после них RSP указывает на кадр.
+%macro PUSH_REGS 0
+    push rdi
+    push rsi
+    push rdx
+    push rcx
+    push rax
+    push r8
+    push r9
+    push r10
+    push r11
+    push rbx
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+%endmacro
 
-    ; Сохраняем user context на kernel stack (RCX=RIP, R11=RFLAGS — сохранил CPU)
-    push qword [rel user_rsp_save]   ; user RSP
-    push r11                         ; user RFLAGS
-    push rcx                         ; user RIP
+%macro POP_REGS 0
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    pop rbx
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rax
+    pop rcx
+    pop rdx
+    pop rsi
+    pop rdi
+%endmacro
 
-    ; Выравнивание стека до 16 байт (System V ABI) перед call
-    ; Сейчас: 3 pushes = 24 байта. RSP должен быть 16-align перед call.
-    ; После 3 push: rsp % 16 = 8. Ещё один push -> 32, rsp%16=0.
-    push rax                         ; syscall number (сохраняем, align станет 0)
+syscall_entry:
+    swapgs
+    mov [gs:PERCPU_USER_RSP], rsp
+    mov rsp, [gs:PERCPU_KERNEL_RSP]
 
-    ; Аргументы уже в RDI,RSI,RDX,R10,R8,R9. syscall_dispatch(num, ...)
-    ; RAX = номер, остальное по ABI.
-    mov rdi, rax                     ; 1-й arg: syscall number
-    ; RSI,RDX,RCX,R8,R9 — аргументы syscall (R10->RCX для 4-го, но C ABI: RDI,RSI,RDX,RCX,R8,R9)
-    ; SYSCALL сохраняет всё кроме RCX,R11. R10 уже содержит 4-й аргумент user.
-    mov rcx, r10                     ; 4-й arg в RCX
+    ; Кадр struct pt_regs как у прерывания из ring 3 — по нему fork строит
+    ; возврат ребёнка, а выход может уйти и через iretq.
+    push USER_DS                     ; ss
+    push qword [gs:PERCPU_USER_RSP]  ; rsp
+    push r11                         ; rflags
+    push USER_CS                     ; cs
+    push rcx                         ; rip
+    push 0                           ; error_code
+    push rax                         ; номер syscall; 22 слова — стек выровнен на 16
+    PUSH_REGS
+    sti
 
+    ; syscall_dispatch(regs): номер и аргументы — из кадра.
+    mov rdi, rsp
     call syscall_dispatch
+    mov [rsp + PT_REGS_RAX], rax
+
+; Возврат в user mode по кадру на вершине стека ядра. Быстрый путь — когда
+; перепланировать не нужно: регистры из кадра и SYSRET. Иначе сначала
+; schedule() с включёнными прерываниями и повторная проверка.
+syscall_return:
+    cli
+    cmp dword [gs:PERCPU_NEED_RESCHED], 0
+    jne .work
+
+    POP_REGS
+    add rsp, 16                      ; vector, error_code
+    mov rcx, [rsp]                   ; user RIP
+    mov r11, [rsp + 16]              ; user RFLAGS
+    mov rsp, [rsp + 24]              ; user RSP — дальше стек ядра не трогаем
+    swapgs
+    ; RCX=RIP, R11=RFLAGS, RAX=return value. 64-битный SYSRET.
+    o64 sysret
+
+.work:
+    sti
+    call schedule
+    jmp syscall_return
 
-    ; Возврат: RAX = результат. Восстанавливаем user context.
-    pop rbx                          ; syscall number (discard)
-    pop rcx                          ; user RIP
-    pop r11                          ; user RFLAGS
-    pop rsp                          ; user RSP — переключаемся обратно на user stack
+; void syscall_enter_user(uint64_t rip, uint64_t rsp): первый переход задачи
+; в ring 3. Стек ядра начинается заново с кадра, как будто задача вернулась
+; из syscall; регистры пользователя обнулены.
+syscall_enter_user:
+    cli
+    mov rsp, [gs:PERCPU_KERNEL_RSP]
+    push USER_DS
+    push rsi
+    push RFLAGS_USER
+    push USER_CS
+    push rdi
+    push 0                           ; error_code
+    push 0                           ; vector
+%rep 15
+    push 0
+%endrep
+    jmp syscall_return
 
-    ; RCX=RIP, R11=RFLAGS, RAX=return value. SYSRET.
-    sysret
+; Первое включение ребёнка fork: switch_to вернулся сюда, RSP указывает на
+; копию кадра родителя (RAX в ней уже 0).
+fork_child_start:
+    call sched_tail
+    jmp syscall_return
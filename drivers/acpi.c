@@ -0,0 +1,205 @@
+#include "acpi.h"
+#include "multiboot2.h"
+#include "string.h"
+#include <stddef.h>
+
+/* Таблицы лежат ниже 4 GiB или в RAM — и то и другое в прямом отображении,
+ * так что физический адрес используется как указатель. */
+
+#define BIOS_AREA_START 0xE0000
+#define BIOS_AREA_END   0x100000
+
+#define MADT_LAPIC           0
+#define MADT_IOAPIC          1
+#define MADT_OVERRIDE        2
+#define MADT_LAPIC_OVERRIDE  5
+#define MADT_X2APIC          9
+
+#define MADT_PCAT_COMPAT     0x1   /* флаг MADT: есть пара 8259 */
+#define MADT_CPU_ENABLED     0x1
+
+typedef struct acpi_rsdp {
+    char     signature[8];
+    uint8_t  checksum;
+    char     oem_id[6];
+    uint8_t  revision;
+    uint32_t rsdt_addr;
+    /* ACPI 2.0+ */
+    uint32_t length;
+    uint64_t xsdt_addr;
+    uint8_t  ext_checksum;
+    uint8_t  reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+typedef struct acpi_madt {
+    acpi_sdt_header_t header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+/* Поля FADT, нужные ядру. */
+#define FADT_PM_TMR_BLK     76
+#define FADT_FLAGS          112
+#define FADT_X_PM_TMR_BLK   208    /* Generic Address Structure, 12 байт */
+#define FADT_TMR_VAL_EXT    (1u << 8)
+#define GAS_SYSTEM_IO       1
+
+static const acpi_sdt_header_t *root = NULL;   /* XSDT или RSDT */
+static int root_is_xsdt = 0;
+static acpi_madt_info_t madt_info;
+static int madt_valid = 0;
+
+static int checksum_ok(const void *p, uint32_t len) {
+    const uint8_t *b = p;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) sum += b[i];
+    return sum == 0;
+}
+
+static const acpi_rsdp_t *rsdp_valid(const acpi_rsdp_t *r) {
+    if (memcmp(r->signature, "RSD PTR ", 8) != 0) return NULL;
+    if (!checksum_ok(r, 20)) return NULL;
+    if (r->revision >= 2 && !checksum_ok(r, r->length)) return NULL;
+    return r;
+}
+
+static const acpi_rsdp_t *find_rsdp(void) {
+    uint64_t addr;
+    if (multiboot2_get_rsdp(&addr) == 0) {
+        const acpi_rsdp_t *r = rsdp_valid((const acpi_rsdp_t *)(uintptr_t)addr);
+        if (r) return r;
+    }
+    /* Старые загрузчики: RSDP выровнен на 16 байт в области BIOS. */
+    for (uint64_t a = BIOS_AREA_START; a < BIOS_AREA_END; a += 16) {
+        const acpi_rsdp_t *r = rsdp_valid((const acpi_rsdp_t *)(uintptr_t)a);
+        if (r) return r;
+    }
+    return NULL;
+}
+
+const acpi_sdt_header_t *acpi_find_table(const char *sig) {
+    if (!root) return NULL;
+    uint32_t entry = root_is_xsdt ? 8 : 4;
+    uint32_t n = (root->length - sizeof(*root)) / entry;
+    const uint8_t *entries = (const uint8_t *)(root + 1);
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t addr;
+        if (root_is_xsdt) memcpy(&addr, entries + i * 8, 8);
+        else {
+            uint32_t a32;
+            memcpy(&a32, entries + i * 4, 4);
+            addr = a32;
+        }
+        const acpi_sdt_header_t *h = (const acpi_sdt_header_t *)(uintptr_t)addr;
+        if (h && memcmp(h->signature, sig, 4) == 0 && checksum_ok(h, h->length))
+            return h;
+    }
+    return NULL;
+}
+
+static void parse_madt(const acpi_madt_t *madt) {
+    acpi_madt_info_t *m = &madt_info;
+    memset(m, 0, sizeof(*m));
+    m->lapic_addr = madt->lapic_addr;
+    m->has_8259 = (madt->flags & MADT_PCAT_COMPAT) != 0;
+
+    const uint8_t *p = (const uint8_t *)(madt + 1);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+    while (p + 2 <= end && p[1] >= 2 && p + p[1] <= end) {
+        uint8_t type = p[0];
+        uint32_t flags;
+        switch (type) {
+        case MADT_LAPIC:
+            /* processor uid(1), apic id(1), flags(4) */
+            memcpy(&flags, p + 4, 4);
+            if ((flags & MADT_CPU_ENABLED) && m->cpu_count < ACPI_MAX_CPUS)
+                m->cpu_apic_id[m->cpu_count++] = p[3];
+            break;
+        case MADT_X2APIC: {
+            /* reserved(2), x2apic id(4), flags(4), uid(4) */
+            uint32_t id;
+            memcpy(&id, p + 4, 4);
+            memcpy(&flags, p + 8, 4);
+            if ((flags & MADT_CPU_ENABLED) && m->cpu_count < ACPI_MAX_CPUS)
+                m->cpu_apic_id[m->cpu_count++] = id;
+            break;
+        }
+        case MADT_IOAPIC:
+            /* id(1), reserved(1), addr(4), gsi base(4) */
+            if (m->ioapic_count < ACPI_MAX_IOAPICS) {
+                acpi_ioapic_t *io = &m->ioapics[m->ioapic_count++];
+                uint32_t addr;
+                io->id = p[2];
+                memcpy(&addr, p + 4, 4);
+                memcpy(&io->gsi_base, p + 8, 4);
+                io->addr = addr;
+            }
+            break;
+        case MADT_OVERRIDE:
+            /* bus(1), source(1), gsi(4), flags(2) */
+            if (m->override_count < ACPI_MAX_OVERRIDES) {
+                acpi_override_t *o = &m->overrides[m->override_count++];
+                o->source = p[3];
+                memcpy(&o->gsi, p + 4, 4);
+                memcpy(&o->flags, p + 8, 2);
+            }
+            break;
+        case MADT_LAPIC_OVERRIDE:
+            /* reserved(2), 64-битный адрес LAPIC */
+            memcpy(&m->lapic_addr, p + 4, 8);
+            break;
+        default:
+            break;
+        }
+        p += p[1];
+    }
+    madt_valid = 1;
+}
+
+int acpi_init(void) {
+    const acpi_rsdp_t *rsdp = find_rsdp();
+    if (!rsdp) return -1;
+
+    const acpi_sdt_header_t *h = NULL;
+    if (rsdp->revision >= 2 && rsdp->xsdt_addr) {
+        h = (const acpi_sdt_header_t *)(uintptr_t)rsdp->xsdt_addr;
+        if (memcmp(h->signature, "XSDT", 4) == 0 && checksum_ok(h, h->length)) {
+            root = h;
+            root_is_xsdt = 1;
+        }
+    }
+    if (!root) {
+        h = (const acpi_sdt_header_t *)(uintptr_t)rsdp->rsdt_addr;
+        if (memcmp(h->signature, "RSDT", 4) != 0 || !checksum_ok(h, h->length)) return -1;
+        root = h;
+    }
+
+    const acpi_sdt_header_t *madt = acpi_find_table("APIC");
+    if (madt) parse_madt((const acpi_madt_t *)madt);
+    return 0;
+}
+
+int acpi_pm_timer(uint16_t *port, int *bits) {
+    const acpi_sdt_header_t *fadt = acpi_find_table("FACP");
+    if (!fadt || fadt->length < FADT_FLAGS + 4) return -1;
+    const uint8_t *f = (const uint8_t *)fadt;
+
+    uint32_t blk, flags;
+    memcpy(&blk, f + FADT_PM_TMR_BLK, 4);
+    memcpy(&flags, f + FADT_FLAGS, 4);
+    if (!blk && fadt->length >= FADT_X_PM_TMR_BLK + 12 && f[FADT_X_PM_TMR_BLK] == GAS_SYSTEM_IO) {
+        uint64_t addr;
+        memcpy(&addr, f + FADT_X_PM_TMR_BLK + 4, 8);
+        blk = (uint32_t)addr;
+    }
+    if (!blk || blk > 0xFFFF) return -1;
+
+    if (port) *port = (uint16_t)blk;
+    if (bits) *bits = (flags & FADT_TMR_VAL_EXT) ? 32 : 24;
+    return 0;
+}
+
+const acpi_madt_info_t *acpi_get_madt(void) {
+    return madt_valid ? &madt_info : NULL;
+}
@@ -0,0 +1,68 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+/* Таблицы ACPI: RSDP из тега multiboot2 (или поиском в BIOS-области),
+ * дальше XSDT/RSDT. Из MADT берутся процессоры и контроллеры прерываний. */
+
+#define ACPI_MAX_CPUS       64
+#define ACPI_MAX_IOAPICS    8
+#define ACPI_MAX_OVERRIDES  16
+
+/* Флаги MPS INTI (поле flags у Interrupt Source Override). */
+#define ACPI_INTI_POLARITY_MASK  0x3
+#define ACPI_INTI_ACTIVE_LOW     0x3
+#define ACPI_INTI_TRIGGER_MASK   0xC
+#define ACPI_INTI_LEVEL          0xC
+
+typedef struct acpi_sdt_header {
+    char     signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem_id[6];
+    char     oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+typedef struct acpi_ioapic {
+    uint8_t  id;
+    uint64_t addr;
+    uint32_t gsi_base;
+} acpi_ioapic_t;
+
+/* ISA IRQ source подключён к GSI gsi (а не к GSI == source). */
+typedef struct acpi_override {
+    uint8_t  source;
+    uint32_t gsi;
+    uint16_t flags;
+} acpi_override_t;
+
+typedef struct acpi_madt_info {
+    uint64_t lapic_addr;
+    int      has_8259;
+    uint32_t cpu_count;
+    uint32_t cpu_apic_id[ACPI_MAX_CPUS];   /* только включённые процессоры */
+    uint32_t ioapic_count;
+    acpi_ioapic_t ioapics[ACPI_MAX_IOAPICS];
+    uint32_t override_count;
+    acpi_override_t overrides[ACPI_MAX_OVERRIDES];
+} acpi_madt_info_t;
+
+/* Найти RSDP и разобрать MADT. -1, если ACPI нет. */
+int acpi_init(void);
+
+/* Таблица по сигнатуре ("APIC", "HPET", ...) с верной контрольной суммой. */
+const acpi_sdt_header_t *acpi_find_table(const char *sig);
+
+/* Порт ACPI PM timer (3.579545 МГц) из FADT; bits — 24 или 32. -1, если нет. */
+#define ACPI_PM_TIMER_HZ 3579545
+int acpi_pm_timer(uint16_t *port, int *bits);
+
+/* Разобранная MADT или NULL. */
+const acpi_madt_info_t *acpi_get_madt(void);
+
+#endif /* ACPI_H */
@@ -0,0 +1,247 @@
+#include "apic.h"
+#include "acpi.h"
+#include "pic.h"
+#include "irq.h"
+#include "cpu.h"
+#include "vmm.h"
+#include "paging.h"
+#include <stddef.h>
+
+#define APIC_BASE_ENABLE  (1ull << 11)
+#define APIC_BASE_X2APIC  (1ull << 10)
+#define APIC_BASE_ADDR    0xFFFFFF000ull
+
+#define X2APIC_MSR_BASE   0x800
+#define X2APIC_ICR        0x830
+
+#define SVR_ENABLE        0x100
+#define LVT_NMI           0x400
+
+/* IOAPIC: регистр выбирается записью в IOREGSEL, данные — через IOWIN. */
+#define IOAPIC_REGSEL     0x00
+#define IOAPIC_WIN        0x10
+#define IOAPIC_REG_VER    0x01
+#define IOAPIC_REG_REDIR  0x10   /* вход n: 0x10 + 2n (младшие), +1 (старшие) */
+
+#define REDIR_ACTIVE_LOW  (1u << 13)
+#define REDIR_LEVEL       (1u << 15)
+#define REDIR_MASKED      (1u << 16)
+
+#define NO_GSI            0xFFFFFFFFu
+
+typedef struct ioapic {
+    volatile uint32_t *base;
+    uint32_t gsi_base;
+    uint32_t count;            /* входов (redirection entries) */
+} ioapic_t;
+
+static volatile uint32_t *lapic_base = NULL;
+static int x2apic = 0;
+static int active = 0;
+
+static ioapic_t ioapics[ACPI_MAX_IOAPICS];
+static uint32_t ioapic_count = 0;
+
+/* Вектор -> GSI, на который он настроен (для affinity и маскирования). */
+static uint32_t vector_gsi[IRQ_VECTORS];
+
+uint32_t lapic_read(uint32_t reg) {
+    if (x2apic) return (uint32_t)rdmsr(X2APIC_MSR_BASE + (reg >> 4));
+    return lapic_base[reg / 4];
+}
+
+void lapic_write(uint32_t reg, uint32_t value) {
+    if (x2apic) wrmsr(X2APIC_MSR_BASE + (reg >> 4), value);
+    else lapic_base[reg / 4] = value;
+}
+
+uint32_t lapic_id(void) {
+    if (x2apic) return (uint32_t)rdmsr(X2APIC_MSR_BASE + (LAPIC_ID >> 4));
+    return lapic_base[LAPIC_ID / 4] >> 24;
+}
+
+void lapic_eoi(void) {
+    /* В x2APIC это одна запись в MSR без выхода в гипервизор на MMIO. */
+    lapic_write(LAPIC_EOI, 0);
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    if (x2apic) {
+        /* 64-битный ICR пишется одной инструкцией; ждать доставки не нужно. */
+        wrmsr(X2APIC_ICR, ((uint64_t)apic_id << 32) | icr);
+        return;
+    }
+    uint64_t flags = cpu_irq_save();
+    while (lapic_base[LAPIC_ICR_LOW / 4] & ICR_PENDING)
+        __asm__ volatile("pause");
+    lapic_base[LAPIC_ICR_HIGH / 4] = apic_id << 24;
+    lapic_base[LAPIC_ICR_LOW / 4] = icr;
+    cpu_irq_restore(flags);
+}
+
+int apic_enabled(void) {
+    return active;
+}
+
+int apic_is_x2apic(void) {
+    return x2apic;
+}
+
+static uint32_t ioapic_read(const ioapic_t *io, uint32_t reg) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    return io->base[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(const ioapic_t *io, uint32_t reg, uint32_t value) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    io->base[IOAPIC_WIN / 4] = value;
+}
+
+static ioapic_t *ioapic_for_gsi(uint32_t gsi) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].count)
+            return &ioapics[i];
+    }
+    return NULL;
+}
+
+/* MMIO контроллеров — без кэширования. Ниже 4 GiB страница уже есть в
+ * прямом отображении, выше — отображаем сами. */
+static void *map_mmio(uint64_t phys) {
+    vm_space_t *k = vmm_kernel_space();
+    uint32_t flags = VMM_WRITE | VMM_GLOBAL | VMM_NOEXEC | VMM_UNCACHED;
+    phys &= ~(uint64_t)(PAGE_SIZE - 1);
+    if (vmm_protect(k, phys, PAGE_SIZE, flags) != 0 &&
+        vmm_map(k, phys, phys, PAGE_SIZE, flags) != 0)
+        return NULL;
+    return (void *)(uintptr_t)phys;
+}
+
+void lapic_init_cpu(void) {
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    /* В x2APIC переходят только из включённого xAPIC; обратно — через
+     * выключение, поэтому уже включённый прошивкой x2APIC не трогаем. */
+    if (!(base & APIC_BASE_X2APIC)) {
+        base |= APIC_BASE_ENABLE;
+        wrmsr(MSR_APIC_BASE, base);
+        if (x2apic) wrmsr(MSR_APIC_BASE, base | APIC_BASE_X2APIC);
+    }
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);   /* ExtINT от 8259 не нужен */
+    lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    /* ESR обновляется записью; сбрасываем накопленное. */
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+int apic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, uint16_t flags) {
+    ioapic_t *io = ioapic_for_gsi(gsi);
+    /* Без remapping в IOAPIC помещается только 8-битный APIC ID. */
+    if (!io || vector < IRQ_VECTOR_FIRST || apic_id > 0xFF) return -1;
+
+    uint32_t lo = vector;
+    if ((flags & ACPI_INTI_POLARITY_MASK) == ACPI_INTI_ACTIVE_LOW) lo |= REDIR_ACTIVE_LOW;
+    if ((flags & ACPI_INTI_TRIGGER_MASK) == ACPI_INTI_LEVEL) lo |= REDIR_LEVEL;
+
+    uint32_t reg = IOAPIC_REG_REDIR + 2 * (gsi - io->gsi_base);
+    ioapic_write(io, reg, REDIR_MASKED);
+    ioapic_write(io, reg + 1, apic_id << 24);
+    ioapic_write(io, reg, lo);
+    vector_gsi[vector] = gsi;
+    return 0;
+}
+
+int apic_route_irq(uint8_t isa_irq, uint8_t vector, uint32_t apic_id) {
+    const acpi_madt_info_t *m = acpi_get_madt();
+    uint32_t gsi = isa_irq;
+    uint16_t flags = 0;   /* ISA по умолчанию: фронт, активный высокий */
+    for (uint32_t i = 0; m && i < m->override_count; i++) {
+        if (m->overrides[i].source == isa_irq) {
+            gsi = m->overrides[i].gsi;
+            flags = m->overrides[i].flags;
+            break;
+        }
+    }
+    return apic_route_gsi(gsi, vector, apic_id, flags);
+}
+
+int apic_set_affinity(uint8_t vector, uint32_t apic_id) {
+    uint32_t gsi = vector_gsi[vector];
+    ioapic_t *io = gsi == NO_GSI ? NULL : ioapic_for_gsi(gsi);
+    if (!io || apic_id > 0xFF) return -1;
+    ioapic_write(io, IOAPIC_REG_REDIR + 2 * (gsi - io->gsi_base) + 1, apic_id << 24);
+    return 0;
+}
+
+int apic_mask_vector(uint8_t vector, int masked) {
+    uint32_t gsi = vector_gsi[vector];
+    ioapic_t *io = gsi == NO_GSI ? NULL : ioapic_for_gsi(gsi);
+    if (!io) return -1;
+    uint32_t reg = IOAPIC_REG_REDIR + 2 * (gsi - io->gsi_base);
+    uint32_t lo = ioapic_read(io, reg);
+    ioapic_write(io, reg, masked ? lo | REDIR_MASKED : lo & ~REDIR_MASKED);
+    return 0;
+}
+
+static void apic_chip_eoi(uint8_t vector) {
+    (void)vector;
+    lapic_eoi();
+}
+
+/* Ложное прерывание LAPIC приходит на вектор из SVR и EOI не требует.
+ * Заглушённый 8259 всё ещё может выдать ложный IRQ7/IRQ15 (через LINT0):
+ * такой вектор не прошёл через LAPIC, и EOI ему тоже не нужен — если только
+ * IOAPIC не направил на этот вектор настоящую линию. */
+static int apic_chip_spurious(uint8_t vector) {
+    if (vector == APIC_SPURIOUS_VECTOR) return 1;
+    if (vector == PIC_VECTOR_BASE + 7 || vector == PIC_VECTOR_BASE + 15)
+        return vector_gsi[vector] == NO_GSI;
+    return 0;
+}
+
+static const irq_chip_t xapic_chip = { "xAPIC", apic_chip_eoi, apic_chip_spurious };
+static const irq_chip_t x2apic_chip = { "x2APIC", apic_chip_eoi, apic_chip_spurious };
+
+int apic_init(void) {
+    const acpi_madt_info_t *m = acpi_get_madt();
+    if (!m || !m->ioapic_count || !cpu_has(CPU_FEAT_APIC)) return -1;
+
+    for (uint32_t v = 0; v < IRQ_VECTORS; v++) vector_gsi[v] = NO_GSI;
+
+    x2apic = cpu_has(CPU_FEAT_X2APIC);
+    if (!x2apic) {
+        uint64_t phys = m->lapic_addr ? m->lapic_addr : (rdmsr(MSR_APIC_BASE) & APIC_BASE_ADDR);
+        lapic_base = map_mmio(phys);
+        if (!lapic_base) return -1;
+    }
+
+    for (uint32_t i = 0; i < m->ioapic_count; i++) {
+        ioapic_t *io = &ioapics[ioapic_count];
+        io->base = map_mmio(m->ioapics[i].addr);
+        if (!io->base) continue;
+        io->gsi_base = m->ioapics[i].gsi_base;
+        io->count = ((ioapic_read(io, IOAPIC_REG_VER) >> 16) & 0xFF) + 1;
+        for (uint32_t n = 0; n < io->count; n++)
+            ioapic_write(io, IOAPIC_REG_REDIR + 2 * n, REDIR_MASKED);
+        ioapic_count++;
+    }
+    if (!ioapic_count) return -1;
+
+    /* Сначала глушим 8259, затем включаем LAPIC: иначе запрос, принятый
+     * 8259 до маскирования, ждал бы EOI, которого уже никто не пошлёт. */
+    uint64_t flags = cpu_irq_save();
+    pic_disable();
+    lapic_init_cpu();
+
+    uint32_t bsp = lapic_id();
+    apic_route_irq(1, PIC_VECTOR_BASE + 1, bsp);
+
+    irq_set_chip(x2apic ? &x2apic_chip : &xapic_chip);
+    active = 1;
+    cpu_irq_restore(flags);
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+/* Local APIC (xAPIC через MMIO или x2APIC через MSR) и IOAPIC по данным
+ * MADT. Если APIC есть, 8259 маскируется, а ISA IRQ n остаются на векторе
+ * PIC_VECTOR_BASE + n — обработчики драйверов не меняются. */
+
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Регистры LAPIC (смещения xAPIC; в x2APIC — MSR 0x800 + смещение / 16). */
+#define LAPIC_ID          0x020
+#define LAPIC_VERSION     0x030
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ESR         0x280
+#define LAPIC_ICR_LOW     0x300
+#define LAPIC_ICR_HIGH    0x310
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_LVT_LINT0   0x350
+#define LAPIC_LVT_LINT1   0x360
+#define LAPIC_LVT_ERROR   0x370
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_CUR   0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define LAPIC_LVT_MASKED  (1u << 16)
+
+/* Поля ICR (младшие 32 бита). */
+#define ICR_FIXED         0x000
+#define ICR_INIT          0x500
+#define ICR_STARTUP       0x600
+#define ICR_NMI           0x400
+#define ICR_ASSERT        0x4000
+#define ICR_LEVEL         0x8000
+#define ICR_PENDING       0x1000
+
+/* Найти LAPIC/IOAPIC в MADT, включить LAPIC этого CPU (x2APIC, если есть),
+ * замаскировать 8259 и перевести на IOAPIC IRQ1. -1 — остаёмся на
+ * 8259 (нет ACPI/MADT или APIC). После acpi_init и pic_init. */
+int apic_init(void);
+
+/* Включить LAPIC текущего CPU в том же режиме, что у BSP (для AP). */
+void lapic_init_cpu(void);
+
+/* 1, если прерывания идут через APIC; 1, если LAPIC в режиме x2APIC. */
+int apic_enabled(void);
+int apic_is_x2apic(void);
+
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+
+/* APIC ID текущего CPU. */
+uint32_t lapic_id(void);
+
+void lapic_eoi(void);
+
+/* IPI на apic_id; icr — вектор и тип доставки (ICR_*). */
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+
+/* Направить ISA IRQ (с учётом Interrupt Source Override) или GSI на вектор
+ * vector процессора apic_id. -1, если такого входа нет ни у одного IOAPIC. */
+int apic_route_irq(uint8_t isa_irq, uint8_t vector, uint32_t apic_id);
+int apic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, uint16_t flags);
+
+/* Перенаправить уже настроенный вектор на другой процессор. */
+int apic_set_affinity(uint8_t vector, uint32_t apic_id);
+
+/* Замаскировать/размаскировать вход IOAPIC, привязанный к вектору. */
+int apic_mask_vector(uint8_t vector, int masked);
+
+#endif /* APIC_H */
@@ -0,0 +1,70 @@
+#include "bga.h"
+
+static inline void outw(uint16_t port, uint16_t value) {
+    __asm__ volatile("outw %0, %1" :: "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t value;
+    __asm__ volatile("inw %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+#define DISPI_INDEX_PORT   0x01CE
+#define DISPI_DATA_PORT    0x01CF
+
+#define DISPI_ID           0x0
+#define DISPI_XRES         0x1
+#define DISPI_YRES         0x2
+#define DISPI_BPP          0x3
+#define DISPI_VIRT_WIDTH   0x6
+#define DISPI_VIRT_HEIGHT  0x7
+#define DISPI_X_OFFSET     0x8
+#define DISPI_Y_OFFSET     0x9
+#define DISPI_VIDEO_MEM    0xA   /* размер видеопамяти в блоках по 64 KiB */
+
+#define DISPI_ID_MIN       0xB0C2   /* виртуальный размер и смещения */
+#define DISPI_ID_MEM       0xB0C4   /* регистр размера видеопамяти */
+#define DISPI_ID_MAX       0xB0CF
+
+static uint16_t dispi_id = 0;
+
+static uint16_t dispi_read(uint16_t reg) {
+    outw(DISPI_INDEX_PORT, reg);
+    return inw(DISPI_DATA_PORT);
+}
+
+static void dispi_write(uint16_t reg, uint16_t value) {
+    outw(DISPI_INDEX_PORT, reg);
+    outw(DISPI_DATA_PORT, value);
+}
+
+int bga_detect(void) {
+    dispi_id = dispi_read(DISPI_ID);
+    return dispi_id >= DISPI_ID_MIN && dispi_id <= DISPI_ID_MAX;
+}
+
+uint32_t bga_setup_virtual(uint32_t width, uint32_t height, uint32_t bpp) {
+    if (dispi_id < DISPI_ID_MEM) return 0;
+    if (dispi_read(DISPI_XRES) != width || dispi_read(DISPI_YRES) != height ||
+        dispi_read(DISPI_BPP) != bpp)
+        return 0;
+
+    uint64_t vram = (uint64_t)dispi_read(DISPI_VIDEO_MEM) * 0x10000;
+    uint64_t lines = vram / ((uint64_t)width * (bpp / 8));
+    if (lines > 0xFFFF) lines = 0xFFFF;
+    if (lines < height) return 0;
+
+    dispi_write(DISPI_VIRT_WIDTH, (uint16_t)width);
+    dispi_write(DISPI_VIRT_HEIGHT, (uint16_t)lines);
+    dispi_write(DISPI_X_OFFSET, 0);
+    dispi_write(DISPI_Y_OFFSET, 0);
+
+    /* Адаптер может урезать виртуальную высоту — верим прочитанному. */
+    if (dispi_read(DISPI_VIRT_WIDTH) != width) return 0;
+    return dispi_read(DISPI_VIRT_HEIGHT);
+}
+
+void bga_set_y_offset(uint32_t y) {
+    dispi_write(DISPI_Y_OFFSET, (uint16_t)y);
+}
@@ -0,0 +1,19 @@
+#ifndef BGA_H
+#define BGA_H
+
+#include <stdint.h>
+
+/* Bochs/QEMU VBE DISPI (std/bochs VGA): виртуальный framebuffer выше экрана
+ * и сдвиг видимого окна по Y — аппаратная прокрутка. */
+
+/* 1, если адаптер есть и поддерживает виртуальный размер и смещения. */
+int bga_detect(void);
+
+/* Для текущего режима width x height x bpp задать виртуальную высоту на всю
+ * видеопамять. Возвращает число строк или 0, если режим другой. */
+uint32_t bga_setup_virtual(uint32_t width, uint32_t height, uint32_t bpp);
+
+/* Первая видимая строка виртуального framebuffer. */
+void bga_set_y_offset(uint32_t y);
+
+#endif /* BGA_H */
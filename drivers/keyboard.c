@@ -1,5 +1,10 @@
 #include "keyboard.h"
 #include "vga.h"
+#include "cpu.h"
+#include "irq.h"
+#include "pic.h"
+#include "sched.h"
+#include "spinlock.h"
 
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" :: "a"(value), "Nd"(port));
@@ -14,6 +19,11 @@ static inline uint8_t inb(uint16_t port) {
 #define KBD_STATUS_PORT 0x64
 #define KBD_DATA_PORT   0x60
 
+#define SC_EXTENDED     0xE0    /* префикс: следующий код — с доп. клавиатуры */
+#define SC_PAGE_UP      0x49    /* после 0xE0; без него — 9 на цифровой */
+#define SC_PAGE_DOWN    0x51    /* после 0xE0; без него — 3 на цифровой */
+#define SCROLL_PAGE     10
+
 /* Простая раскладка для scancode set 1 (без Shift). */
 static const char keymap[128] = {
     0,  27, '1','2','3','4','5','6','7','8','9','0','-','=', '\b',
@@ -22,33 +32,103 @@ static const char keymap[128] = {
     'z','x','c','v','b','n','m',',','.','/', 0,   0,   0,   ' ',
 };
 
+/* Кольцо декодированных клавиш: пишет только обработчик IRQ1, читают shell
+ * и SYS_read, возможно с разных CPU. Индексы растут без ограничения, позиция —
+ * по модулю размера. head меняет только IRQ, tail — читатели под ring_lock,
+ * так что писателю блокировка не нужна. */
+#define KBD_RING_SIZE 256   /* степень двойки */
+
+/* Коды не-символьных клавиш в кольце. */
+#define KEY_PAGE_UP     0x80
+#define KEY_PAGE_DOWN   0x81
+
+static volatile uint8_t ring[KBD_RING_SIZE];
+static volatile uint32_t ring_head = 0;     /* следующая запись (IRQ) */
+static volatile uint32_t ring_tail = 0;     /* следующее чтение */
+static uint64_t ring_dropped = 0;
+static wait_queue_t ring_wait;
+static spinlock_t ring_lock = SPINLOCK_INIT;   /* между читателями */
+
+#define barrier() __asm__ volatile("" ::: "memory")
+
+static void ring_put(uint8_t key) {
+    uint32_t head = ring_head;
+    if (head - ring_tail == KBD_RING_SIZE) {
+        ring_dropped++;
+        return;
+    }
+    ring[head & (KBD_RING_SIZE - 1)] = key;
+    barrier();      /* байт виден раньше нового head */
+    ring_head = head + 1;
+}
+
+static void keyboard_irq(uint8_t vector, void *ctx) {
+    (void)vector;
+    (void)ctx;
+    static int extended = 0;    /* IRQ1 обслуживает один CPU */
+    uint8_t sc = inb(KBD_DATA_PORT);
+
+    if (sc == SC_EXTENDED) {
+        extended = 1;
+        return;
+    }
+    int ext = extended;
+    extended = 0;
+
+    /* Игнорируем break-коды (бит 7). */
+    if (sc & 0x80) return;
+
+    /* Прочие E0-коды (Enter и / цифровой) совпадают с основными. */
+    if (ext && sc == SC_PAGE_UP) ring_put(KEY_PAGE_UP);
+    else if (ext && sc == SC_PAGE_DOWN) ring_put(KEY_PAGE_DOWN);
+    else if (sc < sizeof(keymap) && keymap[sc] != 0) ring_put((uint8_t)keymap[sc]);
+    else return;
+    sched_wake_all(&ring_wait);
+}
+
 void keyboard_init(void) {
-    /* Можно было бы очистить буфер контроллера; для простоты просто читаем порты. */
-    (void)inb(KBD_STATUS_PORT);
-    (void)inb(KBD_DATA_PORT);
+    irq_register(PIC_VECTOR_BASE + 1, keyboard_irq, 0);
+    /* Сбросить то, что накопилось в контроллере до обработчика. */
+    while (inb(KBD_STATUS_PORT) & 0x01)
+        (void)inb(KBD_DATA_PORT);
+}
+
+static int ring_ready(void *arg) {
+    (void)arg;
+    return ring_tail != ring_head;
 }
 
-static uint8_t read_scancode(void) {
+/* Спит, пока IRQ1 не положит клавишу в кольцо. Проснувшихся читателей
+ * может быть несколько: клавишу забирает тот, кто первым взял ring_lock,
+ * остальные засыпают снова. */
+static uint8_t ring_get(void) {
     while (1) {
-        uint8_t status = inb(KBD_STATUS_PORT);
-        if (status & 0x01) {
-            return inb(KBD_DATA_PORT);
+        sched_wait(&ring_wait, ring_ready, 0);
+
+        uint64_t flags = spin_lock_irqsave(&ring_lock);
+        uint32_t tail = ring_tail;
+        if (tail == ring_head) {
+            spin_unlock_irqrestore(&ring_lock, flags);
+            continue;
         }
+        uint8_t key = ring[tail & (KBD_RING_SIZE - 1)];
+        barrier();      /* байт прочитан раньше, чем слот освобождён */
+        ring_tail = tail + 1;
+        spin_unlock_irqrestore(&ring_lock, flags);
+        return key;
     }
 }
 
 char keyboard_getchar(void) {
     while (1) {
-        uint8_t sc = read_scancode();
+        uint8_t key = ring_get();
 
-        /* Игнорируем break-коды (бит 7). */
-        if (sc & 0x80) {
+        /* PgUp/PgDn листают историю консоли, в строку не попадают. */
+        if (key == KEY_PAGE_UP || key == KEY_PAGE_DOWN) {
+            vga_scroll_view(key == KEY_PAGE_UP ? SCROLL_PAGE : -SCROLL_PAGE);
             continue;
         }
-
-        if (sc < sizeof(keymap) && keymap[sc] != 0) {
-            return keymap[sc];
-        }
+        return (char)key;
     }
 }
 
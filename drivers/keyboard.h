@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+/* Подключить обработчик IRQ1. */
 void keyboard_init(void);
+
+/* Ждёт клавишу на hlt (прерывания разрешаются только на время ожидания). */
 char keyboard_getchar(void);
 void keyboard_read_line(char *buf, uint64_t max_len);
 
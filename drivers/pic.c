@@ -1,4 +1,5 @@
 #include "pic.h"
+#include "irq.h"
 
 #define PIC1_CMD  0x20
 #define PIC1_DATA 0x21
@@ -9,18 +10,51 @@
 #define ICW1_INIT      0x10
 #define ICW4_8086      0x01
 
+#define OCW3_READ_ISR  0x0B
+#define PIC_EOI        0x20
+
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" :: "a"(value), "Nd"(port));
 }
 
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static void pic_chip_eoi(uint8_t vector) {
+    if (vector >= PIC_VECTOR_BASE && vector < PIC_VECTOR_BASE + PIC_IRQ_COUNT)
+        pic_eoi(vector - PIC_VECTOR_BASE);
+}
+
+/* IRQ7/IRQ15 без бита в ISR — ложные (запрос снят до INTA). За ложный IRQ15
+ * master всё же получил настоящий IRQ2, и ему нужен EOI. */
+static int pic_chip_spurious(uint8_t vector) {
+    int irq = vector - PIC_VECTOR_BASE;
+    if (irq == 7) {
+        outb(PIC1_CMD, OCW3_READ_ISR);
+        return !(inb(PIC1_CMD) & 0x80);
+    }
+    if (irq == 15) {
+        outb(PIC2_CMD, OCW3_READ_ISR);
+        if (inb(PIC2_CMD) & 0x80) return 0;
+        outb(PIC1_CMD, PIC_EOI);
+        return 1;
+    }
+    return 0;
+}
+
+static const irq_chip_t pic_chip = { "8259", pic_chip_eoi, pic_chip_spurious };
+
 void pic_init(void) {
     /* ICW1: начать инициализацию */
     outb(PIC1_CMD, ICW1_INIT | ICW1_ICW4);
     outb(PIC2_CMD, ICW1_INIT | ICW1_ICW4);
 
     /* ICW2: базовый вектор для master (32) и slave (40) */
-    outb(PIC1_DATA, 32);
-    outb(PIC2_DATA, 40);
+    outb(PIC1_DATA, PIC_VECTOR_BASE);
+    outb(PIC2_DATA, PIC_VECTOR_BASE + 8);
 
     /* ICW3: master имеет slave на IRQ2, slave — cascade */
     outb(PIC1_DATA, 0x04);
@@ -30,14 +64,31 @@ void pic_init(void) {
     outb(PIC1_DATA, ICW4_8086);
     outb(PIC2_DATA, ICW4_8086);
 
-    /* Маски: разрешаем только IRQ0 (PIT) и IRQ1 (клавиатура) */
-    outb(PIC1_DATA, 0xFC);  /* 0b11111100 */
+    /* Маски: разрешаем только IRQ1 (клавиатура); IRQ0 включает таймер,
+     * если ему нужен PIT. */
+    outb(PIC1_DATA, 0xFD);  /* 0b11111101 */
     outb(PIC2_DATA, 0xFF);  /* все slave отключены */
+
+    irq_set_chip(&pic_chip);
+}
+
+void pic_set_mask(int irq, int masked) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = (uint8_t)(1u << (irq & 7));
+    uint8_t mask = inb(port);
+    outb(port, masked ? mask | bit : mask & ~bit);
+    /* Вход slave идёт через IRQ2 master. */
+    if (irq >= 8 && !masked) pic_set_mask(2, 0);
+}
+
+void pic_disable(void) {
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
 }
 
 void pic_eoi(int irq) {
     if (irq >= 8) {
-        outb(PIC2_CMD, 0x20);
+        outb(PIC2_CMD, PIC_EOI);
     }
-    outb(PIC1_CMD, 0x20);
+    outb(PIC1_CMD, PIC_EOI);
 }
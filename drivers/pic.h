@@ -0,0 +1,23 @@
+#ifndef PIC_H
+#define PIC_H
+
+#include <stdint.h>
+
+/* Пара 8259: IRQ 0–7 -> векторы 32–39, IRQ 8–15 -> 40–47. */
+#define PIC_VECTOR_BASE 32
+#define PIC_IRQ_COUNT   16
+
+/* Перенастроить векторы и маски (разрешён только IRQ1). */
+void pic_init(void);
+
+/* Замаскировать или разрешить один вход (0–15). */
+void pic_set_mask(int irq, int masked);
+
+/* Замаскировать все входы: прерывания идут через APIC. Векторы остаются
+ * 32–47, так что ложный IRQ7/15 не попадёт на исключение. */
+void pic_disable(void);
+
+/* Конец обработки IRQ irq (0–15). */
+void pic_eoi(int irq);
+
+#endif /* PIC_H */
@@ -0,0 +1,51 @@
+#include "pit.h"
+#include "cpu.h"
+
+#define PIT_CH0        0x40
+#define PIT_CH2        0x42
+#define PIT_CMD        0x43
+#define PIT_GATE_PORT  0x61
+
+#define GATE_CH2       0x01
+#define SPEAKER_ON     0x02
+#define OUT_CH2        0x20
+
+/* Канал 2, младший и старший байты, режим 0 (выход поднимается в конце счёта). */
+#define CMD_CH0_MODE0  0x30
+#define CMD_CH2_MODE0  0xB0
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" :: "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+uint64_t pit_tsc_hz(uint32_t us) {
+    uint32_t latch = (uint32_t)((uint64_t)PIT_HZ * us / 1000000);
+    if (latch > 0xFFFF) latch = 0xFFFF;
+
+    /* Гейт канала 2 открыт, динамик отключён. */
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~SPEAKER_ON) | GATE_CH2);
+    outb(PIT_CMD, CMD_CH2_MODE0);
+    outb(PIT_CH2, latch & 0xFF);
+    outb(PIT_CH2, latch >> 8);
+
+    uint64_t t0 = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & OUT_CH2)) {}
+    uint64_t t1 = rdtsc();
+
+    return (t1 - t0) * PIT_HZ / latch;
+}
+
+void pit_oneshot(uint32_t us) {
+    uint64_t latch = (uint64_t)PIT_HZ * us / 1000000;
+    if (latch == 0) latch = 1;
+    if (latch > 0xFFFF) latch = 0xFFFF;
+    outb(PIT_CMD, CMD_CH0_MODE0);
+    outb(PIT_CH0, latch & 0xFF);
+    outb(PIT_CH0, latch >> 8);
+}
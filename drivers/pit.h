@@ -0,0 +1,21 @@
+#ifndef PIT_H
+#define PIT_H
+
+#include <stdint.h>
+
+/* 8254 PIT. Канал 2 (его выход читается через порт 0x61) служит эталоном
+ * времени при калибровке TSC. Канал 0 — запасной источник прерываний таймера. */
+
+#define PIT_HZ 1193182
+
+/* Частота TSC в Гц, измеренная по каналу 2 за us микросекунд (до 54 мс). */
+uint64_t pit_tsc_hz(uint32_t us);
+
+/* Одно прерывание IRQ0 через us микросекунд (канал 0, режим 0; до 54 мс).
+ * Используется таймером, только если нет LAPIC. */
+void pit_oneshot(uint32_t us);
+
+/* Наибольший интервал pit_oneshot в микросекундах. */
+#define PIT_MAX_US  (0xFFFFull * 1000000 / PIT_HZ)
+
+#endif /* PIT_H */
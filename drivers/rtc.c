@@ -0,0 +1,93 @@
+#include "rtc.h"
+
+#define CMOS_ADDR  0x70
+#define CMOS_DATA  0x71
+
+#define RTC_SEC     0x00
+#define RTC_MIN     0x02
+#define RTC_HOUR    0x04
+#define RTC_DAY     0x07
+#define RTC_MONTH   0x08
+#define RTC_YEAR    0x09
+#define RTC_STATUS_A 0x0A
+#define RTC_STATUS_B 0x0B
+
+#define STATUS_A_UIP    0x80   /* идёт обновление, значения нестабильны */
+#define STATUS_B_24H    0x02
+#define STATUS_B_BINARY 0x04
+#define HOUR_PM         0x80
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" :: "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_ADDR, reg);
+    return inb(CMOS_DATA);
+}
+
+typedef struct rtc_time {
+    uint8_t sec, min, hour, day, month, year;
+} rtc_time_t;
+
+static void rtc_read_raw(rtc_time_t *t) {
+    while (cmos_read(RTC_STATUS_A) & STATUS_A_UIP) {}
+    t->sec = cmos_read(RTC_SEC);
+    t->min = cmos_read(RTC_MIN);
+    t->hour = cmos_read(RTC_HOUR);
+    t->day = cmos_read(RTC_DAY);
+    t->month = cmos_read(RTC_MONTH);
+    t->year = cmos_read(RTC_YEAR);
+}
+
+static uint8_t from_bcd(uint8_t v) {
+    return (uint8_t)((v >> 4) * 10 + (v & 0x0F));
+}
+
+/* Дней от 1970-01-01 до даты (григорианский календарь). */
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+uint64_t rtc_read_epoch(void) {
+    rtc_time_t a, b;
+    /* Два одинаковых чтения подряд — значит, обновление не попало между ними. */
+    rtc_read_raw(&a);
+    do {
+        b = a;
+        rtc_read_raw(&a);
+    } while (a.sec != b.sec || a.min != b.min || a.hour != b.hour ||
+             a.day != b.day || a.month != b.month || a.year != b.year);
+
+    uint8_t status = cmos_read(RTC_STATUS_B);
+    int pm = a.hour & HOUR_PM;
+    a.hour &= ~HOUR_PM;
+    if (!(status & STATUS_B_BINARY)) {
+        a.sec = from_bcd(a.sec);
+        a.min = from_bcd(a.min);
+        a.hour = from_bcd(a.hour);
+        a.day = from_bcd(a.day);
+        a.month = from_bcd(a.month);
+        a.year = from_bcd(a.year);
+    }
+    if (!(status & STATUS_B_24H)) {
+        if (a.hour == 12) a.hour = 0;
+        if (pm) a.hour += 12;
+    }
+    if (a.month < 1 || a.month > 12 || a.day < 1) return 0;
+
+    /* Регистр века есть не везде; двухзначный год считаем 20xx. */
+    int64_t days = days_from_civil(2000 + a.year, a.month, a.day);
+    return (uint64_t)(days * 86400 + a.hour * 3600 + a.min * 60 + a.sec);
+}
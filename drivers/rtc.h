@@ -0,0 +1,11 @@
+#ifndef RTC_H
+#define RTC_H
+
+#include <stdint.h>
+
+/* CMOS RTC. Читается один раз при загрузке — дальше время идёт по TSC. */
+
+/* Секунды с 1970-01-01 UTC (часы RTC считаются идущими в UTC). */
+uint64_t rtc_read_epoch(void);
+
+#endif /* RTC_H */
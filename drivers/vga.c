@@ -1,6 +1,13 @@
 #include "vga.h"
 #include "multiboot2.h"
 #include "font_8x16.h"
+#include "bga.h"
+#include "paging.h"
+#include "vmm.h"
+#include "cpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "string.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -9,8 +16,8 @@ static volatile uint16_t *const VGA_MEMORY = (uint16_t *)0xB8000;
 static const size_t VGA_WIDTH  = 80;
 static const size_t VGA_HEIGHT = 25;
 
-static size_t cursor_row = 0;
-static size_t cursor_col = 0;
+static uint32_t cursor_row = 0;
+static uint32_t cursor_col = 0;
 static uint8_t current_color = 0;
 
 /* --- Framebuffer mode (1920x1080) --- */
@@ -19,6 +26,9 @@ static uint8_t current_color = 0;
 #define CHAR_SCALE   2    /* масштаб: каждый пиксель = 2x2 на экране */
 #define CHAR_W       (FONT_CELL_W * CHAR_SCALE)   /* 16 */
 #define CHAR_H       (FONT_CELL_H * CHAR_SCALE)   /* 32 */
+#define FB_MAX_ROWS  128  /* строк текста, для которых ведётся учёт изменений */
+#define FONT_GLYPHS  128
+#define ATLAS_ROW    (CHAR_W * 4)                 /* байт на строку глифа, до 32 bpp */
 
 static int use_fb = 0;
 static volatile uint8_t *fb_base = 0;
@@ -31,9 +41,30 @@ static uint32_t fb_rows = 0;
 static uint8_t fb_red_shift = 0, fb_red_size = 8;
 static uint8_t fb_green_shift = 0, fb_green_size = 8;
 static uint8_t fb_blue_shift = 0, fb_blue_size = 8;
-static uint32_t fb_fg = 0x00FFFFFF;
 static uint32_t fb_bg = 0x00000000;
 
+/* Теневой буфер в RAM (тот же pitch, что у VRAM): рисуем в него, а в VRAM
+ * переносим только изменённые участки, и только записью. */
+static uint8_t *fb_shadow = 0;
+static volatile uint8_t *fb_draw = 0;        /* куда рисуем: shadow или VRAM */
+static uint32_t fb_dirty_rows = 0;
+static uint32_t dirty_x0[FB_MAX_ROWS];       /* по строкам текста, в пикселях; */
+static uint32_t dirty_x1[FB_MAX_ROWS];       /* x0 >= x1 — строка чистая */
+
+/* Аппаратная прокрутка (BGA): видимое окно из fb_height строк начинается со
+ * строки fb_yoff виртуального буфера из fb_lines строк. Shadow повторяет
+ * весь виртуальный буфер. Без BGA fb_lines == fb_height и fb_yoff == 0. */
+static int fb_hw_scroll = 0;
+static uint32_t fb_lines = 0;
+static uint32_t fb_yoff = 0;
+static uint32_t fb_shown_yoff = 0;           /* смещение, заданное адаптеру */
+
+/* Атлас глифов: каждый символ уже развёрнут в пиксели атрибута atlas_attr
+ * (обычно текущий цвет) с горизонтальным масштабом; по вертикали строка
+ * повторяется CHAR_SCALE раз. */
+static uint8_t glyph_atlas[FONT_GLYPHS][FONT_CELL_H][ATLAS_ROW];
+static int atlas_attr = -1;
+
 /* VGA color index -> RGB (for framebuffer) */
 static const uint32_t vga_to_rgb[16] = {
     0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
@@ -48,7 +79,28 @@ static uint16_t vga_entry(unsigned char uc, uint8_t color) {
     return (uint16_t)uc | ((uint16_t)color << 8);
 }
 
-static uint32_t fb_make_pixel(uint8_t r, uint8_t g, uint8_t b) {
+/* --- Ядра отрисовки под формат пикселя; выбираются один раз в vga_init --- */
+
+typedef struct fb_ops {
+    /* 0x00RRGGBB -> пиксель в формате framebuffer */
+    uint32_t (*pack)(uint32_t rgb);
+    /* count одинаковых пикселей подряд */
+    void (*fill)(volatile uint8_t *dst, uint32_t pixel, uint32_t count);
+    /* строка шрифта (8 бит, MSB слева) -> CHAR_W пикселей с масштабом */
+    void (*glyph_row)(uint8_t *dst, unsigned char bits, uint32_t fg, uint32_t bg);
+} fb_ops_t;
+
+static uint32_t pack_xrgb(uint32_t rgb) {
+    return rgb & 0x00FFFFFF;
+}
+
+static uint32_t pack_xbgr(uint32_t rgb) {
+    return ((rgb & 0xFF) << 16) | (rgb & 0xFF00) | ((rgb >> 16) & 0xFF);
+}
+
+/* Произвольная раскладка из multiboot (16 bpp: 565, 555). */
+static uint32_t pack_masks(uint32_t rgb) {
+    uint8_t r = (uint8_t)(rgb >> 16), g = (uint8_t)(rgb >> 8), b = (uint8_t)rgb;
     uint32_t pix = 0;
     if (fb_red_size)   pix |= ((uint32_t)(r >> (8 - fb_red_size))   << fb_red_shift);
     if (fb_green_size) pix |= ((uint32_t)(g >> (8 - fb_green_size)) << fb_green_shift);
@@ -56,102 +108,403 @@ static uint32_t fb_make_pixel(uint8_t r, uint8_t g, uint8_t b) {
     return pix;
 }
 
-/* Пиксель в формате 0x00RRGGBB. Записываем байты в порядке R,G,B. */
-static void fb_put_pixel(uint32_t x, uint32_t y, uint32_t pixel) {
-    uint8_t r = (uint8_t)(pixel >> 16);
-    uint8_t g = (uint8_t)(pixel >> 8);
-    uint8_t b = (uint8_t)(pixel);
-    if (fb_bpp == 32) {
-        volatile uint8_t *p = fb_base + (uint64_t)y * fb_pitch + (uint64_t)x * 4;
-        p[0] = r;
-        p[1] = g;
-        p[2] = b;
-        p[3] = 0;
-    } else if (fb_bpp == 24) {
-        volatile uint8_t *p = fb_base + (uint64_t)y * fb_pitch + (uint64_t)x * 3;
-        p[0] = r;
-        p[1] = g;
-        p[2] = b;
+/* Заливка пикселями type: до выравнивания по 8 — поштучно, дальше словами
+ * по per_word пикселей. */
+#define FB_FILL_WORDS(name, type, per_word)                                  \
+static void name(volatile uint8_t *dst, uint32_t pixel, uint32_t count) {   \
+    volatile type *p = (volatile type *)dst;                                 \
+    uint64_t word = 0;                                                       \
+    for (int i = 0; i < (per_word); i++)                                     \
+        word |= (uint64_t)(type)pixel << (i * 8 * sizeof(type));             \
+    while (count && ((uintptr_t)p & 7)) { *p++ = (type)pixel; count--; }    \
+    volatile uint64_t *w = (volatile uint64_t *)p;                           \
+    for (; count >= (per_word); count -= (per_word)) *w++ = word;            \
+    p = (volatile type *)w;                                                  \
+    while (count--) *p++ = (type)pixel;                                      \
+}
+
+#define FB_GLYPH_ROW(name, type)                                             \
+static void name(uint8_t *dst, unsigned char bits, uint32_t fg, uint32_t bg) { \
+    type *p = (type *)dst;                                                   \
+    for (uint32_t x = 0; x < CHAR_W; x++)                                    \
+        p[x] = (type)((bits & (0x80u >> (x / CHAR_SCALE))) ? fg : bg);       \
+}
+
+FB_FILL_WORDS(fill32, uint32_t, 2)
+FB_FILL_WORDS(fill16, uint16_t, 4)
+FB_GLYPH_ROW(glyph_row32, uint32_t)
+FB_GLYPH_ROW(glyph_row16, uint16_t)
+
+/* 24 bpp: 8 пикселей = 3 слова; поштучно только до выравнивания и хвост. */
+static void fill24(volatile uint8_t *dst, uint32_t pixel, uint32_t count) {
+    while (count && ((uintptr_t)dst & 7)) {
+        dst[0] = (uint8_t)pixel;
+        dst[1] = (uint8_t)(pixel >> 8);
+        dst[2] = (uint8_t)(pixel >> 16);
+        dst += 3;
+        count--;
+    }
+    uint64_t p = pixel & 0xFFFFFF;
+    uint64_t w0 = p | (p << 24) | (p << 48);
+    uint64_t w1 = (p >> 16) | (p << 8) | (p << 32) | (p << 56);
+    uint64_t w2 = (p >> 8) | (p << 16) | (p << 40);
+    volatile uint64_t *w = (volatile uint64_t *)dst;
+    for (; count >= 8; count -= 8) {
+        w[0] = w0;
+        w[1] = w1;
+        w[2] = w2;
+        w += 3;
+    }
+    dst = (volatile uint8_t *)w;
+    while (count--) {
+        dst[0] = (uint8_t)pixel;
+        dst[1] = (uint8_t)(pixel >> 8);
+        dst[2] = (uint8_t)(pixel >> 16);
+        dst += 3;
     }
 }
 
-static void fb_draw_char(uint32_t px, uint32_t py, unsigned char c, uint32_t fg, uint32_t bg) {
-    unsigned int ch = (unsigned int)(c & 0x7F);
-    const unsigned char *glyph = font8x16[ch];
-    for (uint32_t row = 0; row < FONT_CELL_H; row++) {
-        unsigned char line = glyph[row];
-        for (uint32_t col = 0; col < FONT_CELL_W; col++) {
-            /* MSB = слева (VGA 8x16) */
-            uint32_t color = (line & (0x80u >> col)) ? fg : bg;
-            uint32_t x0 = px + col * CHAR_SCALE;
-            uint32_t y0 = py + row * CHAR_SCALE;
-            for (uint32_t sy = 0; sy < CHAR_SCALE; sy++)
-                for (uint32_t sx = 0; sx < CHAR_SCALE; sx++)
-                    fb_put_pixel(x0 + sx, y0 + sy, color);
-        }
+static void glyph_row24(uint8_t *dst, unsigned char bits, uint32_t fg, uint32_t bg) {
+    for (uint32_t x = 0; x < CHAR_W; x++, dst += 3) {
+        uint32_t c = (bits & (0x80u >> (x / CHAR_SCALE))) ? fg : bg;
+        dst[0] = (uint8_t)c;
+        dst[1] = (uint8_t)(c >> 8);
+        dst[2] = (uint8_t)(c >> 16);
     }
 }
 
-static void fb_clear(void) {
-    for (uint32_t y = 0; y < fb_height; y++) {
-        for (uint32_t x = 0; x < fb_width; x++) {
-            fb_put_pixel(x, y, fb_bg);
-        }
+static const fb_ops_t fb_ops_xrgb32 = { pack_xrgb,  fill32, glyph_row32 };
+static const fb_ops_t fb_ops_xbgr32 = { pack_xbgr,  fill32, glyph_row32 };
+static const fb_ops_t fb_ops_rgb24  = { pack_xrgb,  fill24, glyph_row24 };
+static const fb_ops_t fb_ops_bgr24  = { pack_xbgr,  fill24, glyph_row24 };
+static const fb_ops_t fb_ops_16     = { pack_masks, fill16, glyph_row16 };
+
+static const fb_ops_t *fb_ops = &fb_ops_xrgb32;
+
+/* Ядра по формату framebuffer. У 24/32 bpp раскладка, отличная от xBGR,
+ * считается xRGB: некоторые загрузчики сообщают неверные сдвиги. */
+static const fb_ops_t *fb_select_ops(const multiboot_fb_info_t *info) {
+    if (info->bpp == 16) return &fb_ops_16;
+    int bgr = info->red_shift == 0 && info->green_shift == 8 && info->blue_shift == 16;
+    if (info->bpp == 24) return bgr ? &fb_ops_bgr24 : &fb_ops_rgb24;
+    if (info->bpp == 32) return bgr ? &fb_ops_xbgr32 : &fb_ops_xrgb32;
+    return 0;
+}
+
+/* Начало видимого окна в буфере рисования. */
+static volatile uint8_t *fb_view(void) {
+    return fb_draw + (uint64_t)fb_yoff * fb_pitch;
+}
+
+/* Залить строки окна [y0, y1) цветом фона. */
+static void fb_fill_rows(uint32_t y0, uint32_t y1) {
+    volatile uint8_t *view = fb_view();
+    for (uint32_t y = y0; y < y1; y++)
+        fb_ops->fill(view + (uint64_t)y * fb_pitch, fb_bg, fb_width);
+}
+
+/* Отметить прямоугольник (в пикселях) как изменённый. */
+static void fb_mark(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (!fb_shadow || w == 0 || h == 0) return;
+    uint32_t last = (y + h - 1) / CHAR_H;
+    if (last >= fb_dirty_rows) last = fb_dirty_rows - 1;
+    for (uint32_t r = y / CHAR_H; r <= last; r++) {
+        if (x < dirty_x0[r]) dirty_x0[r] = x;
+        if (x + w > dirty_x1[r]) dirty_x1[r] = x + w;
     }
 }
 
-static void fb_scroll(void) {
-    uint32_t line_bytes = fb_pitch * CHAR_H;
-    for (uint32_t y = 0; y < fb_height - CHAR_H; y++) {
-        volatile uint8_t *dst = fb_base + y * fb_pitch;
-        volatile uint8_t *src = fb_base + (y + CHAR_H) * fb_pitch;
-        for (uint32_t i = 0; i < line_bytes; i++) {
-            dst[i] = src[i];
+/* Перенести изменённые участки теневого буфера в VRAM, затем показать окно. */
+static void fb_flush(void) {
+    if (fb_shadow) {
+        uint32_t bytes_pp = fb_bpp / 8;
+        for (uint32_t r = 0; r < fb_dirty_rows; r++) {
+            if (dirty_x0[r] >= dirty_x1[r]) continue;
+            uint64_t from = ((uint64_t)dirty_x0[r] * bytes_pp) & ~7ull;
+            uint64_t to = ((uint64_t)dirty_x1[r] * bytes_pp + 7) & ~7ull;
+            if (to > fb_pitch) to = fb_pitch;
+            uint32_t y_end = (r + 1) * CHAR_H;
+            if (y_end > fb_height) y_end = fb_height;
+            for (uint32_t y = r * CHAR_H; y < y_end; y++) {
+                uint64_t off = (uint64_t)(fb_yoff + y) * fb_pitch + from;
+                /* В VRAM только пишем: мимо кэша, строки не вытесняют RAM. */
+                memcpy_nt((void *)(fb_base + off), fb_shadow + off, to - from);
+            }
+            dirty_x0[r] = fb_width;
+            dirty_x1[r] = 0;
         }
     }
-    for (uint32_t y = fb_height - CHAR_H; y < fb_height; y++) {
-        for (uint32_t x = 0; x < fb_width; x++) {
-            fb_put_pixel(x, y, fb_bg);
-        }
+    if (fb_hw_scroll && fb_shown_yoff != fb_yoff) {
+        bga_set_y_offset(fb_yoff);
+        fb_shown_yoff = fb_yoff;
     }
 }
 
-static void fb_newline(void) {
+/* --- Модель консоли, общая для обоих режимов: кольцо строк из ячеек
+ * (символ | атрибут << 8, как в текстовом режиме VGA) с историей. Прокрутка —
+ * сдвиг индекса; отрисовываются только строки, изменённые с прошлого кадра. --- */
+
+#define CON_CELLS      (128 * 1024)
+#define CON_MAX_ROWS   FB_MAX_ROWS
+
+typedef struct con_backend {
+    void (*draw_row)(uint32_t row, const uint16_t *cells);
+    /* Сдвинуть изображение на n строк вверх; NULL или -1 — перерисовать всё. */
+    int (*scroll)(uint32_t n);
+    void (*flush)(void);
+} con_backend_t;
+
+static uint16_t con_cells[CON_CELLS];
+static uint32_t con_cols = 0;
+static uint32_t con_rows = 0;
+static uint32_t con_lines = 0;          /* ёмкость кольца в строках */
+static uint32_t con_top = 0;            /* строка кольца, с которой начинается экран */
+static uint32_t con_history = 0;        /* строк истории над экраном */
+static uint32_t con_view = 0;           /* на сколько строк экран отмотан назад */
+static uint32_t con_scrollback = VGA_DEFAULT_SCROLLBACK;
+static uint32_t con_pending = 0;        /* прокрутка с прошлого кадра */
+static int con_full = 0;                /* перерисовать все строки */
+static int con_batch = 0;               /* >0: кадр откладывается */
+static spinlock_t con_lock = SPINLOCK_INIT;
+static volatile int32_t con_owner = -1; /* CPU внутри vga_begin/vga_end */
+static uint64_t con_flags;
+static uint8_t con_dirty[CON_MAX_ROWS];
+static const con_backend_t *con = 0;
+
+static uint16_t *con_line(uint32_t row) {
+    return &con_cells[((con_top + row) % con_lines) * con_cols];
+}
+
+/* Строка, видимая в row с учётом просмотра истории. */
+static const uint16_t *con_view_line(uint32_t row) {
+    return &con_cells[((con_top + con_lines - con_view + row) % con_lines) * con_cols];
+}
+
+static void con_blank(uint16_t *line) {
+    for (uint32_t c = 0; c < con_cols; c++) line[c] = vga_entry(' ', current_color);
+}
+
+static void con_layout(uint32_t cols, uint32_t rows) {
+    if (rows > CON_MAX_ROWS) rows = CON_MAX_ROWS;
+    uint32_t lines = rows + con_scrollback;
+    if (lines > CON_CELLS / cols) lines = CON_CELLS / cols;
+
+    con_cols = cols;
+    con_rows = rows;
+    con_lines = lines;
+    con_top = 0;
+    con_history = 0;
+    con_view = 0;
+    con_pending = 0;
+    for (uint32_t r = 0; r < rows; r++) con_blank(con_line(r));
+    cursor_row = 0;
     cursor_col = 0;
-    cursor_row++;
-    if (cursor_row >= fb_rows) {
-        fb_scroll();
-        cursor_row = fb_rows - 1;
+    con_full = 1;
+}
+
+static void con_scroll(void) {
+    con_top = (con_top + 1) % con_lines;
+    if (con_history < con_lines - con_rows) con_history++;
+    con_blank(con_line(con_rows - 1));
+
+    /* Флаги изменений едут вместе с содержимым строк. После прокрутки на
+     * весь экран перерисовывается всё, и флаги уже не нужны. */
+    if (++con_pending < con_rows) {
+        for (uint32_t r = 1; r < con_rows; r++) con_dirty[r - 1] = con_dirty[r];
+        con_dirty[con_rows - 1] = 1;
     }
 }
 
-static void fb_putc(char c) {
-    if (c == '\n') {
-        fb_newline();
-        return;
+static void con_newline(void) {
+    cursor_col = 0;
+    if (++cursor_row >= con_rows) {
+        con_scroll();
+        cursor_row = con_rows - 1;
+    }
+}
+
+static void con_backspace(void) {
+    if (cursor_col > 0) {
+        cursor_col--;
+    } else if (cursor_row > 0) {
+        cursor_row--;
+        cursor_col = con_cols - 1;
     }
-    if (c == '\b') {
-        if (cursor_col > 0) {
-            cursor_col--;
-        } else if (cursor_row > 0) {
-            cursor_row--;
-            cursor_col = fb_cols - 1;
+    con_line(cursor_row)[cursor_col] = vga_entry(' ', current_color);
+    con_dirty[cursor_row] = 1;
+}
+
+/* Разбор буфера за один проход: печатные символы до конца строки экрана
+ * пишутся в ячейки подряд, переводы строк только сдвигают кольцо — N подряд
+ * превращаются в одну прокрутку на N строк при отрисовке. */
+static void con_write(const char *buf, size_t len) {
+    /* Новый вывод возвращает просмотр истории к живому экрану. */
+    if (con_view && len) {
+        con_view = 0;
+        con_full = 1;
+    }
+    size_t i = 0;
+    while (i < len) {
+        char c = buf[i];
+        if (c == '\n') {
+            con_newline();
+            i++;
+            continue;
+        }
+        if (c == '\b') {
+            con_backspace();
+            i++;
+            continue;
+        }
+        uint16_t *line = con_line(cursor_row);
+        uint32_t col = cursor_col;
+        while (i < len && col < con_cols && buf[i] != '\n' && buf[i] != '\b')
+            line[col++] = vga_entry((unsigned char)buf[i++], current_color);
+        con_dirty[cursor_row] = 1;
+        cursor_col = col;
+        if (cursor_col >= con_cols) con_newline();
+    }
+}
+
+static void con_render(void) {
+    if (!con) return;
+    if (con_pending && !con_full &&
+        (con_pending >= con_rows || !con->scroll || con->scroll(con_pending) != 0))
+        con_full = 1;
+    for (uint32_t r = 0; r < con_rows; r++) {
+        if (!con_full && !con_dirty[r]) continue;
+        con->draw_row(r, con_view_line(r));
+        con_dirty[r] = 0;
+    }
+    con_pending = 0;
+    con_full = 0;
+    if (con->flush) con->flush();
+}
+
+/* Консоль общая для всех CPU. Вложенный vga_begin на том же CPU (печать из
+ * прерывания посреди вывода) не ждёт блокировку, а только углубляет кадр. */
+void vga_begin(void) {
+    uint64_t flags = cpu_irq_save();
+    int32_t me = (int32_t)cpu_id();
+    if (con_owner != me) {
+        spin_lock(&con_lock);
+        con_owner = me;
+        con_flags = flags;
+    }
+    con_batch++;
+}
+
+void vga_end(void) {
+    if (--con_batch > 0) return;
+    con_render();
+    uint64_t flags = con_flags;
+    con_owner = -1;
+    spin_unlock(&con_lock);
+    cpu_irq_restore(flags);
+}
+
+/* --- Бэкенд текстового режима --- */
+
+static void text_draw_row(uint32_t row, const uint16_t *cells) {
+    volatile uint16_t *dst = VGA_MEMORY + row * VGA_WIDTH;
+    for (uint32_t c = 0; c < con_cols; c++) dst[c] = cells[c];
+}
+
+static const con_backend_t text_backend = { text_draw_row, 0, 0 };
+
+/* --- Бэкенд framebuffer --- */
+
+static uint32_t color_pixel(uint8_t color) {
+    return fb_ops->pack(vga_to_rgb[color & 15]);
+}
+
+static void fb_build_atlas(uint8_t attr) {
+    uint32_t fg = color_pixel(attr), bg = color_pixel(attr >> 4);
+    for (uint32_t ch = 0; ch < FONT_GLYPHS; ch++) {
+        for (uint32_t row = 0; row < FONT_CELL_H; row++)
+            fb_ops->glyph_row(glyph_atlas[ch][row], font8x16[ch][row], fg, bg);
+    }
+    atlas_attr = attr;
+}
+
+/* Ячейка символа — CHAR_H копий строк атласа по CHAR_W пикселей. Ячейки
+ * других цветов (старый вывод) разворачиваются построчно без атласа. */
+static void fb_draw_cell(uint32_t px, uint32_t py, uint16_t cell) {
+    uint8_t attr = (uint8_t)(cell >> 8);
+    unsigned char ch = (unsigned char)(cell & 0x7F);
+    uint32_t span = CHAR_W * (fb_bpp / 8);
+    volatile uint8_t *dst = fb_view() + (uint64_t)py * fb_pitch + (uint64_t)px * (fb_bpp / 8);
+
+    if (attr != current_color) {
+        uint8_t line[ATLAS_ROW];
+        uint32_t fg = color_pixel(attr), bg = color_pixel(attr >> 4);
+        for (uint32_t row = 0; row < FONT_CELL_H; row++) {
+            fb_ops->glyph_row(line, font8x16[ch][row], fg, bg);
+            for (uint32_t sy = 0; sy < CHAR_SCALE; sy++) {
+                memcpy((void *)dst, line, span);
+                dst += fb_pitch;
+            }
         }
-        fb_draw_char(cursor_col * CHAR_W, cursor_row * CHAR_H, ' ', fb_fg, fb_bg);
         return;
     }
-    fb_draw_char(cursor_col * CHAR_W, cursor_row * CHAR_H, (unsigned char)c, fb_fg, fb_bg);
-    cursor_col++;
-    if (cursor_col >= fb_cols) {
-        fb_newline();
+
+    if (atlas_attr != attr) fb_build_atlas(attr);
+    const uint8_t (*glyph)[ATLAS_ROW] = glyph_atlas[ch];
+    for (uint32_t row = 0; row < FONT_CELL_H; row++) {
+        for (uint32_t sy = 0; sy < CHAR_SCALE; sy++) {
+            memcpy((void *)dst, glyph[row], span);
+            dst += fb_pitch;
+        }
+    }
+}
+
+static void fb_draw_row(uint32_t row, const uint16_t *cells) {
+    for (uint32_t c = 0; c < con_cols; c++)
+        fb_draw_cell(c * CHAR_W, row * CHAR_H, cells[c]);
+    fb_mark(0, row * CHAR_H, con_cols * CHAR_W, CHAR_H);
+}
+
+/* С BGA окно сдвигается по виртуальному буферу, и память двигается лишь при
+ * достижении его конца (окно переносится в начало). Без BGA сдвиг идёт в
+ * теневом буфере в RAM, а в VRAM экран только пишется. Новые нижние строки
+ * рисует con_render. */
+static int fb_scroll_rows(uint32_t n) {
+    uint32_t dy = n * CHAR_H;
+    uint32_t text_h = con_rows * CHAR_H;
+
+    if (fb_hw_scroll && fb_yoff + dy + fb_height <= fb_lines) {
+        fb_yoff += dy;
+        /* Полоса под текстом (высота экрана не кратна строке). */
+        fb_fill_rows(text_h, fb_height);
+        fb_mark(0, text_h, fb_width, fb_height - text_h);
+        return 0;
     }
+
+    volatile uint8_t *src = fb_view() + (uint64_t)dy * fb_pitch;
+    if (fb_hw_scroll) fb_yoff = 0;
+    memmove((void *)fb_view(), (const void *)src, (uint64_t)(text_h - dy) * fb_pitch);
+    if (fb_hw_scroll) fb_fill_rows(text_h, fb_height);
+    fb_mark(0, 0, fb_width, fb_height);
+    return 0;
+}
+
+static const con_backend_t fb_backend = { fb_draw_row, fb_scroll_rows, fb_flush };
+
+static void fb_clear(void) {
+    fb_fill_rows(0, fb_height);
+    fb_mark(0, 0, fb_width, fb_height);
 }
 
 void vga_init(vga_color_t fg, vga_color_t bg) {
     multiboot_fb_info_t fb_info;
-    if (multiboot2_get_framebuffer(&fb_info) && fb_info.type == MULTIBOOT_FB_TYPE_RGB && fb_info.bpp >= 16) {
+    current_color = vga_entry_color(fg, bg);
+
+    if (multiboot2_get_framebuffer(&fb_info) && fb_info.type == MULTIBOOT_FB_TYPE_RGB &&
+        fb_select_ops(&fb_info)) {
         use_fb = 1;
+        fb_ops = fb_select_ops(&fb_info);
         fb_base = (volatile uint8_t *)(uintptr_t)fb_info.addr;
+        fb_draw = fb_base;
         fb_pitch = fb_info.pitch;
         fb_width = fb_info.width;
         fb_height = fb_info.height;
@@ -165,123 +518,151 @@ void vga_init(vga_color_t fg, vga_color_t bg) {
         fb_blue_shift = fb_info.blue_shift;
         fb_blue_size = fb_info.blue_mask ? (uint8_t)fb_info.blue_mask : 8;
 
-        /* Белый текст: явно 0xAARRGGBB (R=G=B=255). Обход неверного формата из multiboot. */
-        fb_fg = 0x00FFFFFF;
-        fb_bg = 0x00000000;
-        if (fg != VGA_COLOR_WHITE || bg != VGA_COLOR_BLACK) {
-            uint32_t fg_rgb = vga_to_rgb[fg & 15];
-            uint32_t bg_rgb = vga_to_rgb[bg & 15];
-            fb_fg = fb_make_pixel((uint8_t)(fg_rgb >> 16), (uint8_t)(fg_rgb >> 8), (uint8_t)(fg_rgb));
-            fb_bg = fb_make_pixel((uint8_t)(bg_rgb >> 16), (uint8_t)(bg_rgb >> 8), (uint8_t)(bg_rgb));
+        /* Виртуальная высота хотя бы на строку текста больше экрана — иначе
+         * остаётся программная прокрутка. */
+        fb_lines = fb_height;
+        fb_yoff = 0;
+        fb_shown_yoff = 0;
+        fb_hw_scroll = 0;
+        if (fb_pitch == fb_width * (fb_bpp / 8) && bga_detect()) {
+            uint32_t lines = bga_setup_virtual(fb_width, fb_height, fb_bpp);
+            if (lines >= fb_height + CHAR_H) {
+                fb_lines = lines;
+                fb_hw_scroll = 1;
+            }
         }
 
-        cursor_row = 0;
-        cursor_col = 0;
+        fb_bg = color_pixel(current_color >> 4);
+        atlas_attr = -1;
+
+        con = &fb_backend;
+        con_layout(fb_cols, fb_rows);
         fb_clear();
+        con_render();
         return;
     }
 
     use_fb = 0;
-    current_color = vga_entry_color(fg, bg);
-    cursor_row = 0;
-    cursor_col = 0;
-    vga_clear();
+    con = &text_backend;
+    con_layout(VGA_WIDTH, VGA_HEIGHT);
+    con_render();
 }
 
 void vga_clear(void) {
-    if (use_fb) {
-        cursor_row = 0;
-        cursor_col = 0;
-        fb_clear();
-        return;
-    }
-    for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            VGA_MEMORY[index] = vga_entry(' ', current_color);
-        }
-    }
+    vga_begin();
+    for (uint32_t r = 0; r < con_rows; r++) con_blank(con_line(r));
     cursor_row = 0;
     cursor_col = 0;
+    con_view = 0;
+    con_full = 1;
+    if (use_fb) fb_clear();
+    vga_end();
 }
 
 void vga_set_color(vga_color_t fg, vga_color_t bg) {
+    current_color = vga_entry_color(fg, bg);
     if (use_fb) {
-        uint32_t fg_rgb = vga_to_rgb[fg & 15];
-        uint32_t bg_rgb = vga_to_rgb[bg & 15];
-        fb_fg = fb_make_pixel((uint8_t)(fg_rgb >> 16), (uint8_t)(fg_rgb >> 8), (uint8_t)(fg_rgb));
-        fb_bg = fb_make_pixel((uint8_t)(bg_rgb >> 16), (uint8_t)(bg_rgb >> 8), (uint8_t)(bg_rgb));
-        return;
+        fb_bg = color_pixel(current_color >> 4);
     }
-    current_color = vga_entry_color(fg, bg);
 }
 
-static void vga_scroll(void) {
-    if (cursor_row < VGA_HEIGHT) return;
-    for (size_t y = 1; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            VGA_MEMORY[(y - 1) * VGA_WIDTH + x] = VGA_MEMORY[y * VGA_WIDTH + x];
-        }
-    }
-    size_t y = VGA_HEIGHT - 1;
-    for (size_t x = 0; x < VGA_WIDTH; x++) {
-        VGA_MEMORY[y * VGA_WIDTH + x] = vga_entry(' ', current_color);
-    }
-    cursor_row = VGA_HEIGHT - 1;
-    cursor_col = 0;
+void vga_set_scrollback(uint32_t lines) {
+    if (!con) return;
+    vga_begin();
+    con_scrollback = lines;
+    con_layout(con_cols, con_rows);
+    if (use_fb) fb_clear();
+    vga_end();
 }
 
-static void vga_newline(void) {
-    cursor_col = 0;
-    cursor_row++;
-    if (cursor_row >= VGA_HEIGHT) vga_scroll();
+void vga_scroll_view(int lines) {
+    int64_t view = (int64_t)con_view + lines;
+    if (view < 0) view = 0;
+    if (view > (int64_t)con_history) view = con_history;
+    if ((uint32_t)view == con_view) return;
+
+    vga_begin();
+    con_view = (uint32_t)view;
+    con_full = 1;
+    vga_end();
 }
 
 void vga_putc(char c) {
-    if (use_fb) {
-        fb_putc(c);
-        return;
-    }
-    if (c == '\n') {
-        vga_newline();
-        return;
-    }
-    if (c == '\b') {
-        if (cursor_col > 0) cursor_col--;
-        else if (cursor_row > 0) { cursor_row--; cursor_col = VGA_WIDTH - 1; }
-        const size_t index = cursor_row * VGA_WIDTH + cursor_col;
-        VGA_MEMORY[index] = vga_entry(' ', current_color);
-        return;
+    vga_write(&c, 1);
+}
+
+void vga_write(const char *buf, size_t len) {
+    vga_begin();
+    con_write(buf, len);
+    vga_end();
+}
+
+int vga_map_framebuffer(uint32_t cache) {
+    if (!use_fb) return -1;
+    uint64_t start = (uint64_t)(uintptr_t)fb_base & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = ((uint64_t)(uintptr_t)fb_base + (uint64_t)fb_pitch * fb_lines + PAGE_SIZE - 1) &
+                   ~(uint64_t)(PAGE_SIZE - 1);
+    if (vmm_protect(vmm_kernel_space(), start, end - start,
+                    VMM_WRITE | VMM_GLOBAL | VMM_NOEXEC | cache) != 0)
+        return -1;
+    /* Строки кэша со старым типом памяти не должны пережить смену. */
+    wbinvd();
+    return 0;
+}
+
+int vga_enable_shadow(void) {
+    if (!use_fb || fb_shadow) return -1;
+    uint32_t rows = (fb_height + CHAR_H - 1) / CHAR_H;
+    if (rows > FB_MAX_ROWS) return -1;
+
+    uint8_t *shadow = (uint8_t *)vmm_kernel_reserve((uint64_t)fb_pitch * fb_lines,
+                                                    VMM_WRITE | VMM_NOEXEC);
+    if (!shadow) return -1;
+
+    /* Один раз читаем видимое окно VRAM, чтобы не потерять выведенный текст. */
+    uint64_t view = (uint64_t)fb_yoff * fb_pitch;
+    memcpy(shadow + view, (const void *)(fb_base + view), (uint64_t)fb_pitch * fb_height);
+    for (uint32_t r = 0; r < rows; r++) {
+        dirty_x0[r] = fb_width;
+        dirty_x1[r] = 0;
     }
-    const size_t index = cursor_row * VGA_WIDTH + cursor_col;
-    VGA_MEMORY[index] = vga_entry((unsigned char)c, current_color);
-    if (++cursor_col >= VGA_WIDTH) vga_newline();
+    fb_dirty_rows = rows;
+    fb_shadow = shadow;
+    fb_draw = shadow;
+    return 0;
+}
+
+void vga_scroll_line(void) {
+    vga_begin();
+    con_scroll();
+    vga_end();
 }
 
 void vga_print(const char *str) {
-    while (*str) vga_putc(*str++);
+    vga_write(str, strlen(str));
 }
 
 void vga_println(const char *str) {
+    vga_begin();
     vga_print(str);
     vga_putc('\n');
+    vga_end();
 }
 
 void vga_print_uint64(uint64_t value) {
-    char buf[21];
-    int i = 0;
-    if (value == 0) { vga_putc('0'); return; }
-    while (value > 0 && i < (int)sizeof(buf)) {
-        buf[i++] = (char)('0' + (value % 10));
+    char buf[20];
+    int i = sizeof(buf);
+    do {
+        buf[--i] = (char)('0' + (value % 10));
         value /= 10;
-    }
-    while (i-- > 0) vga_putc(buf[i]);
+    } while (value > 0);
+    vga_write(buf + i, sizeof(buf) - i);
 }
 
 void vga_print_hex64(uint64_t value) {
     static const char *hex = "0123456789ABCDEF";
-    vga_print("0x");
-    for (int i = 60; i >= 0; i -= 4) {
-        vga_putc(hex[(value >> i) & 0xF]);
-    }
+    char buf[18] = { '0', 'x' };
+    for (int i = 0; i < 16; i++)
+        buf[2 + i] = hex[(value >> (60 - 4 * i)) & 0xF];
+    vga_write(buf, sizeof(buf));
 }
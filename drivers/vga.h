@@ -28,10 +28,38 @@ void vga_init(vga_color_t fg, vga_color_t bg);
 void vga_clear(void);
 void vga_set_color(vga_color_t fg, vga_color_t bg);
 void vga_putc(char c);
+/* Вывести len байт одним проходом: одна отрисовка на весь буфер. */
+void vga_write(const char *buf, size_t len);
 void vga_print(const char *str);
 void vga_println(const char *str);
 void vga_print_hex64(uint64_t value);
 void vga_print_uint64(uint64_t value);
 
+/* Объединить вывод между begin и end (вложенные пары допустимы) в одну
+ * отрисовку. */
+void vga_begin(void);
+void vga_end(void);
+
+/* Переотобразить framebuffer с типом памяти VMM_WRITECOMB или VMM_UNCACHED
+ * (после vmm_init). Возвращает -1 в текстовом режиме. */
+int vga_map_framebuffer(uint32_t cache);
+
+/* Рисовать в теневой буфер в RAM и переносить в VRAM только изменённые
+ * участки. Нужны vmm и обработчик #PF (буфер выделяется лениво). */
+int vga_enable_shadow(void);
+
+/* Прокрутить экран на одну строку текста. */
+void vga_scroll_line(void);
+
+/* Строк истории прокрутки по умолчанию. */
+#define VGA_DEFAULT_SCROLLBACK 500
+
+/* Размер истории в строках (ограничен буфером ячеек). Очищает экран. */
+void vga_set_scrollback(uint32_t lines);
+
+/* Просмотр истории: lines > 0 — назад, < 0 — вперёд. Любой вывод
+ * возвращает к живому экрану. */
+void vga_scroll_view(int lines);
+
 #endif /* VGA_H */
 
@@ -1,5 +1,6 @@
 #include "fs.h"
 #include "vga.h"
+#include "string.h"
 
 #define FS_MAX_NODES   64
 #define FS_NAME_LEN    31
@@ -29,12 +30,10 @@ static void fs_node_init(int idx, fs_node_type_t type, int parent, const char *n
     nodes[idx].first_child = -1;
     nodes[idx].next_sibling = -1;
 
-    int i = 0;
-    while (name && name[i] && i < FS_NAME_LEN) {
-        nodes[idx].name[i] = name[i];
-        i++;
-    }
-    nodes[idx].name[i] = '\0';
+    size_t len = name ? strlen(name) : 0;
+    if (len > FS_NAME_LEN) len = FS_NAME_LEN;
+    memcpy(nodes[idx].name, name, len);
+    nodes[idx].name[len] = '\0';
     nodes[idx].data = 0;
     nodes[idx].size = 0;
 }
@@ -48,18 +47,10 @@ static int fs_alloc_node(void) {
     return -1;
 }
 
-static int str_eq_n(const char *a, const char *b) {
-    while (*a && *b) {
-        if (*a != *b) return 0;
-        a++; b++;
-    }
-    return *a == '\0' && *b == '\0';
-}
-
 static int fs_find_child(int dir_idx, const char *name) {
     int child = nodes[dir_idx].first_child;
     while (child != -1) {
-        if (str_eq_n(nodes[child].name, name)) {
+        if (strcmp(nodes[child].name, name) == 0) {
             return child;
         }
         child = nodes[child].next_sibling;
@@ -91,9 +82,9 @@ static int fs_resolve(const char *path, int base) {
         if (c == '/' || c == '\0') {
             part[pi] = '\0';
             if (pi > 0) {
-                if (str_eq_n(part, ".")) {
+                if (strcmp(part, ".") == 0) {
                     /* ничего */
-                } else if (str_eq_n(part, "..")) {
+                } else if (strcmp(part, "..") == 0) {
                     if (nodes[idx].parent != -1)
                         idx = nodes[idx].parent;
                 } else {
@@ -166,7 +157,7 @@ int fs_mkdir(const char *path) {
         char tmp[FS_NAME_LEN + 1];
         int len = (int)(last_slash - path);
         if (len > FS_NAME_LEN) len = FS_NAME_LEN;
-        for (int i = 0; i < len; ++i) tmp[i] = path[i];
+        memcpy(tmp, path, len);
         tmp[len] = '\0';
         parent = fs_resolve(tmp, current_dir);
         if (parent == -1) return -1;
@@ -197,7 +188,7 @@ int fs_touch(const char *path) {
         char tmp[FS_NAME_LEN + 1];
         int len = (int)(last_slash - path);
         if (len > FS_NAME_LEN) len = FS_NAME_LEN;
-        for (int i = 0; i < len; ++i) tmp[i] = path[i];
+        memcpy(tmp, path, len);
         tmp[len] = '\0';
         parent = fs_resolve(tmp, current_dir);
         if (parent == -1) return -1;
@@ -238,15 +229,13 @@ int fs_write_file(const char *path, const char *data) {
     int slot = idx % FS_MAX_NODES;
     char *dst = storage[slot];
 
-    int i = 0;
-    while (data[i] && i < 127) {
-        dst[i] = data[i];
-        i++;
-    }
-    dst[i] = '\0';
+    size_t len = strlen(data);
+    if (len > 127) len = 127;
+    memcpy(dst, data, len);
+    dst[len] = '\0';
 
     nodes[idx].data = dst;
-    nodes[idx].size = (uint64_t)i;
+    nodes[idx].size = len;
     return 0;
 }
 
@@ -257,9 +246,8 @@ int fs_read_file(const char *path, char *buf, uint64_t max_len, uint64_t *out_le
 
     uint64_t n = nodes[idx].size;
     if (n >= max_len) n = max_len - 1;
-    for (uint64_t i = 0; i < n; ++i) {
-        buf[i] = nodes[idx].data ? nodes[idx].data[i] : 0;
-    }
+    if (nodes[idx].data) memcpy(buf, nodes[idx].data, n);
+    else memset(buf, 0, n);
     buf[n] = '\0';
     if (out_len) *out_len = n;
     return 0;
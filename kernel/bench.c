@@ -0,0 +1,726 @@
+#include "bench.h"
+#include "vga.h"
+#include "cpu.h"
+#include "vmm.h"
+#include "pmm.h"
+#include "paging.h"
+#include "multiboot2.h"
+#include "string.h"
+#include "fpu.h"
+#include "irq.h"
+#include "pic.h"
+#include "clock.h"
+#include "timer.h"
+#include "sched.h"
+#include "process.h"
+#include "smp.h"
+#include "syscall.h"
+#include "vdso.h"
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct bench {
+    const char *name;
+    const char *help;
+    void (*run)(void);
+} bench_t;
+
+/* --- Переключение адресных пространств (CR3) с PCID и без --- */
+
+#define CR3_PAGES   32      /* страниц, которые задача трогает после переключения */
+#define CR3_ROUNDS  2000
+
+static vm_space_t *cr3_space_new(void) {
+    vm_space_t *s = vmm_space_create();
+    if (!s) return 0;
+    for (uint64_t i = 0; i < CR3_PAGES; i++) {
+        uint64_t frame = pmm_alloc_frame();
+        if (!frame || vmm_map(s, USER_SPACE_BASE + i * PAGE_SIZE, frame, PAGE_SIZE,
+                              VMM_WRITE | VMM_USER | VMM_NOEXEC) != 0) {
+            if (frame) pmm_free_frame(frame);
+            vmm_space_destroy(s);
+            return 0;
+        }
+    }
+    return s;
+}
+
+static void cr3_touch(void) {
+    for (uint64_t i = 0; i < CR3_PAGES; i++)
+        (void)*(volatile uint64_t *)(uintptr_t)(USER_SPACE_BASE + i * PAGE_SIZE);
+}
+
+static uint64_t cr3_measure(vm_space_t *a, vm_space_t *b) {
+    vm_space_t *prev = vmm_space_current();
+    uint64_t t0 = rdtsc();
+    for (int r = 0; r < CR3_ROUNDS; r++) {
+        vmm_space_switch(a);
+        cr3_touch();
+        vmm_space_switch(b);
+        cr3_touch();
+    }
+    uint64_t cycles = rdtsc() - t0;
+    vmm_space_switch(prev);
+    return cycles / (CR3_ROUNDS * 2);
+}
+
+static void bench_cr3(void) {
+    vm_space_t *a = cr3_space_new();
+    vm_space_t *b = cr3_space_new();
+    if (!a || !b) {
+        vga_println("bench: out of memory");
+        vmm_space_destroy(a);
+        vmm_space_destroy(b);
+        return;
+    }
+
+    int had_pcid = vmm_pcid_enabled();
+
+    vmm_use_pcid(0);
+    uint64_t no_pcid = cr3_measure(a, b);
+    vga_print("switch + touch ");
+    vga_print_uint64(CR3_PAGES);
+    vga_print(" pages, no PCID: ");
+    vga_print_uint64(no_pcid);
+    vga_println(" cycles");
+
+    if (cpu_has(CPU_FEAT_PCID)) {
+        vmm_use_pcid(1);
+        uint64_t with_pcid = cr3_measure(a, b);
+        vga_print("switch + touch ");
+        vga_print_uint64(CR3_PAGES);
+        vga_print(" pages, PCID:    ");
+        vga_print_uint64(with_pcid);
+        vga_println(" cycles");
+    } else {
+        vga_println("PCID not supported by this CPU");
+    }
+
+    vmm_use_pcid(had_pcid);
+    vmm_space_destroy(a);
+    vmm_space_destroy(b);
+}
+
+/* --- Стоимость #PF с ленивым обнулением фрейма --- */
+
+#define FAULT_PAGES 256
+
+static void bench_fault(void) {
+    vm_space_t *s = vmm_space_create();
+    if (!s || vmm_region_reserve(s, USER_SPACE_BASE, FAULT_PAGES * PAGE_SIZE,
+                                 VMM_WRITE | VMM_USER | VMM_NOEXEC) != 0) {
+        vga_println("bench: out of memory");
+        vmm_space_destroy(s);
+        return;
+    }
+
+    vm_space_t *prev = vmm_space_current();
+    vmm_space_switch(s);
+    uint64_t t0 = rdtsc();
+    for (uint64_t i = 0; i < FAULT_PAGES; i++)
+        *(volatile uint64_t *)(uintptr_t)(USER_SPACE_BASE + i * PAGE_SIZE) = i;
+    uint64_t cycles = rdtsc() - t0;
+    vmm_space_switch(prev);
+
+    vga_print("demand-zero fault: ");
+    vga_print_uint64(cycles / FAULT_PAGES);
+    vga_print(" cycles/page, resident ");
+    vga_print_uint64(s->resident);
+    vga_print(" of ");
+    vga_print_uint64(FAULT_PAGES);
+    vga_println(" pages");
+    vmm_space_destroy(s);
+}
+
+/* --- fork: копирование таблиц против размера родителя --- */
+
+static const uint64_t fork_sizes[] = { 16, 256, 2048 };
+
+static void bench_fork_one(uint64_t pages) {
+    vm_space_t *parent = vmm_space_create();
+    if (!parent || vmm_region_reserve(parent, USER_SPACE_BASE, pages * PAGE_SIZE,
+                                      VMM_WRITE | VMM_USER | VMM_NOEXEC) != 0) {
+        vga_println("bench: out of memory");
+        vmm_space_destroy(parent);
+        return;
+    }
+
+    vm_space_t *prev = vmm_space_current();
+    vmm_space_switch(parent);
+    for (uint64_t i = 0; i < pages; i++)
+        *(volatile uint64_t *)(uintptr_t)(USER_SPACE_BASE + i * PAGE_SIZE) = i;
+    vmm_space_switch(prev);
+
+    uint64_t t0 = rdtsc();
+    vm_space_t *child = vmm_space_fork(parent);
+    uint64_t fork_cycles = rdtsc() - t0;
+    if (!child) {
+        vga_println("bench: out of memory");
+        vmm_space_destroy(parent);
+        return;
+    }
+
+    /* Первая запись в ребёнке копирует страницу. */
+    vmm_space_switch(child);
+    t0 = rdtsc();
+    for (uint64_t i = 0; i < pages; i++)
+        *(volatile uint64_t *)(uintptr_t)(USER_SPACE_BASE + i * PAGE_SIZE) = 0;
+    uint64_t cow_cycles = rdtsc() - t0;
+    vmm_space_switch(prev);
+
+    vga_print_uint64(pages);
+    vga_print(" pages: fork ");
+    vga_print_uint64(fork_cycles);
+    vga_print(" cycles (");
+    vga_print_uint64(fork_cycles / pages);
+    vga_print("/page), copy on write ");
+    vga_print_uint64(cow_cycles / pages);
+    vga_println(" cycles/page");
+
+    vmm_space_destroy(child);
+    vmm_space_destroy(parent);
+}
+
+static void bench_fork(void) {
+    for (unsigned i = 0; i < sizeof(fork_sizes) / sizeof(fork_sizes[0]); i++)
+        bench_fork_one(fork_sizes[i]);
+}
+
+/* --- Очистка и прокрутка framebuffer: uncached против write-combining --- */
+
+#define FB_SCROLLS 4
+
+static void fb_measure(uint32_t cache, uint64_t *clear, uint64_t *scroll) {
+    vga_map_framebuffer(cache);
+    uint64_t t0 = rdtsc();
+    vga_clear();
+    *clear = rdtsc() - t0;
+    t0 = rdtsc();
+    for (int i = 0; i < FB_SCROLLS; i++) vga_scroll_line();
+    *scroll = (rdtsc() - t0) / FB_SCROLLS;
+}
+
+static void bench_fb(void) {
+    /* Смена типа памяти в kernel_space сбрасывает TLB и кэш только на этом
+     * CPU, а рассылки сброса на другие CPU нет. */
+    if (smp_cpu_count() > 1) {
+        vga_println("bench: fb needs a single CPU");
+        return;
+    }
+    multiboot_fb_info_t fb;
+    if (!multiboot2_get_framebuffer(&fb) || vga_map_framebuffer(VMM_WRITECOMB) != 0) {
+        vga_println("bench: no framebuffer console");
+        return;
+    }
+
+    uint64_t uc_clear, uc_scroll, wc_clear, wc_scroll;
+    fb_measure(VMM_UNCACHED, &uc_clear, &uc_scroll);
+    fb_measure(VMM_WRITECOMB, &wc_clear, &wc_scroll);
+
+    vga_clear();
+    vga_print("framebuffer ");
+    vga_print_uint64(fb.width);
+    vga_putc('x');
+    vga_print_uint64(fb.height);
+    vga_putc('x');
+    vga_print_uint64(fb.bpp);
+    vga_putc('\n');
+    vga_print("uncached:        clear ");
+    vga_print_uint64(uc_clear);
+    vga_print(" cycles, scroll ");
+    vga_print_uint64(uc_scroll);
+    vga_println(" cycles");
+    vga_print("write-combining: clear ");
+    vga_print_uint64(wc_clear);
+    vga_print(" cycles, scroll ");
+    vga_print_uint64(wc_scroll);
+    vga_println(" cycles");
+}
+
+/* --- memcpy/memset: такты на байт для каждого варианта --- */
+
+#define MEM_BUF_PAGES 256                    /* 1 MiB на буфер */
+#define MEM_TOTAL     (16ull << 20)          /* байт на одно измерение */
+
+static const uint64_t mem_sizes[] = { 64, 4096, MEM_BUF_PAGES * PAGE_SIZE };
+
+enum { MEM_OP_COPY, MEM_OP_SET, MEM_OP_MOVE, MEM_OP_COPY_NT, MEM_OP_SET_NT };
+
+static const char *const mem_op_names[] = {
+    "memcpy    ", "memset    ", "memmove   ", "memcpy_nt ", "memset_nt ",
+};
+
+/* Такты на байт в сотых. */
+static uint64_t mem_measure(int op, uint8_t *dst, uint8_t *src, uint64_t size) {
+    uint64_t rounds = MEM_TOTAL / size;
+    uint64_t t0 = rdtsc();
+    for (uint64_t r = 0; r < rounds; r++) {
+        switch (op) {
+        case MEM_OP_COPY:    memcpy(dst, src, size); break;
+        case MEM_OP_SET:     memset(dst, (int)r, size); break;
+        case MEM_OP_MOVE:    memmove(dst + 8, dst, size - 8); break;
+        case MEM_OP_COPY_NT: memcpy_nt(dst, src, size); break;
+        case MEM_OP_SET_NT:  memset_nt(dst, (int)r, size); break;
+        }
+    }
+    return (rdtsc() - t0) * 100 / (rounds * size);
+}
+
+static void mem_print_cpb(uint64_t hundredths) {
+    vga_print_uint64(hundredths / 100);
+    vga_putc('.');
+    if (hundredths % 100 < 10) vga_putc('0');
+    vga_print_uint64(hundredths % 100);
+}
+
+static void mem_report(const char *impl, int op, uint8_t *dst, uint8_t *src) {
+    vga_print(mem_op_names[op]);
+    vga_print(impl);
+    for (unsigned i = 0; i < sizeof(mem_sizes) / sizeof(mem_sizes[0]); i++) {
+        vga_print("  ");
+        vga_print_uint64(mem_sizes[i]);
+        vga_print(": ");
+        mem_print_cpb(mem_measure(op, dst, src, mem_sizes[i]));
+    }
+    vga_println(" cycles/byte");
+}
+
+static void bench_mem(void) {
+    uint8_t *src = (uint8_t *)(uintptr_t)pmm_alloc_pages(MEM_BUF_PAGES);
+    uint8_t *dst = (uint8_t *)(uintptr_t)pmm_alloc_pages(MEM_BUF_PAGES + 1);
+    if (!src || !dst) {
+        vga_println("bench: out of memory");
+        pmm_free_pages((uint64_t)(uintptr_t)src, MEM_BUF_PAGES);
+        pmm_free_pages((uint64_t)(uintptr_t)dst, MEM_BUF_PAGES + 1);
+        return;
+    }
+    memset(src, 0x5a, MEM_BUF_PAGES * PAGE_SIZE);
+
+    int prev = mem_use_impl(MEM_IMPL_WORDS);
+    for (int op = MEM_OP_COPY; op <= MEM_OP_MOVE; op++)
+        mem_report("words ", op, dst, src);
+    if (cpu_has(CPU_FEAT_ERMS)) {
+        mem_use_impl(MEM_IMPL_ERMS);
+        for (int op = MEM_OP_COPY; op <= MEM_OP_MOVE; op++)
+            mem_report("erms  ", op, dst, src);
+    } else {
+        vga_println("ERMS not supported by this CPU");
+    }
+    if (cpu_has(CPU_FEAT_FSRM)) {
+        mem_use_impl(MEM_IMPL_FSRM);
+        mem_report("fsrm  ", MEM_OP_COPY, dst, src);
+    } else {
+        vga_println("FSRM not supported by this CPU");
+    }
+    mem_use_impl(prev);
+
+    mem_report("      ", MEM_OP_COPY_NT, dst, src);
+    mem_report("      ", MEM_OP_SET_NT, dst, src);
+
+    pmm_free_pages((uint64_t)(uintptr_t)src, MEM_BUF_PAGES);
+    pmm_free_pages((uint64_t)(uintptr_t)dst, MEM_BUF_PAGES + 1);
+}
+
+/* --- FPU: SIMD-участок в ядре и ленивая загрузка через #NM --- */
+
+#define FPU_ROUNDS 10000
+
+static void bench_fpu(void) {
+    vga_print("FPU state area: ");
+    vga_print_uint64(fpu_state_size());
+    vga_println(" bytes");
+
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < FPU_ROUNDS; i++) {
+        kernel_fpu_begin();
+        kernel_fpu_end();
+    }
+    uint64_t pair = (rdtsc() - t0) / FPU_ROUNDS;
+
+    /* После kernel_fpu_end первая FPU-инструкция задачи ловит #NM. */
+    t0 = rdtsc();
+    for (int i = 0; i < FPU_ROUNDS; i++) {
+        kernel_fpu_begin();
+        kernel_fpu_end();
+        __asm__ volatile("fnop");
+    }
+    uint64_t lazy = (rdtsc() - t0) / FPU_ROUNDS;
+
+    vga_print("kernel_fpu_begin/end: ");
+    vga_print_uint64(pair);
+    vga_println(" cycles");
+    vga_print("  + first use (#NM, restore): ");
+    vga_print_uint64(lazy);
+    vga_println(" cycles");
+}
+
+/* --- EOI контроллера прерываний --- */
+
+#define EOI_ROUNDS 10000
+
+/* EOI без обслуживаемого запроса безвреден и у 8259, и у LAPIC. */
+static void bench_eoi(void) {
+    const irq_chip_t *chip = irq_get_chip();
+    if (!chip) {
+        vga_println("no interrupt controller");
+        return;
+    }
+    uint64_t flags = cpu_irq_save();
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < EOI_ROUNDS; i++)
+        chip->eoi(PIC_VECTOR_BASE + 1);
+    uint64_t cost = (rdtsc() - t0) / EOI_ROUNDS;
+    cpu_irq_restore(flags);
+
+    vga_print(chip->name);
+    vga_print(" EOI: ");
+    vga_print_uint64(cost);
+    vga_println(" cycles");
+}
+
+/* --- Чтение времени --- */
+
+#define CLOCK_ROUNDS 100000
+
+static void bench_clock(void) {
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < CLOCK_ROUNDS; i++)
+        (void)ktime_get_ns();
+    uint64_t cost = (rdtsc() - t0) / CLOCK_ROUNDS;
+
+    vga_print("TSC ");
+    vga_print_uint64(clock_tsc_hz());
+    vga_print(" Hz, calibrated by ");
+    vga_println(clock_calibration_source());
+    vga_print("ktime_get_ns: ");
+    vga_print_uint64(cost);
+    vga_print(" cycles (");
+    vga_print_uint64(cycles_to_ns(cost));
+    vga_println(" ns)");
+}
+
+/* --- Точность пробуждения по таймеру --- */
+
+#define TIMER_ROUNDS 200
+
+static const uint64_t timer_sleeps_ns[] = { 10 * NSEC_PER_USEC, 100 * NSEC_PER_USEC, NSEC_PER_MSEC };
+
+static void bench_timer(void) {
+    vga_print("timer source: ");
+    vga_println(timer_source_name());
+    vga_println("sleep ns   avg late ns   max late ns");
+    for (uint32_t s = 0; s < sizeof(timer_sleeps_ns) / sizeof(timer_sleeps_ns[0]); s++) {
+        uint64_t ns = timer_sleeps_ns[s], sum = 0, max = 0;
+        for (int i = 0; i < TIMER_ROUNDS; i++) {
+            uint64_t t0 = ktime_get_ns();
+            timer_sleep_ns(ns);
+            uint64_t late = ktime_get_ns() - t0 - ns;
+            sum += late;
+            if (late > max) max = late;
+        }
+        vga_print_uint64(ns);
+        vga_print("   ");
+        vga_print_uint64(sum / TIMER_ROUNDS);
+        vga_print("   ");
+        vga_print_uint64(max);
+        vga_putc('\n');
+    }
+}
+
+/* --- Переключение контекста --- */
+
+#define SCHED_ROUNDS 10000
+
+static volatile int yield_stop;
+
+static void yield_loop(void *arg) {
+    (void)arg;
+    while (!yield_stop) schedule();
+}
+
+/* Две задачи одного приоритета отдают CPU друг другу. Обе закреплены за
+ * этим CPU, иначе idle соседа заберёт поток и schedule() станет пустым. */
+static void bench_sched(void) {
+    struct process *self = process_current();
+    uint8_t pinned = self->pinned;
+    self->pinned = 1;       /* поток наследует закрепление */
+    yield_stop = 0;
+    if (!sched_spawn("yield", yield_loop, NULL, self->prio)) {
+        self->pinned = pinned;
+        vga_println("bench: no free task slot");
+        return;
+    }
+    schedule();     /* первый запуск потока — вне замера */
+
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < SCHED_ROUNDS; i++) schedule();
+    uint64_t cost = (rdtsc() - t0) / (2 * SCHED_ROUNDS);
+
+    yield_stop = 1;
+    schedule();     /* поток видит флаг и завершается */
+    self->pinned = pinned;
+
+    vga_print("context switch (yield): ");
+    vga_print_uint64(cost);
+    vga_print(" cycles, ");
+    vga_print_uint64(cycles_to_ns(cost));
+    vga_println(" ns");
+}
+
+/* --- Масштабирование по CPU --- */
+
+#define SMP_CHUNKS       256
+#define SMP_CHUNK_ITERS  20000
+
+static volatile uint32_t smp_next_chunk;
+static volatile uint32_t smp_done;
+static uint32_t smp_workers;
+static wait_queue_t smp_wait;
+
+/* Порция работы без обращений к памяти — мерим только раздачу задач. */
+static void smp_worker(void *arg) {
+    (void)arg;
+    while (__atomic_fetch_add(&smp_next_chunk, 1, __ATOMIC_RELAXED) < SMP_CHUNKS) {
+        uint64_t x = 1;
+        for (int i = 0; i < SMP_CHUNK_ITERS; i++)
+            __asm__ volatile("imul %0, %0" : "+r"(x));
+    }
+    if (__atomic_add_fetch(&smp_done, 1, __ATOMIC_ACQ_REL) == smp_workers)
+        sched_wake_all(&smp_wait);
+}
+
+static int smp_all_done(void *arg) {
+    (void)arg;
+    return __atomic_load_n(&smp_done, __ATOMIC_ACQUIRE) == smp_workers;
+}
+
+/* Время на SMP_CHUNKS порций для n потоков; 0 — не хватило слотов. Потоки
+ * создаются в очереди этого CPU, на другие их уносят idle-задачи. */
+static uint64_t smp_run(uint32_t n) {
+    smp_next_chunk = 0;
+    smp_done = 0;
+    smp_workers = n;
+    uint64_t t0 = ktime_get_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        if (!sched_spawn("smp", smp_worker, NULL, process_current()->prio)) {
+            /* Уже созданные разберут всю работу и досчитают за остальных. */
+            __atomic_fetch_add(&smp_done, n - i, __ATOMIC_ACQ_REL);
+            sched_wait(&smp_wait, smp_all_done, 0);
+            return 0;
+        }
+    }
+    sched_wait(&smp_wait, smp_all_done, 0);
+    return ktime_get_ns() - t0;
+}
+
+static void bench_smp(void) {
+    uint32_t cpus = smp_cpu_count();
+    vga_print("cpus: ");
+    vga_print_uint64(cpus);
+    vga_putc('\n');
+    vga_println("workers   ms   steals   speedup");
+    uint64_t base = 0;
+    for (uint32_t n = 1; n <= cpus; n *= 2) {
+        uint64_t steals0 = 0, steals1 = 0;
+        sched_stats_t st;
+        for (uint32_t c = 0; c < cpus; c++) { sched_get_stats(c, &st); steals0 += st.steals; }
+        uint64_t ns = smp_run(n);
+        for (uint32_t c = 0; c < cpus; c++) { sched_get_stats(c, &st); steals1 += st.steals; }
+        if (!ns) {
+            vga_println("bench: no free task slot");
+            return;
+        }
+        if (!base) base = ns;
+        vga_print_uint64(n);
+        vga_print("   ");
+        vga_print_uint64(ns / NSEC_PER_MSEC);
+        vga_print("   ");
+        vga_print_uint64(steals1 - steals0);
+        vga_print("   x");
+        vga_print_uint64(base / ns);
+        vga_putc('.');
+        vga_print_uint64(base * 10 / ns % 10);
+        vga_putc('\n');
+    }
+}
+
+/* --- Вызовы из user mode: syscall и vDSO --- */
+
+#define SYSCALL_ROUNDS  100000
+#define SYSCALL_CODE    USER_SPACE_BASE
+#define SYSCALL_DATA    (USER_SPACE_BASE + PAGE_SIZE)
+#define SYSCALL_STACK   (USER_SPACE_BASE + 2 * PAGE_SIZE)
+#define SYSCALL_WAIT_NS (5 * NSEC_PER_SEC)
+
+/* Код пользователя (bench_user.asm). */
+extern uint8_t bench_user_start[], bench_user_end[];
+
+/* Страница данных кода пользователя: что вызывать и результат. */
+struct user_bench {
+    uint64_t rounds;
+    uint64_t cycles;
+    volatile uint64_t done;
+    uint64_t nr;            /* номер syscall, если fn == 0 */
+    uint64_t fn;            /* адрес функции vDSO */
+    uint64_t arg0, arg1;
+    uint8_t  out[64];       /* сюда пишут clock_gettime/gettimeofday */
+};
+
+_Static_assert(offsetof(struct user_bench, arg1) == 48, "bench_user.asm");
+
+#define USER_BENCH_OUT (SYSCALL_DATA + offsetof(struct user_bench, out))
+
+/* Обнулённая страница пространства s; 0 при нехватке памяти. */
+static uint64_t syscall_map_page(vm_space_t *s, uint64_t virt, uint32_t flags) {
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) return 0;
+    if (vmm_map(s, virt, frame, PAGE_SIZE, flags | VMM_USER) != 0) {
+        pmm_free_frame(frame);
+        return 0;
+    }
+    memset((void *)(uintptr_t)frame, 0, PAGE_SIZE);
+    return frame;
+}
+
+/* Поток ядра, который уходит в user mode в пространстве arg и там
+ * завершается через SYS_exit. Если vDSO отобразить не удалось — done с
+ * нулём тактов: страницу данных держит user_bench_run, она переживёт s. */
+static void syscall_task(void *arg) {
+    vm_space_t *s = (vm_space_t *)arg;
+    struct process *self = process_current();
+    if (vdso_map(s, self->pid) != 0) {
+        uint64_t data = 0;
+        vmm_translate(s, SYSCALL_DATA, &data);
+        vmm_space_destroy(s);
+        struct user_bench *ub = (struct user_bench *)(uintptr_t)(data & ~(uint64_t)(PAGE_SIZE - 1));
+        ub->cycles = 0;
+        ub->done = 1;
+        return;
+    }
+    self->space = s;
+    vmm_space_switch(s);
+    syscall_enter_user(SYSCALL_CODE, SYSCALL_STACK + PAGE_SIZE);
+}
+
+/* Тактов на вызов: SYSCALL_ROUNDS раз syscall nr (fn == 0) или функция vDSO
+ * fn с аргументами arg0, arg1. 0 — не получилось. */
+static uint64_t user_bench_run(uint64_t nr, uint64_t fn, uint64_t arg0, uint64_t arg1) {
+    vm_space_t *s = vmm_space_create();
+    uint64_t code = s ? syscall_map_page(s, SYSCALL_CODE, 0) : 0;
+    uint64_t data = code ? syscall_map_page(s, SYSCALL_DATA, VMM_WRITE | VMM_NOEXEC) : 0;
+    uint64_t stack = data ? syscall_map_page(s, SYSCALL_STACK, VMM_WRITE | VMM_NOEXEC) : 0;
+    /* Страница данных переживёт пространство: оно уйдёт вместе с задачей. */
+    if (!stack || pmm_frame_get(data) != 0) {
+        vga_println("bench: out of memory");
+        vmm_space_destroy(s);
+        return 0;
+    }
+    memcpy((void *)(uintptr_t)code, bench_user_start, (size_t)(bench_user_end - bench_user_start));
+    struct user_bench *ub = (struct user_bench *)(uintptr_t)data;
+    ub->rounds = SYSCALL_ROUNDS;
+    ub->nr = nr;
+    ub->fn = fn;
+    ub->arg0 = arg0;
+    ub->arg1 = arg1;
+
+    if (!sched_spawn("syscall", syscall_task, s, process_current()->prio)) {
+        vga_println("bench: no free task slot");
+        vmm_space_destroy(s);
+        pmm_frame_put(data);
+        return 0;
+    }
+    uint64_t t0 = ktime_get_ns();
+    while (!ub->done && ktime_get_ns() - t0 < SYSCALL_WAIT_NS)
+        sched_sleep_ns(NSEC_PER_MSEC);
+    if (!ub->done) {
+        /* Задача жива и может ещё писать в страницу — не отдаём её. */
+        vga_println("bench: user task did not finish");
+        return 0;
+    }
+
+    uint64_t cycles = ub->cycles;
+    pmm_frame_put(data);
+    if (cycles == 0) {
+        vga_println("bench: out of memory");
+        return 0;
+    }
+    uint64_t cost = cycles / SYSCALL_ROUNDS;
+    return cost ? cost : 1;
+}
+
+static void print_cycles_ns(uint64_t cycles) {
+    vga_print_uint64(cycles);
+    vga_print(" cycles, ");
+    vga_print_uint64(cycles_to_ns(cycles));
+    vga_println(" ns");
+}
+
+/* Пустой вызов из ring 3: полный круг swapgs, кадр pt_regs, таблица
+ * вызовов и быстрый выход через SYSRET. */
+static void bench_syscall(void) {
+    uint64_t cost = user_bench_run(SYS_getpid, 0, 0, 0);
+    if (!cost) return;
+    vga_print("null syscall (getpid): ");
+    print_cycles_ns(cost);
+}
+
+/* То же самое через syscall и через vDSO. */
+static void bench_vdso(void) {
+    static const struct {
+        const char *name;
+        uint64_t nr, fn, arg0, arg1;
+    } calls[] = {
+        { "clock_gettime", SYS_clock_gettime, VDSO_CLOCK_GETTIME, CLOCK_MONOTONIC, USER_BENCH_OUT },
+        { "gettimeofday", SYS_gettimeofday, VDSO_GETTIMEOFDAY, USER_BENCH_OUT, 0 },
+        { "getpid", SYS_getpid, VDSO_GETPID, 0, 0 },
+    };
+    vga_println("call            syscall cyc   vdso cyc");
+    for (unsigned i = 0; i < sizeof(calls) / sizeof(calls[0]); i++) {
+        uint64_t sys = user_bench_run(calls[i].nr, 0, calls[i].arg0, calls[i].arg1);
+        uint64_t fast = sys ? user_bench_run(calls[i].nr, calls[i].fn, calls[i].arg0, calls[i].arg1) : 0;
+        if (!fast) return;
+        vga_print(calls[i].name);
+        vga_print("   ");
+        vga_print_uint64(sys);
+        vga_print("   ");
+        vga_print_uint64(fast);
+        vga_putc('\n');
+    }
+}
+
+static const bench_t benches[] = {
+    { "cr3", "address space switch with/without PCID", bench_cr3 },
+    { "fault", "demand-zero page fault cost", bench_fault },
+    { "fork", "copy-on-write fork vs parent size", bench_fork },
+    { "fb", "framebuffer clear/scroll, uncached vs write-combining", bench_fb },
+    { "mem", "memcpy/memset/memmove cycles per byte per variant", bench_mem },
+    { "fpu", "kernel FPU section and lazy #NM restore cost", bench_fpu },
+    { "eoi", "end-of-interrupt cost of the active controller", bench_eoi },
+    { "clock", "ktime_get_ns cost", bench_clock },
+    { "timer", "one-shot timer wakeup latency", bench_timer },
+    { "sched", "context switch cost between two kernel tasks", bench_sched },
+    { "smp", "work spread over CPUs by idle stealing", bench_smp },
+    { "syscall", "null syscall round trip from user mode", bench_syscall },
+    { "vdso", "time and getpid through syscall vs vDSO", bench_vdso },
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+int bench_run(const char *name) {
+    for (unsigned i = 0; i < BENCH_COUNT; i++) {
+        if (strcmp(name, benches[i].name) == 0) {
+            benches[i].run();
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void bench_list(void) {
+    for (unsigned i = 0; i < BENCH_COUNT; i++) {
+        vga_print("  ");
+        vga_print(benches[i].name);
+        vga_print(" - ");
+        vga_println(benches[i].help);
+    }
+}
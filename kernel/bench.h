@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Микробенчмарки ядра, команда shell "bench <имя>". Время — в тактах TSC. */
+
+/* Возвращает 0, если бенчмарк с таким именем есть. */
+int bench_run(const char *name);
+
+/* Напечатать список бенчмарков. */
+void bench_list(void);
+
+#endif /* BENCH_H */
@@ -0,0 +1,66 @@
+; bench_user.asm - код пользователя для bench syscall и bench vdso
+;
+; bench.c копирует блок bench_user_start..bench_user_end в страницу
+; пользователя, следующая за ней страница — данные (struct user_bench
+; в bench.c): что вызывать пишет ядро, такты и флаг готовности — этот код.
+; Адресация только относительно RIP, так что блок работает с любого адреса.
+
+BITS 64
+
+SECTION .text
+
+global bench_user_start
+global bench_user_end
+
+%define SYS_exit    60
+
+%define DATA        (bench_user_start + 4096)
+%define B_ROUNDS    0
+%define B_CYCLES    8
+%define B_DONE      16
+%define B_NR        24
+%define B_FN        32
+%define B_ARG0      40
+%define B_ARG1      48
+
+bench_user_start:
+    mov rbx, [rel DATA + B_ROUNDS]
+
+    ; Первый вызов — вне замера (TLB, кэш кода входа).
+    call one_call
+
+    lfence
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    mov r12, rax                    ; RBX и R12 вызовы не портят
+.loop:
+    call one_call
+    dec rbx
+    jnz .loop
+    lfence
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    sub rax, r12
+
+    mov [rel DATA + B_CYCLES], rax
+    mov qword [rel DATA + B_DONE], 1
+
+    mov eax, SYS_exit
+    xor edi, edi
+    syscall
+
+; Один вызов: функция vDSO, если она задана, иначе syscall.
+one_call:
+    mov rdi, [rel DATA + B_ARG0]
+    mov rsi, [rel DATA + B_ARG1]
+    mov rax, [rel DATA + B_FN]
+    test rax, rax
+    jz .syscall
+    jmp rax                         ; вернётся сразу в цикл
+.syscall:
+    mov rax, [rel DATA + B_NR]
+    syscall
+    ret
+bench_user_end:
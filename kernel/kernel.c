@@ -6,15 +6,39 @@
 #include "gdt.h"
 #include "process.h"
 #include "paging.h"
+#include "vmm.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "pic.h"
+#include "acpi.h"
+#include "apic.h"
+#include "clock.h"
+#include "timer.h"
+#include "sched.h"
+#include "smp.h"
+#include "vdso.h"
 #include "heap.h"
 #include "multiboot2.h"
 #include "shell.h"
 #include "fs.h"
 #include "config.h"
+#include "string.h"
 
 void kernel_main(uint32_t mb_magic, uint64_t mb_info_addr) {
     (void)mb_magic;
 
+    /* Возможности CPU (CPUID) — нужны подсистемам ниже. */
+    cpu_init();
+
+    /* Область per-CPU загрузочного процессора: база GS, cpu_id() == 0. */
+    smp_init_bsp();
+
+    /* SSE/AVX и ленивое сохранение FPU-состояния задач. */
+    fpu_init();
+
+    /* memcpy/memset: rep movsb/stosb, если CPU умеет быстро (ERMS/FSRM). */
+    string_init();
+
     /* Сохраняем multiboot info для парсинга (в т.ч. framebuffer 1920x1080). */
     multiboot2_set_info(mb_info_addr);
 
@@ -24,21 +48,53 @@ void kernel_main(uint32_t mb_magic, uint64_t mb_info_addr) {
     /* Настраиваем консоль: framebuffer 1920x1080 при наличии, иначе VGA 80x25. */
     const kernel_config_t *cfg = config_get();
     vga_init(cfg->fg, cfg->bg);
+    vga_set_scrollback(cfg->scrollback);
 
-    /* Инициализация простого аллокатора страниц от конца ядра. */
+    /* Физический аллокатор фреймов по карте памяти multiboot2. */
     paging_init();
 
+    /* Таблицы страниц во время работы: прямое отображение всей RAM. */
+    vmm_init();
+
+    /* Framebuffer — write-combining: запись в VRAM пакетами, а не по байту. */
+    vga_map_framebuffer(VMM_WRITECOMB);
+
     /* Инициализация heap (kmalloc/kfree). */
     heap_init();
 
     /* Инициализация IDT и обработчиков исключений. */
     idt_init();
 
+    /* Консоль рисует в RAM, в VRAM уходят только изменения. */
+    vga_enable_shadow();
+
     /* Минимальная таблица процессов (PID 1). */
     process_init();
 
     /* GDT/TSS и SYSCALL (User/Kernel разделение). */
     gdt_init();
+
+    /* 8259 на векторы 32–47; клавиатура работает по IRQ1. */
+    pic_init();
+
+    /* При наличии MADT — LAPIC/IOAPIC (x2APIC, если есть), 8259 маскируется. */
+    if (acpi_init() == 0) apic_init();
+
+    /* Время: TSC, откалиброванный по ACPI PM timer или PIT. */
+    clock_init();
+
+    /* vDSO: время и getpid для процессов без входа в ядро. */
+    vdso_init();
+
+    /* Таймеры без тика: LAPIC TSC-deadline/one-shot, без APIC — PIT. */
+    timer_init();
+
+    /* Планировщик: init (этот поток) и idle; вытеснение по кванту. */
+    sched_init();
+
+    /* Остальные процессоры из MADT: свои GDT/TSS, LAPIC-таймер и очередь. */
+    smp_init();
+    cpu_irq_enable();
     
     /* После инициализации всё лишнее не печатаем — сразу чистый экран и shell. */
     vga_clear();
@@ -1,34 +1,27 @@
 #include "config.h"
+#include "string.h"
 
 static kernel_config_t cfg;
 
-static int str_eq(const char *a, const char *b) {
-    while (*a && *b) {
-        if (*a != *b) return 0;
-        a++; b++;
-    }
-    return *a == '\0' && *b == '\0';
-}
-
 static vga_color_t parse_color(const char *name, vga_color_t def) {
     if (!name || !*name) return def;
     while (*name == ' ') name++;
-    if (str_eq(name, "black"))       return VGA_COLOR_BLACK;
-    if (str_eq(name, "blue"))        return VGA_COLOR_BLUE;
-    if (str_eq(name, "green"))       return VGA_COLOR_GREEN;
-    if (str_eq(name, "cyan"))        return VGA_COLOR_CYAN;
-    if (str_eq(name, "red"))         return VGA_COLOR_RED;
-    if (str_eq(name, "magenta"))     return VGA_COLOR_MAGENTA;
-    if (str_eq(name, "brown"))       return VGA_COLOR_BROWN;
-    if (str_eq(name, "lightgrey"))   return VGA_COLOR_LIGHT_GREY;
-    if (str_eq(name, "darkgrey"))    return VGA_COLOR_DARK_GREY;
-    if (str_eq(name, "lightblue"))   return VGA_COLOR_LIGHT_BLUE;
-    if (str_eq(name, "lightgreen"))  return VGA_COLOR_LIGHT_GREEN;
-    if (str_eq(name, "lightcyan"))   return VGA_COLOR_LIGHT_CYAN;
-    if (str_eq(name, "lightred"))    return VGA_COLOR_LIGHT_RED;
-    if (str_eq(name, "lightmagenta"))return VGA_COLOR_LIGHT_MAGENTA;
-    if (str_eq(name, "lightbrown"))  return VGA_COLOR_LIGHT_BROWN;
-    if (str_eq(name, "white"))       return VGA_COLOR_WHITE;
+    if (strcmp(name, "black") == 0)       return VGA_COLOR_BLACK;
+    if (strcmp(name, "blue") == 0)        return VGA_COLOR_BLUE;
+    if (strcmp(name, "green") == 0)       return VGA_COLOR_GREEN;
+    if (strcmp(name, "cyan") == 0)        return VGA_COLOR_CYAN;
+    if (strcmp(name, "red") == 0)         return VGA_COLOR_RED;
+    if (strcmp(name, "magenta") == 0)     return VGA_COLOR_MAGENTA;
+    if (strcmp(name, "brown") == 0)       return VGA_COLOR_BROWN;
+    if (strcmp(name, "lightgrey") == 0)   return VGA_COLOR_LIGHT_GREY;
+    if (strcmp(name, "darkgrey") == 0)    return VGA_COLOR_DARK_GREY;
+    if (strcmp(name, "lightblue") == 0)   return VGA_COLOR_LIGHT_BLUE;
+    if (strcmp(name, "lightgreen") == 0)  return VGA_COLOR_LIGHT_GREEN;
+    if (strcmp(name, "lightcyan") == 0)   return VGA_COLOR_LIGHT_CYAN;
+    if (strcmp(name, "lightred") == 0)    return VGA_COLOR_LIGHT_RED;
+    if (strcmp(name, "lightmagenta") == 0)return VGA_COLOR_LIGHT_MAGENTA;
+    if (strcmp(name, "lightbrown") == 0)  return VGA_COLOR_LIGHT_BROWN;
+    if (strcmp(name, "white") == 0)       return VGA_COLOR_WHITE;
     return def;
 }
 
@@ -38,14 +31,10 @@ void config_init(void) {
     cfg.bg = VGA_COLOR_BLACK;
     cfg.screen_rows = 25;
     cfg.screen_cols = 80;
+    cfg.scrollback = VGA_DEFAULT_SCROLLBACK;
 
-    const char *default_hostname = "nola";
-    int i = 0;
-    while (default_hostname[i] && i < (int)sizeof(cfg.hostname) - 1) {
-        cfg.hostname[i] = default_hostname[i];
-        i++;
-    }
-    cfg.hostname[i] = '\0';
+    static const char default_hostname[] = "nola";
+    memcpy(cfg.hostname, default_hostname, sizeof(default_hostname));
 }
 
 const kernel_config_t *config_get(void) {
@@ -78,3 +67,7 @@ void config_set_screen(uint8_t rows, uint8_t cols) {
     cfg.screen_cols = cols;
 }
 
+void config_set_scrollback(uint16_t lines) {
+    cfg.scrollback = lines;
+    vga_set_scrollback(cfg.scrollback);
+}
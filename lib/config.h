@@ -10,6 +10,7 @@ typedef struct kernel_config {
     vga_color_t bg;
     uint8_t    screen_rows;
     uint8_t    screen_cols;
+    uint16_t   scrollback;
 } kernel_config_t;
 
 void config_init(void);
@@ -17,6 +18,7 @@ const kernel_config_t *config_get(void);
 void config_set_hostname(const char *name);
 int  config_set_colors(const char *fg_name, const char *bg_name);
 void config_set_screen(uint8_t rows, uint8_t cols);
+void config_set_scrollback(uint16_t lines);
 
 #endif /* CONFIG_H */
 
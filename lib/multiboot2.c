@@ -11,6 +11,62 @@ void multiboot2_set_info(uint64_t info_addr) {
     saved_info_addr = info_addr;
 }
 
+/* Найти index-й тег заданного типа (0-based). */
+static struct multiboot_tag *find_tag(uint32_t type, int index) {
+    if (saved_info_addr == 0) return 0;
+
+    uint8_t *base = (uint8_t *)(uintptr_t)saved_info_addr;
+    uint32_t total_size = *(uint32_t *)base;
+    struct multiboot_tag *tag = (struct multiboot_tag *)(base + 8);
+
+    while ((uint8_t *)tag < base + total_size && tag->type != MULTIBOOT_TAG_TYPE_END) {
+        if (tag->type == type && index-- == 0) return tag;
+        tag = (struct multiboot_tag *)(base + (uint32_t)((uint8_t *)tag - base) + align_up(tag->size, 8u));
+    }
+    return 0;
+}
+
+int multiboot2_get_info_range(uint64_t *start, uint64_t *end) {
+    if (saved_info_addr == 0) return -1;
+    if (start) *start = saved_info_addr;
+    if (end)   *end = saved_info_addr + *(uint32_t *)(uintptr_t)saved_info_addr;
+    return 0;
+}
+
+int multiboot2_get_module(int index, uint64_t *start, uint64_t *end) {
+    struct multiboot_tag_module *mod =
+        (struct multiboot_tag_module *)find_tag(MULTIBOOT_TAG_TYPE_MODULE, index);
+    if (!mod) return -1;
+    if (start) *start = mod->mod_start;
+    if (end)   *end = mod->mod_end;
+    return 0;
+}
+
+int multiboot2_get_rsdp(uint64_t *rsdp) {
+    struct multiboot_tag *tag = find_tag(MULTIBOOT_TAG_TYPE_ACPI_NEW, 0);
+    if (!tag) tag = find_tag(MULTIBOOT_TAG_TYPE_ACPI_OLD, 0);
+    if (!tag) return -1;
+    /* Сразу за заголовком тега — сама структура RSDP. */
+    if (rsdp) *rsdp = (uint64_t)(uintptr_t)(tag + 1);
+    return 0;
+}
+
+int multiboot2_get_mmap_entry(int index, uint64_t *base, uint64_t *len, uint32_t *type) {
+    struct multiboot_tag_mmap *mmap_tag =
+        (struct multiboot_tag_mmap *)find_tag(MULTIBOOT_TAG_TYPE_MMAP, 0);
+    if (!mmap_tag || index < 0 || mmap_tag->entry_size == 0) return -1;
+
+    uint32_t count = (mmap_tag->size - sizeof(struct multiboot_tag_mmap)) / mmap_tag->entry_size;
+    if ((uint32_t)index >= count) return -1;
+
+    struct multiboot_mmap_entry *entry = (struct multiboot_mmap_entry *)
+        ((uint8_t *)mmap_tag + sizeof(struct multiboot_tag_mmap) + (uint32_t)index * mmap_tag->entry_size);
+    if (base) *base = entry->addr;
+    if (len)  *len = entry->len;
+    if (type) *type = entry->type;
+    return 0;
+}
+
 int multiboot2_get_framebuffer(multiboot_fb_info_t *fb) {
     if (!fb || saved_info_addr == 0) return 0;
 
@@ -102,7 +158,7 @@ void multiboot2_dump_info(uint32_t magic, uint64_t info_addr) {
             while (entry_ptr < mmap_end) {
                 struct multiboot_mmap_entry *entry = (struct multiboot_mmap_entry *)entry_ptr;
 
-                if (entry->type == 1) { /* usable RAM */
+                if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
                     total_usable_mem += entry->len;
                 }
 
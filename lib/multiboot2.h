@@ -17,6 +17,8 @@ enum {
     MULTIBOOT_TAG_TYPE_MMAP             = 6,
     MULTIBOOT_TAG_TYPE_VBE              = 7,
     MULTIBOOT_TAG_TYPE_FRAMEBUFFER      = 8,
+    MULTIBOOT_TAG_TYPE_ACPI_OLD         = 14,
+    MULTIBOOT_TAG_TYPE_ACPI_NEW         = 15,
 };
 
 /* Общий заголовок тега. */
@@ -34,6 +36,9 @@ struct multiboot_tag_mmap {
     /* Далее идут записи struct multiboot_mmap_entry[...] */
 } __attribute__((packed));
 
+/* Типы регионов карты памяти. */
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
 /* Запись карты памяти. */
 struct multiboot_mmap_entry {
     uint64_t addr;
@@ -59,6 +64,15 @@ void multiboot2_set_info(uint64_t info_addr);
 /* Получить модуль по индексу (0-based). Возвращает 0 при успехе. */
 int multiboot2_get_module(int index, uint64_t *start, uint64_t *end);
 
+/* Получить запись карты памяти (тег type 6) по индексу. Возвращает 0 при успехе. */
+int multiboot2_get_mmap_entry(int index, uint64_t *base, uint64_t *len, uint32_t *type);
+
+/* Копия RSDP из тега ACPI (новый тег предпочтительнее). 0 при успехе. */
+int multiboot2_get_rsdp(uint64_t *rsdp);
+
+/* Диапазон физических адресов, занятый самой структурой multiboot info. */
+int multiboot2_get_info_range(uint64_t *start, uint64_t *end);
+
 /* Framebuffer: тип 1 = RGB. */
 #define MULTIBOOT_FB_TYPE_INDEXED 0
 #define MULTIBOOT_FB_TYPE_RGB     1
@@ -0,0 +1,156 @@
+#include "string.h"
+#include "cpu.h"
+
+/* Собирается с -fno-tree-loop-distribute-patterns: иначе GCC превращает
+ * циклы ниже в вызовы самих memcpy/memset. */
+
+/* С ERMS rep movsb/stosb быстрее циклов только начиная с нескольких сотен
+ * байт (у микрокода дорогой старт); с FSRM — на любой длине. */
+#define ERMS_THRESHOLD 512
+
+/* Слово, которым можно читать и писать память любого типа и выравнивания. */
+typedef uint64_t __attribute__((may_alias, aligned(1))) word_t;
+
+static int mem_impl = MEM_IMPL_WORDS;
+static size_t copy_rep_from = (size_t)-1;   /* длина, с которой копируем rep movsb */
+static size_t set_rep_from = (size_t)-1;
+
+static void copy_rep(void *dst, const void *src, size_t n) {
+    __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) :: "memory");
+}
+
+static void set_rep(void *dst, uint8_t c, size_t n) {
+    __asm__ volatile("rep stosb" : "+D"(dst), "+c"(n) : "a"(c) : "memory");
+}
+
+/* Копирование вперёд словами по 8 байт; хвост — побайтно. */
+static void copy_words(uint8_t *d, const uint8_t *s, size_t n) {
+    for (; n >= 8; n -= 8, d += 8, s += 8)
+        *(word_t *)d = *(const word_t *)s;
+    while (n--) *d++ = *s++;
+}
+
+/* То же с конца: для memmove, когда dst правее src. */
+static void copy_words_back(uint8_t *d, const uint8_t *s, size_t n) {
+    d += n;
+    s += n;
+    for (; n >= 8; n -= 8) {
+        d -= 8;
+        s -= 8;
+        *(word_t *)d = *(const word_t *)s;
+    }
+    while (n--) *--d = *--s;
+}
+
+static void set_words(uint8_t *d, uint8_t c, size_t n) {
+    uint64_t pattern = 0x0101010101010101ull * c;
+    for (; n >= 8; n -= 8, d += 8)
+        *(word_t *)d = pattern;
+    while (n--) *d++ = c;
+}
+
+void *memcpy(void *dst, const void *src, size_t n) {
+    if (n >= copy_rep_from) copy_rep(dst, src, n);
+    else copy_words(dst, src, n);
+    return dst;
+}
+
+void *memset(void *dst, int c, size_t n) {
+    if (n >= set_rep_from) set_rep(dst, (uint8_t)c, n);
+    else set_words(dst, (uint8_t)c, n);
+    return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+    /* Вперёд можно копировать, если dst левее src: каждое слово читается
+     * раньше, чем его перезапишут. */
+    if ((uintptr_t)dst - (uintptr_t)src >= n) return memcpy(dst, src, n);
+    copy_words_back(dst, src, n);
+    return dst;
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+    const uint8_t *p = a, *q = b;
+    for (; n >= 8; n -= 8, p += 8, q += 8) {
+        if (*(const word_t *)p != *(const word_t *)q) break;
+    }
+    for (; n; n--, p++, q++) {
+        if (*p != *q) return *p < *q ? -1 : 1;
+    }
+    return 0;
+}
+
+size_t strlen(const char *s) {
+    size_t n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+int strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (int)(unsigned char)*a - (int)(unsigned char)*b;
+}
+
+/* movnti пишет слово в обход кэша через буферы write-combining; sfence
+ * в конце упорядочивает эти записи с последующими обычными. */
+static void store_nt(uint64_t *d, uint64_t v) {
+    __asm__ volatile("movnti %1, %0" : "=m"(*d) : "r"(v));
+}
+
+void *memcpy_nt(void *dst, const void *src, size_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    while (n && ((uintptr_t)d & 7)) {
+        *d++ = *s++;
+        n--;
+    }
+    for (; n >= 8; n -= 8, d += 8, s += 8)
+        store_nt((uint64_t *)d, *(const word_t *)s);
+    while (n--) *d++ = *s++;
+    __asm__ volatile("sfence" ::: "memory");
+    return dst;
+}
+
+void *memset_nt(void *dst, int c, size_t n) {
+    uint8_t *d = dst;
+    uint64_t pattern = 0x0101010101010101ull * (uint8_t)c;
+    while (n && ((uintptr_t)d & 7)) {
+        *d++ = (uint8_t)c;
+        n--;
+    }
+    for (; n >= 8; n -= 8, d += 8)
+        store_nt((uint64_t *)d, pattern);
+    while (n--) *d++ = (uint8_t)c;
+    __asm__ volatile("sfence" ::: "memory");
+    return dst;
+}
+
+int mem_use_impl(int impl) {
+    int prev = mem_impl;
+    mem_impl = impl;
+    switch (impl) {
+    case MEM_IMPL_FSRM:
+        copy_rep_from = 0;
+        set_rep_from = ERMS_THRESHOLD;
+        break;
+    case MEM_IMPL_ERMS:
+        copy_rep_from = ERMS_THRESHOLD;
+        set_rep_from = ERMS_THRESHOLD;
+        break;
+    default:
+        mem_impl = MEM_IMPL_WORDS;
+        copy_rep_from = (size_t)-1;
+        set_rep_from = (size_t)-1;
+        break;
+    }
+    return prev;
+}
+
+void string_init(void) {
+    if (cpu_has(CPU_FEAT_FSRM)) mem_use_impl(MEM_IMPL_FSRM);
+    else if (cpu_has(CPU_FEAT_ERMS)) mem_use_impl(MEM_IMPL_ERMS);
+    else mem_use_impl(MEM_IMPL_WORDS);
+}
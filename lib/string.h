@@ -0,0 +1,34 @@
+#ifndef STRING_H
+#define STRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Функции памяти для всего ядра. Реализация выбирается в string_init по
+ * CPUID: rep movsb/stosb при ERMS/FSRM, иначе циклы по 8 байт. */
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memset(void *dst, int c, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+int   memcmp(const void *a, const void *b, size_t n);
+
+size_t strlen(const char *s);
+int    strcmp(const char *a, const char *b);
+
+/* Запись мимо кэша (movnti): для VRAM и буферов, которые не будут скоро
+ * прочитаны. Не должны пересекаться с источником. */
+void *memcpy_nt(void *dst, const void *src, size_t n);
+void *memset_nt(void *dst, int c, size_t n);
+
+/* Варианты реализации (для сравнения в bench). */
+#define MEM_IMPL_WORDS  0   /* циклы по 8 байт */
+#define MEM_IMPL_ERMS   1   /* rep movsb/stosb от порога */
+#define MEM_IMPL_FSRM   2   /* rep movsb для любой длины */
+
+/* Выбрать реализацию по возможностям CPU (после cpu_init). */
+void string_init(void);
+
+/* Принудительно выбрать вариант; возвращает предыдущий. */
+int mem_use_impl(int impl);
+
+#endif /* STRING_H */
@@ -1,15 +1,8 @@
 #include "user.h"
+#include "string.h"
 
 static user_id_t current_user = USER_ROOT;
 
-static int str_eq(const char *a, const char *b) {
-    while (*a && *b) {
-        if (*a != *b) return 0;
-        a++; b++;
-    }
-    return *a == '\0' && *b == '\0';
-}
-
 void user_init(void) {
     current_user = USER_ROOT;
 }
@@ -31,11 +24,11 @@ int user_switch(const char *name) {
     while (*name == ' ') name++;
     if (*name == '\0') return -1;
 
-    if (str_eq(name, "root")) {
+    if (strcmp(name, "root") == 0) {
         current_user = USER_ROOT;
         return 0;
     }
-    if (str_eq(name, "user")) {
+    if (strcmp(name, "user") == 0) {
         current_user = USER_NORMAL;
         return 0;
     }
@@ -1,108 +1,295 @@
 #include "heap.h"
 #include "paging.h"
+#include "pmm.h"
+#include "slab.h"
+#include "vga.h"
+#include "spinlock.h"
 #include <stddef.h>
 #include <stdint.h>
 
-#define ALIGN           8
-#define MIN_BLOCK_SIZE  32   /* header 16 + min payload 16 */
-#define SPLIT_THRESH    64   /* split if remainder >= this */
+/* Куча TLSF (two-level segregated fit): свободные блоки разложены по
+ * классам размера [fl][sl], поиск подходящего класса — по битовым картам,
+ * соседи находятся по boundary tags (заголовок + footer). Все операции O(1). */
+
+#define ALIGN_LOG2      4
+#define ALIGN           (1u << ALIGN_LOG2)      /* 16 байт */
+#define SL_LOG2         5
+#define SL_COUNT        (1u << SL_LOG2)         /* 32 подкласса */
+#define FL_SHIFT        (SL_LOG2 + ALIGN_LOG2)  /* 9 */
+#define FL_MAX          40                      /* блоки до 1 TiB */
+#define FL_COUNT        (FL_MAX - FL_SHIFT + 1)
+#define SMALL_BLOCK     (1u << FL_SHIFT)        /* 512: ниже — линейные классы */
+
+#define HEAP_GROW_PAGES 16                      /* минимальный span: 64 KiB */
+#define HEAP_MAGIC      0x4E4F4C4148454150ull   /* "NOLAHEAP" */
+
+#define BLOCK_USED      ((size_t)1)
 
 typedef struct heap_block {
-    size_t size;                    /* полный размер блока включая заголовок */
-    struct heap_block *next;        /* следующий в списке свободных (если свободен) */
+    size_t size;                    /* полный размер блока; бит 0 — занят */
+    size_t magic;
+    struct heap_block *next_free;   /* только у свободных блоков */
+    struct heap_block *prev_free;
 } heap_block_t;
 
-static heap_block_t *free_list = 0;
+#define HDR_SIZE        (offsetof(heap_block_t, next_free))   /* 16 */
+#define FTR_SIZE        sizeof(size_t)
+#define MIN_BLOCK       48          /* заголовок + ссылки + footer, кратно 16 */
+
+/* Участок страниц от аллокатора фреймов. sentinel занят навсегда и служит
+ * footer'ом «левого соседа» первого блока; в конце span — пустой занятый
+ * заголовок-эпилог. */
+typedef struct heap_span {
+    struct heap_span *next;
+    struct heap_span *prev;
+    uint64_t pages;
+    size_t sentinel;
+} heap_span_t;
+
+static heap_block_t *blocks[FL_COUNT][SL_COUNT];
+static uint32_t fl_bitmap = 0;
+static uint32_t sl_bitmap[FL_COUNT];
+
+static heap_span_t *spans = 0;
+static heap_span_t *initial_span = 0;
+static heap_stats_t stats;
+static spinlock_t heap_lock = SPINLOCK_INIT;
 
 static size_t align_up(size_t n) {
-    return (n + ALIGN - 1) & ~(ALIGN - 1);
-}
-
-static void coalesce(heap_block_t *block) {
-    uintptr_t block_end = (uintptr_t)block + block->size;
-
-    /* Ищем следующий блок в памяти (должен начинаться сразу после нас) */
-    heap_block_t **p = &free_list;
-    while (*p) {
-        heap_block_t *b = *p;
-        if ((uintptr_t)b == block_end) {
-            /* Сливаем с блоком справа */
-            block->size += b->size;
-            block->next = b->next;
-            *p = block;
-            /* Рекурсивно — возможно есть ещё блоки справа */
-            coalesce(block);
-            return;
-        }
-        if ((uintptr_t)b + b->size == (uintptr_t)block) {
-            /* b заканчивается там, где начинается block — сливаем в b */
-            b->size += block->size;
-            coalesce(b);
-            return;
-        }
-        p = &(*p)->next;
+    return (n + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+}
+
+static int fls64(uint64_t v) {
+    return 63 - __builtin_clzll(v);
+}
+
+static size_t block_size(const heap_block_t *b) {
+    return b->size & ~BLOCK_USED;
+}
+
+static void block_set(heap_block_t *b, size_t size, size_t used) {
+    b->size = size | used;
+    b->magic = HEAP_MAGIC;
+    *(size_t *)((uint8_t *)b + size - FTR_SIZE) = size | used;
+}
+
+static void mapping_insert(size_t size, unsigned *fl, unsigned *sl) {
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (unsigned)(size / (SMALL_BLOCK / SL_COUNT));
+    } else {
+        int f = fls64(size);
+        *sl = (unsigned)(size >> (f - SL_LOG2)) ^ SL_COUNT;
+        *fl = (unsigned)(f - (FL_SHIFT - 1));
+    }
+}
+
+/* Класс, в котором любой блок не меньше size. */
+static void mapping_search(size_t size, unsigned *fl, unsigned *sl) {
+    if (size >= SMALL_BLOCK)
+        size += ((size_t)1 << (fls64(size) - SL_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+static void free_insert(heap_block_t *b) {
+    unsigned fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    b->prev_free = 0;
+    b->next_free = blocks[fl][sl];
+    if (b->next_free) b->next_free->prev_free = b;
+    blocks[fl][sl] = b;
+    fl_bitmap |= 1u << fl;
+    sl_bitmap[fl] |= 1u << sl;
+
+    stats.free_bytes += block_size(b);
+    stats.free_blocks++;
+}
+
+static void free_remove(heap_block_t *b) {
+    unsigned fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    if (b->prev_free) b->prev_free->next_free = b->next_free;
+    else blocks[fl][sl] = b->next_free;
+    if (b->next_free) b->next_free->prev_free = b->prev_free;
+    if (!blocks[fl][sl]) {
+        sl_bitmap[fl] &= ~(1u << sl);
+        if (!sl_bitmap[fl]) fl_bitmap &= ~(1u << fl);
     }
 
-    /* Вставляем в свободный список (сортируем по адресу для coalesce) */
-    p = &free_list;
-    while (*p && (uintptr_t)(*p) < (uintptr_t)block) {
-        p = &(*p)->next;
+    stats.free_bytes -= block_size(b);
+    stats.free_blocks--;
+}
+
+static heap_block_t *find_suitable(size_t size) {
+    unsigned fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= FL_COUNT) return 0;
+
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = fl + 1 < 32 ? fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map) return 0;
+        fl = (unsigned)__builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
     }
-    block->next = *p;
-    *p = block;
+    sl = (unsigned)__builtin_ctz(sl_map);
+    return blocks[fl][sl];
+}
+
+static heap_block_t *span_first_block(heap_span_t *span) {
+    return (heap_block_t *)(span + 1);
+}
+
+static heap_block_t *span_epilogue(heap_span_t *span) {
+    return (heap_block_t *)((uint8_t *)span + span->pages * PAGE_SIZE - HDR_SIZE);
+}
+
+/* Новый span, вмещающий блок не меньше size. Возвращает его свободный блок. */
+static heap_block_t *heap_grow(size_t size) {
+    size_t overhead = sizeof(heap_span_t) + HDR_SIZE;
+    uint64_t pages = (size + overhead + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages < HEAP_GROW_PAGES) pages = HEAP_GROW_PAGES;
+
+    heap_span_t *span = (heap_span_t *)(uintptr_t)pmm_alloc_pages(pages);
+    if (!span) return 0;
+
+    span->pages = pages;
+    span->sentinel = BLOCK_USED;
+    span->prev = 0;
+    span->next = spans;
+    if (spans) spans->prev = span;
+    spans = span;
+
+    heap_block_t *epilogue = span_epilogue(span);
+    epilogue->size = BLOCK_USED;
+    epilogue->magic = HEAP_MAGIC;
+
+    heap_block_t *b = span_first_block(span);
+    block_set(b, (size_t)((uint8_t *)epilogue - (uint8_t *)b), 0);
+    free_insert(b);
+
+    stats.spans++;
+    stats.span_bytes += pages * PAGE_SIZE;
+    return b;
+}
+
+static void span_release(heap_span_t *span) {
+    if (span->prev) span->prev->next = span->next;
+    else spans = span->next;
+    if (span->next) span->next->prev = span->prev;
+
+    stats.spans--;
+    stats.span_bytes -= span->pages * PAGE_SIZE;
+    pmm_free_pages((uint64_t)(uintptr_t)span, span->pages);
 }
 
 void heap_init(void) {
-    void *page = alloc_page_silent();
-    heap_block_t *block = (heap_block_t *)page;
-    block->size = PAGE_SIZE;
-    block->next = 0;
-    free_list = block;
+    slab_init();
+    if (heap_grow(0)) initial_span = spans;
 }
 
 void *kmalloc(size_t size) {
     if (size == 0) return 0;
 
-    size_t total = align_up(size) + sizeof(heap_block_t);
-    if (total < MIN_BLOCK_SIZE) total = MIN_BLOCK_SIZE;
-
-    for (;;) {
-        heap_block_t **prev = &free_list;
-        heap_block_t *b = free_list;
-
-        while (b) {
-            if (b->size >= total) {
-                /* Нашли подходящий блок */
-                size_t rem = b->size - total;
-                if (rem >= SPLIT_THRESH) {
-                    /* Разбиваем: новый свободный блок справа */
-                    heap_block_t *new_free = (heap_block_t *)((uint8_t *)b + total);
-                    new_free->size = rem;
-                    new_free->next = b->next;
-                    b->size = total;
-                    *prev = new_free;
-                } else {
-                    *prev = b->next;
-                }
-                b->next = 0;  /* занят */
-                return (void *)((uint8_t *)b + sizeof(heap_block_t));
-            }
-            prev = &b->next;
-            b = b->next;
-        }
+    /* Мелкие объекты — из size-class кэшей. */
+    if (size <= KMALLOC_MAX_SLAB) return kmalloc_slab(size);
 
-        /* Нет подходящего блока — берём новую страницу */
-        void *page = alloc_page_silent();
-        heap_block_t *new_block = (heap_block_t *)page;
-        new_block->size = PAGE_SIZE;
-        coalesce(new_block);
+    size_t total = align_up(size + HDR_SIZE + FTR_SIZE);
+    if (total < MIN_BLOCK) total = MIN_BLOCK;
+
+    /* Блок нового span может попасть в класс ниже искомого, поэтому
+     * берём его напрямую, а не повторным поиском. */
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    heap_block_t *b = find_suitable(total);
+    if (!b) b = heap_grow(total);
+    if (!b) {
+        spin_unlock_irqrestore(&heap_lock, flags);
+        return 0;  /* физическая память исчерпана */
+    }
+    free_remove(b);
+
+    size_t rem = block_size(b) - total;
+    if (rem >= MIN_BLOCK) {
+        heap_block_t *tail = (heap_block_t *)((uint8_t *)b + total);
+        block_set(tail, rem, 0);
+        free_insert(tail);
+    } else {
+        total = block_size(b);
     }
+    block_set(b, total, BLOCK_USED);
+
+    stats.used_bytes += total;
+    stats.used_blocks++;
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return (uint8_t *)b + HDR_SIZE;
 }
 
 void kfree(void *ptr) {
     if (!ptr) return;
+    if (kfree_slab(ptr)) return;
 
-    heap_block_t *block = (heap_block_t *)((uint8_t *)ptr - sizeof(heap_block_t));
-    block->next = 0;
-    coalesce(block);
+    heap_block_t *b = (heap_block_t *)((uint8_t *)ptr - HDR_SIZE);
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    if (b->magic != HEAP_MAGIC || !(b->size & BLOCK_USED)) {
+        spin_unlock_irqrestore(&heap_lock, flags);
+        vga_print("heap: bad free ");
+        vga_print_hex64((uint64_t)(uintptr_t)ptr);
+        vga_putc('\n');
+        return;
+    }
+
+    size_t size = block_size(b);
+    b->magic = 0;  /* повторный kfree того же указателя будет пойман */
+    stats.used_bytes -= size;
+    stats.used_blocks--;
+
+    /* Слияние с левым соседом по его footer. */
+    size_t left_tag = *(size_t *)((uint8_t *)b - FTR_SIZE);
+    if (!(left_tag & BLOCK_USED)) {
+        heap_block_t *left = (heap_block_t *)((uint8_t *)b - left_tag);
+        free_remove(left);
+        size += left_tag;
+        b = left;
+    }
+
+    /* Слияние с правым соседом по его заголовку. */
+    heap_block_t *right = (heap_block_t *)((uint8_t *)b + size);
+    if (!(right->size & BLOCK_USED)) {
+        free_remove(right);
+        size += block_size(right);
+    }
+
+    block_set(b, size, 0);
+
+    /* Полностью свободный span (кроме начального) возвращаем фреймам:
+     * слева sentinel, справа эпилог — у настоящих блоков размер ненулевой. */
+    size_t left_guard = *(size_t *)((uint8_t *)b - FTR_SIZE);
+    heap_block_t *next = (heap_block_t *)((uint8_t *)b + size);
+    if (left_guard == BLOCK_USED && next->size == BLOCK_USED) {
+        heap_span_t *span = (heap_span_t *)b - 1;
+        if (span != initial_span) {
+            span_release(span);
+            spin_unlock_irqrestore(&heap_lock, flags);
+            return;
+        }
+    }
+    free_insert(b);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+void heap_get_stats(heap_stats_t *st) {
+    if (!st) return;
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    *st = stats;
+
+    /* Крупнейший свободный блок ищем только в самом старшем непустом классе. */
+    st->largest_free = 0;
+    if (fl_bitmap) {
+        unsigned fl = (unsigned)(31 - __builtin_clz(fl_bitmap));
+        unsigned sl = (unsigned)(31 - __builtin_clz(sl_bitmap[fl]));
+        for (heap_block_t *b = blocks[fl][sl]; b; b = b->next_free) {
+            if (block_size(b) > st->largest_free) st->largest_free = block_size(b);
+        }
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
@@ -2,9 +2,23 @@
 #define HEAP_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+/* Состояние кучи (для mem и оценки фрагментации). */
+typedef struct heap_stats {
+    uint64_t spans;          /* участков страниц, взятых у аллокатора фреймов */
+    uint64_t span_bytes;
+    uint64_t used_bytes;     /* с учётом заголовков */
+    uint64_t used_blocks;
+    uint64_t free_bytes;
+    uint64_t free_blocks;
+    uint64_t largest_free;
+} heap_stats_t;
+
+/* Поднимает и slab-кэши; вызывать после paging_init(). */
 void heap_init(void);
 void *kmalloc(size_t size);
 void kfree(void *ptr);
+void heap_get_stats(heap_stats_t *st);
 
 #endif /* HEAP_H */
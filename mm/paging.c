@@ -1,25 +1,19 @@
 #include "paging.h"
+#include "pmm.h"
 #include "vga.h"
 
-/* Символ end определяется в линкер-скрипте и указывает на конец бинарника. */
-extern uint8_t end;
-
-static uint8_t *next_free_page = 0;
-
 void paging_init(void) {
-    /* Выравниваем следующий свободный адрес по границе страницы. */
-    uint64_t addr = (uint64_t)&end;
-    addr = (addr + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
-    next_free_page = (uint8_t *)addr;
+    pmm_init();
 
-    vga_print("Paging allocator initialized at address ");
-    vga_print_hex64((uint64_t)next_free_page);
-    vga_putc('\n');
+    pmm_stats_t st;
+    pmm_get_stats(&st);
+    vga_print("Physical memory: ");
+    vga_print_uint64(st.free_frames * (PAGE_SIZE / 1024));
+    vga_println(" KiB free");
 }
 
 void *alloc_page(void) {
-    void *page = next_free_page;
-    next_free_page += PAGE_SIZE;
+    void *page = (void *)(uintptr_t)pmm_alloc_frame();
 
     vga_print("Allocated page at ");
     vga_print_hex64((uint64_t)page);
@@ -29,11 +23,9 @@ void *alloc_page(void) {
 }
 
 void *alloc_page_silent(void) {
-    void *page = next_free_page;
-    next_free_page += PAGE_SIZE;
-    return page;
+    return (void *)(uintptr_t)pmm_alloc_frame();
 }
 
-uint64_t paging_get_next_free(void) {
-    return (uint64_t)next_free_page;
+void free_page(void *page) {
+    pmm_free_frame((uint64_t)(uintptr_t)page);
 }
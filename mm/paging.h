@@ -9,7 +9,6 @@
 void paging_init(void);
 void *alloc_page(void);
 void *alloc_page_silent(void);  /* без вывода в VGA */
-uint64_t paging_get_next_free(void);
+void free_page(void *page);
 
 #endif /* PAGING_H */
-
@@ -0,0 +1,374 @@
+#include "pmm.h"
+#include "multiboot2.h"
+#include "vga.h"
+#include "spinlock.h"
+#include <stddef.h>
+
+/* Символ end определяется в линкер-скрипте и указывает на конец бинарника. */
+extern uint8_t end;
+
+#define PFN(addr)   ((addr) >> 12)
+#define PHYS(pfn)   ((uint64_t)(pfn) << 12)
+
+#define MAX_RESERVED 16     /* последний слот — под массив фреймов */
+
+/* Свободный блок: ссылки хранятся прямо в первом фрейме блока. */
+typedef struct pmm_block {
+    struct pmm_block *next;
+    struct pmm_block *prev;
+} pmm_block_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} phys_range_t;
+
+static pmm_frame_t *frames = 0;      /* по записи на каждый фрейм [0, max_pfn) */
+static uint64_t max_pfn = 0;
+
+static pmm_block_t *free_area[PMM_MAX_ORDER + 1];
+static uint64_t free_count[PMM_MAX_ORDER + 1];
+static uint32_t free_mask = 0;       /* бит k: в free_area[k] есть блоки */
+
+static uint64_t mapped_limit = 0;    /* память ниже уже отдана аллокатору */
+
+static uint64_t total_frames = 0;
+static uint64_t free_frames = 0;
+static uint64_t failed_allocs = 0;
+
+/* Списки блоков и счётчики ссылок фреймов — общие для всех CPU. */
+static spinlock_t pmm_lock = SPINLOCK_INIT;
+
+static phys_range_t reserved[MAX_RESERVED];
+static int reserved_count = 0;
+
+static uint64_t align_up(uint64_t v, uint64_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+static void add_reserved(uint64_t start, uint64_t end_addr) {
+    reserved[reserved_count].start = start & ~(uint64_t)(PAGE_SIZE - 1);
+    reserved[reserved_count].end = align_up(end_addr, PAGE_SIZE);
+    reserved_count++;
+}
+
+/* -1, если таблица полна: один слот всегда остаётся массиву фреймов. */
+static int reserve_range(uint64_t start, uint64_t end_addr) {
+    if (end_addr <= start) return 0;
+    if (reserved_count >= MAX_RESERVED - 1) return -1;
+    add_reserved(start, end_addr);
+    return 0;
+}
+
+/* Самый левый зарезервированный диапазон, пересекающий [start, end_addr), или 0. */
+static phys_range_t *reserved_overlap(uint64_t start, uint64_t end_addr) {
+    phys_range_t *best = 0;
+    for (int i = 0; i < reserved_count; i++) {
+        if (start < reserved[i].end && reserved[i].start < end_addr &&
+            (!best || reserved[i].start < best->start))
+            best = &reserved[i];
+    }
+    return best;
+}
+
+static void list_push(uint64_t pfn, unsigned order) {
+    pmm_block_t *b = (pmm_block_t *)(uintptr_t)PHYS(pfn);
+    b->prev = 0;
+    b->next = free_area[order];
+    if (b->next) b->next->prev = b;
+    free_area[order] = b;
+    free_count[order]++;
+    free_mask |= 1u << order;
+
+    frames[pfn].flags = PMM_FRAME_FREE;
+    frames[pfn].order = (uint8_t)order;
+}
+
+static void list_remove(uint64_t pfn, unsigned order) {
+    pmm_block_t *b = (pmm_block_t *)(uintptr_t)PHYS(pfn);
+    if (b->prev) b->prev->next = b->next;
+    else free_area[order] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    if (--free_count[order] == 0) free_mask &= ~(1u << order);
+
+    frames[pfn].flags = 0;
+}
+
+/* Вернуть блок в свободные списки, сливая его с buddy, пока это возможно. */
+static void free_block(uint64_t pfn, unsigned order) {
+    free_frames += 1ull << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ull << order);
+        if (buddy >= max_pfn) break;
+        if (!(frames[buddy].flags & PMM_FRAME_FREE) || frames[buddy].order != order) break;
+        list_remove(buddy, order);
+        pfn &= ~(1ull << order);
+        order++;
+    }
+    list_push(pfn, order);
+}
+
+static uint64_t alloc_block(unsigned order) {
+    if (order > PMM_MAX_ORDER) return 0;
+
+    uint32_t mask = free_mask >> order;
+    if (!mask) {
+        failed_allocs++;
+        return 0;
+    }
+
+    unsigned cur = order + (unsigned)__builtin_ctz(mask);
+    uint64_t pfn = PFN((uint64_t)(uintptr_t)free_area[cur]);
+    list_remove(pfn, cur);
+
+    /* Отщепляем верхние половины, пока не получим блок нужного порядка. */
+    while (cur > order) {
+        cur--;
+        list_push(pfn + (1ull << cur), cur);
+    }
+
+    frames[pfn].order = (uint8_t)order;
+    frames[pfn].refcount = 1;
+    free_frames -= 1ull << order;
+    return PHYS(pfn);
+}
+
+/* Освободить произвольный участок фреймов выровненными блоками. */
+static void free_run(uint64_t pfn, uint64_t count) {
+    while (count) {
+        unsigned order = 0;
+        while (order < PMM_MAX_ORDER &&
+               (pfn & ((2ull << order) - 1)) == 0 &&
+               (2ull << order) <= count) {
+            order++;
+        }
+        free_block(pfn, order);
+        pfn += 1ull << order;
+        count -= 1ull << order;
+    }
+}
+
+/* Найти место под массив метаданных внутри доступной RAM и зарезервировать
+ * его в оставленном для этого слоте. */
+static uint64_t place_frame_array(uint64_t bytes) {
+    uint64_t base, len;
+    uint32_t type;
+
+    for (int i = 0; multiboot2_get_mmap_entry(i, &base, &len, &type) == 0; i++) {
+        if (type != MULTIBOOT_MEMORY_AVAILABLE) continue;
+        uint64_t region_end = base + len;
+        if (region_end > PMM_BOOT_LIMIT) region_end = PMM_BOOT_LIMIT;
+
+        uint64_t start = align_up(base, PAGE_SIZE);
+        while (start + bytes <= region_end) {
+            phys_range_t *r = reserved_overlap(start, start + bytes);
+            if (!r) {
+                add_reserved(start, start + bytes);
+                return start;
+            }
+            start = r->end;
+        }
+    }
+    return 0;
+}
+
+/* Отдать аллокатору доступные фреймы из [lo, hi), пропуская резерв. */
+static void add_usable(uint64_t lo, uint64_t hi) {
+    uint64_t pfn = PFN(align_up(lo, PAGE_SIZE));
+    uint64_t end_pfn = PFN(hi);
+    if (end_pfn > max_pfn) end_pfn = max_pfn;
+
+    while (pfn < end_pfn) {
+        phys_range_t *r = reserved_overlap(PHYS(pfn), PHYS(end_pfn));
+        uint64_t run_end = r ? PFN(r->start) : end_pfn;
+        if (run_end < pfn) run_end = pfn;
+
+        for (uint64_t p = pfn; p < run_end; p++) {
+            frames[p].flags = 0;
+            frames[p].refcount = 0;
+        }
+        total_frames += run_end - pfn;
+        free_run(pfn, run_end - pfn);
+
+        if (!r) break;
+        pfn = PFN(r->end);
+    }
+}
+
+void pmm_init(void) {
+    uint64_t base, len;
+    uint32_t type;
+
+    /* Всё ниже конца ядра: BIOS, VGA, сам образ и загрузочные таблицы. */
+    int err = reserve_range(0, (uint64_t)(uintptr_t)&end);
+
+    uint64_t mb_start, mb_end;
+    if (multiboot2_get_info_range(&mb_start, &mb_end) == 0)
+        err |= reserve_range(mb_start, mb_end);
+
+    multiboot_fb_info_t fb;
+    if (multiboot2_get_framebuffer(&fb))
+        err |= reserve_range(fb.addr, fb.addr + (uint64_t)fb.pitch * fb.height);
+
+    uint64_t mod_start, mod_end;
+    for (int i = 0; multiboot2_get_module(i, &mod_start, &mod_end) == 0; i++)
+        err |= reserve_range(mod_start, mod_end);
+
+    /* Незарезервированный модуль аллокатор раздал бы как свободную память. */
+    if (err) {
+        vga_println("pmm: too many reserved ranges (modules?), allocator is empty");
+        return;
+    }
+
+    /* Граница RAM: конец последнего доступного региона. */
+    for (int i = 0; multiboot2_get_mmap_entry(i, &base, &len, &type) == 0; i++) {
+        if (type == MULTIBOOT_MEMORY_AVAILABLE && PFN(base + len) > max_pfn)
+            max_pfn = PFN(base + len);
+    }
+    if (max_pfn == 0) {
+        vga_println("pmm: no multiboot memory map, allocator is empty");
+        return;
+    }
+
+    uint64_t array_bytes = align_up(max_pfn * sizeof(pmm_frame_t), PAGE_SIZE);
+    uint64_t array_phys = place_frame_array(array_bytes);
+    if (array_phys == 0) {
+        vga_println("pmm: no room for frame array, allocator is empty");
+        max_pfn = 0;
+        return;
+    }
+
+    frames = (pmm_frame_t *)(uintptr_t)array_phys;
+    for (uint64_t pfn = 0; pfn < max_pfn; pfn++) {
+        frames[pfn].order = 0;
+        frames[pfn].flags = PMM_FRAME_RESERVED;
+        frames[pfn].refcount = 0;
+    }
+
+    pmm_extend(PMM_BOOT_LIMIT);
+}
+
+void pmm_extend(uint64_t limit) {
+    uint64_t base, len;
+    uint32_t type;
+
+    if (!frames || limit <= mapped_limit) return;
+
+    for (int i = 0; multiboot2_get_mmap_entry(i, &base, &len, &type) == 0; i++) {
+        if (type != MULTIBOOT_MEMORY_AVAILABLE) continue;
+        uint64_t lo = base < mapped_limit ? mapped_limit : base;
+        uint64_t hi = base + len > limit ? limit : base + len;
+        if (lo < hi) add_usable(lo, hi);
+    }
+    mapped_limit = limit;
+}
+
+uint64_t pmm_alloc_order(unsigned order) {
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    uint64_t phys = alloc_block(order);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return phys;
+}
+
+static void free_order(uint64_t phys, unsigned order) {
+    uint64_t pfn = PFN(phys);
+    if (phys == 0 || order > PMM_MAX_ORDER || pfn + (1ull << order) > max_pfn) return;
+    if (frames[pfn].flags & (PMM_FRAME_FREE | PMM_FRAME_RESERVED)) {
+        vga_print("pmm: bad free ");
+        vga_print_hex64(phys);
+        vga_putc('\n');
+        return;
+    }
+    frames[pfn].refcount = 0;
+    free_block(pfn, order);
+}
+
+void pmm_free_order(uint64_t phys, unsigned order) {
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    free_order(phys, order);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+uint64_t pmm_alloc_frame(void) {
+    return pmm_alloc_order(0);
+}
+
+void pmm_free_frame(uint64_t phys) {
+    pmm_free_order(phys, 0);
+}
+
+uint64_t pmm_alloc_pages(uint64_t count) {
+    if (count == 0) return 0;
+
+    unsigned order = 0;
+    while ((1ull << order) < count) order++;
+
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    uint64_t phys = alloc_block(order);
+    if (phys == 0) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0;
+    }
+
+    uint64_t pfn = PFN(phys);
+    uint64_t tail = (1ull << order) - count;
+    if (tail) free_run(pfn + count, tail);
+
+    for (uint64_t i = 1; i < count; i++) {
+        frames[pfn + i].flags = 0;
+        frames[pfn + i].refcount = 1;
+    }
+    frames[pfn].order = 0;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return phys;
+}
+
+void pmm_free_pages(uint64_t phys, uint64_t count) {
+    uint64_t pfn = PFN(phys);
+    if (phys == 0 || count == 0 || pfn + count > max_pfn) return;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    for (uint64_t i = 0; i < count; i++)
+        frames[pfn + i].refcount = 0;
+    free_run(pfn, count);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+int pmm_frame_get(uint64_t phys) {
+    uint64_t pfn = PFN(phys);
+    if (pfn >= max_pfn) return -1;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    int ret = -1;
+    if (frames[pfn].refcount != 0xFFFF) {
+        frames[pfn].refcount++;
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return ret;
+}
+
+void pmm_frame_put(uint64_t phys) {
+    uint64_t pfn = PFN(phys);
+    if (pfn >= max_pfn) return;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    if (!(frames[pfn].flags & (PMM_FRAME_FREE | PMM_FRAME_RESERVED))) {
+        if (frames[pfn].refcount > 1) frames[pfn].refcount--;
+        else free_order(phys, 0);
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+pmm_frame_t *pmm_frame(uint64_t phys) {
+    uint64_t pfn = PFN(phys);
+    if (pfn >= max_pfn) return 0;
+    return &frames[pfn];
+}
+
+void pmm_get_stats(pmm_stats_t *st) {
+    if (!st) return;
+    st->total_frames = total_frames;
+    st->free_frames = free_frames;
+    st->failed_allocs = failed_allocs;
+    for (int i = 0; i <= PMM_MAX_ORDER; i++)
+        st->free_blocks[i] = free_count[i];
+}
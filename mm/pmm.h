@@ -0,0 +1,64 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include "paging.h"
+
+/* Физический аллокатор фреймов (buddy). Адреса физические; пока память
+ * отображена identity, их можно использовать как указатели. */
+
+/* Наибольший блок: 2^PMM_MAX_ORDER фреймов (4 MiB). */
+#define PMM_MAX_ORDER 10
+
+/* Граница памяти, отображённой загрузчиком (identity 4 GiB в long_mode_init). */
+#define PMM_BOOT_LIMIT 0x100000000ull
+
+/* Флаги фрейма. */
+#define PMM_FRAME_FREE     0x01   /* голова свободного блока */
+#define PMM_FRAME_RESERVED 0x02   /* не RAM, ядро, multiboot info и т.п. */
+#define PMM_FRAME_SLAB     0x04   /* страница slab; order = порядок slab */
+
+/* Метаданные одного фрейма. */
+typedef struct pmm_frame {
+    uint8_t  order;     /* порядок блока (для головы блока) */
+    uint8_t  flags;
+    uint16_t refcount;
+} pmm_frame_t;
+
+typedef struct pmm_stats {
+    uint64_t total_frames;   /* фреймов под управлением аллокатора */
+    uint64_t free_frames;
+    uint64_t failed_allocs;  /* сколько раз память закончилась */
+    uint64_t free_blocks[PMM_MAX_ORDER + 1];
+} pmm_stats_t;
+
+/* Построить аллокатор по карте памяти multiboot2 (только память ниже
+ * PMM_BOOT_LIMIT — остальная ещё не отображена). */
+void pmm_init(void);
+
+/* Отдать аллокатору доступную RAM ниже limit (после расширения отображения). */
+void pmm_extend(uint64_t limit);
+
+/* Один фрейм. Возвращает физический адрес или 0, если память исчерпана. */
+uint64_t pmm_alloc_frame(void);
+void pmm_free_frame(uint64_t phys);
+
+/* Непрерывный блок из 2^order фреймов, выровненный по своему размеру. */
+uint64_t pmm_alloc_order(unsigned order);
+void pmm_free_order(uint64_t phys, unsigned order);
+
+/* Непрерывный участок из count фреймов (хвост блока сразу возвращается). */
+uint64_t pmm_alloc_pages(uint64_t count);
+void pmm_free_pages(uint64_t phys, uint64_t count);
+
+/* Счётчик ссылок фрейма (общие страницы после fork). put освобождает фрейм,
+ * когда ссылок не осталось. get возвращает -1 при переполнении счётчика. */
+int pmm_frame_get(uint64_t phys);
+void pmm_frame_put(uint64_t phys);
+
+/* Метаданные фрейма по физическому адресу (0, если адрес вне RAM). */
+pmm_frame_t *pmm_frame(uint64_t phys);
+
+void pmm_get_stats(pmm_stats_t *st);
+
+#endif /* PMM_H */
@@ -0,0 +1,253 @@
+#include "slab.h"
+#include "pmm.h"
+#include "paging.h"
+#include "vga.h"
+
+#define SLAB_DEFAULT_ALIGN 8
+#define SLAB_MAX_ORDER     3    /* slab не больше 32 KiB */
+#define SLAB_MIN_OBJS      8    /* увеличиваем slab, пока объектов меньше */
+
+/* Заголовок slab: лежит в начале его первой страницы. */
+typedef struct slab {
+    kmem_cache_t *cache;
+    struct slab *next;
+    struct slab *prev;
+    void *freelist;             /* первый свободный объект */
+    uint32_t inuse;
+} slab_t;
+
+#define KMALLOC_CLASSES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+static kmem_cache_t cache_cache;                 /* дескрипторы kmem_cache_t */
+static kmem_cache_t kmalloc_caches[KMALLOC_CLASSES];
+static const char *kmalloc_names[KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+static kmem_cache_t *cache_list = 0;
+static spinlock_t cache_list_lock = SPINLOCK_INIT;
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) & ~(a - 1);
+}
+
+static void slab_list_push(slab_t **head, slab_t *s) {
+    s->prev = 0;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+static void slab_list_remove(slab_t **head, slab_t *s) {
+    if (s->prev) s->prev->next = s->next;
+    else *head = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->next = s->prev = 0;
+}
+
+static int cache_setup(kmem_cache_t *c, const char *name, size_t size, size_t align) {
+    if (align == 0) align = SLAB_DEFAULT_ALIGN;
+    if (align & (align - 1)) return -1;
+    if (size < sizeof(void *)) size = sizeof(void *);
+
+    c->lock.locked = 0;
+    c->name = name;
+    c->align = align;
+    c->obj_size = align_up(size, align);
+    c->first_offset = (uint32_t)align_up(sizeof(slab_t), align);
+    c->partial = c->full = c->empty = 0;
+    c->nr_slabs = c->active_objs = c->nr_allocs = 0;
+
+    uint32_t order = 0;
+    size_t objs;
+    for (;;) {
+        size_t bytes = (size_t)PAGE_SIZE << order;
+        objs = bytes > c->first_offset ? (bytes - c->first_offset) / c->obj_size : 0;
+        if (objs >= SLAB_MIN_OBJS || order == SLAB_MAX_ORDER) break;
+        order++;
+    }
+    if (objs == 0) return -1;
+
+    c->slab_order = order;
+    c->objs_per_slab = (uint32_t)objs;
+    uint64_t flags = spin_lock_irqsave(&cache_list_lock);
+    c->next = cache_list;
+    cache_list = c;
+    spin_unlock_irqrestore(&cache_list_lock, flags);
+    return 0;
+}
+
+static slab_t *cache_grow(kmem_cache_t *c) {
+    uint64_t phys = pmm_alloc_order(c->slab_order);
+    if (phys == 0) return 0;
+
+    for (uint64_t i = 0; i < (1ull << c->slab_order); i++) {
+        pmm_frame_t *f = pmm_frame(phys + i * PAGE_SIZE);
+        f->flags |= PMM_FRAME_SLAB;
+        f->order = (uint8_t)c->slab_order;
+    }
+
+    slab_t *s = (slab_t *)(uintptr_t)phys;
+    s->cache = c;
+    s->inuse = 0;
+
+    /* Связываем все объекты во freelist по порядку адресов. */
+    uint8_t *obj = (uint8_t *)s + c->first_offset;
+    s->freelist = obj;
+    for (uint32_t i = 0; i + 1 < c->objs_per_slab; i++) {
+        *(void **)obj = obj + c->obj_size;
+        obj += c->obj_size;
+    }
+    *(void **)obj = 0;
+
+    slab_list_push(&c->empty, s);
+    c->nr_slabs++;
+    return s;
+}
+
+static void slab_release(kmem_cache_t *c, slab_t *s) {
+    uint64_t phys = (uint64_t)(uintptr_t)s;
+    for (uint64_t i = 0; i < (1ull << c->slab_order); i++)
+        pmm_frame(phys + i * PAGE_SIZE)->flags &= (uint8_t)~PMM_FRAME_SLAB;
+    c->nr_slabs--;
+    pmm_free_order(phys, c->slab_order);
+}
+
+/* slab, которому принадлежит объект, или 0 для памяти не из slab. */
+static slab_t *slab_of(void *ptr) {
+    pmm_frame_t *f = pmm_frame((uint64_t)(uintptr_t)ptr);
+    if (!f || !(f->flags & PMM_FRAME_SLAB)) return 0;
+    uint64_t bytes = (uint64_t)PAGE_SIZE << f->order;
+    return (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(bytes - 1));
+}
+
+void slab_init(void) {
+    cache_setup(&cache_cache, "kmem_cache", sizeof(kmem_cache_t), 0);
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        size_t size = (size_t)1 << (KMALLOC_MIN_SHIFT + i);
+        /* Крупные классы выравниваем по строке кэша. */
+        cache_setup(&kmalloc_caches[i], kmalloc_names[i], size, size >= 64 ? 64 : size);
+    }
+}
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align) {
+    kmem_cache_t *c = (kmem_cache_t *)kmem_cache_alloc(&cache_cache);
+    if (!c) return 0;
+    if (cache_setup(c, name, size, align) != 0) {
+        kmem_cache_free(&cache_cache, c);
+        return 0;
+    }
+    return c;
+}
+
+static void cache_shrink(kmem_cache_t *cache) {
+    while (cache->empty) {
+        slab_t *s = cache->empty;
+        slab_list_remove(&cache->empty, s);
+        slab_release(cache, s);
+    }
+}
+
+void kmem_cache_shrink(kmem_cache_t *cache) {
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    cache_shrink(cache);
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+void kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!cache) return;
+    uint64_t flags = spin_lock_irqsave(&cache_list_lock);
+    kmem_cache_t **p = &cache_list;
+    while (*p && *p != cache) p = &(*p)->next;
+    if (*p) *p = cache->next;
+    spin_unlock_irqrestore(&cache_list_lock, flags);
+
+    if (cache->partial || cache->full) {
+        vga_print("slab: destroying cache with live objects: ");
+        vga_println(cache->name);
+    }
+    while (cache->partial) {
+        slab_t *s = cache->partial;
+        slab_list_remove(&cache->partial, s);
+        slab_release(cache, s);
+    }
+    while (cache->full) {
+        slab_t *s = cache->full;
+        slab_list_remove(&cache->full, s);
+        slab_release(cache, s);
+    }
+    cache_shrink(cache);
+    kmem_cache_free(&cache_cache, cache);
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    slab_t *s = cache->partial;
+    if (!s) {
+        s = cache->empty;
+        if (!s) s = cache_grow(cache);
+        if (!s) {
+            spin_unlock_irqrestore(&cache->lock, flags);
+            return 0;
+        }
+        slab_list_remove(&cache->empty, s);
+        slab_list_push(&cache->partial, s);
+    }
+
+    void *obj = s->freelist;
+    s->freelist = *(void **)obj;
+    if (++s->inuse == cache->objs_per_slab) {
+        slab_list_remove(&cache->partial, s);
+        slab_list_push(&cache->full, s);
+    }
+    cache->active_objs++;
+    cache->nr_allocs++;
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!obj) return;
+    slab_t *s = slab_of(obj);
+    if (!s || s->cache != cache) {
+        vga_print("slab: bad free ");
+        vga_print_hex64((uint64_t)(uintptr_t)obj);
+        vga_putc('\n');
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    *(void **)obj = s->freelist;
+    s->freelist = obj;
+    if (s->inuse-- == cache->objs_per_slab) {
+        slab_list_remove(&cache->full, s);
+        slab_list_push(&cache->partial, s);
+    }
+    cache->active_objs--;
+
+    if (s->inuse == 0) {
+        slab_list_remove(&cache->partial, s);
+        /* Один пустой slab держим про запас, остальные отдаём. */
+        if (cache->empty) slab_release(cache, s);
+        else slab_list_push(&cache->empty, s);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+void *kmalloc_slab(size_t size) {
+    if (size > KMALLOC_MAX_SLAB) return 0;
+    unsigned shift = KMALLOC_MIN_SHIFT;
+    while (((size_t)1 << shift) < size) shift++;
+    return kmem_cache_alloc(&kmalloc_caches[shift - KMALLOC_MIN_SHIFT]);
+}
+
+int kfree_slab(void *ptr) {
+    slab_t *s = slab_of(ptr);
+    if (!s) return 0;
+    kmem_cache_free(s->cache, ptr);
+    return 1;
+}
+
+const kmem_cache_t *kmem_cache_first(void) {
+    return cache_list;
+}
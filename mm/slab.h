@@ -0,0 +1,55 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "spinlock.h"
+
+/* Кэши объектов фиксированного размера (slab). Объекты лежат в страницах
+ * подряд, без заголовков; свободные объекты связаны указателем в своём теле. */
+
+struct slab;
+
+typedef struct kmem_cache {
+    spinlock_t lock;          /* списки slab и счётчики */
+    const char *name;
+    size_t   obj_size;        /* размер объекта с учётом выравнивания */
+    size_t   align;
+    uint32_t objs_per_slab;
+    uint32_t slab_order;      /* slab = 2^slab_order страниц */
+    uint32_t first_offset;    /* смещение первого объекта от начала slab */
+    struct slab *partial;     /* есть и занятые, и свободные объекты */
+    struct slab *full;
+    struct slab *empty;
+    uint64_t nr_slabs;
+    uint64_t active_objs;
+    uint64_t nr_allocs;
+    struct kmem_cache *next;  /* список всех кэшей */
+} kmem_cache_t;
+
+/* Вызвать после pmm_init(), до первого kmalloc. */
+void slab_init(void);
+
+/* align = 0 — выравнивание по умолчанию (8 байт). */
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align);
+void kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+/* Вернуть аллокатору фреймов полностью свободные slab'ы. */
+void kmem_cache_shrink(kmem_cache_t *cache);
+
+/* Size classes для kmalloc: 16..2048 байт, степени двойки. */
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_MAX_SHIFT 11
+#define KMALLOC_MAX_SLAB  (1u << KMALLOC_MAX_SHIFT)
+
+void *kmalloc_slab(size_t size);
+
+/* Если ptr выделен из slab — освобождает и возвращает 1, иначе 0. */
+int kfree_slab(void *ptr);
+
+/* Обход кэшей (для slabinfo). */
+const kmem_cache_t *kmem_cache_first(void);
+
+#endif /* SLAB_H */
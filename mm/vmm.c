@@ -0,0 +1,722 @@
+#include "vmm.h"
+#include "pmm.h"
+#include "paging.h"
+#include "slab.h"
+#include "multiboot2.h"
+#include "cpu.h"
+#include "process.h"
+#include "vga.h"
+#include "string.h"
+#include "smp.h"
+
+/* Границы секций образа ядра (linker.ld). */
+extern uint8_t text_start, text_end, rodata_start, rodata_end;
+
+#define PML4_INDEX(v)  (((v) >> 39) & 511)
+#define PDPT_INDEX(v)  (((v) >> 30) & 511)
+#define PD_INDEX(v)    (((v) >> 21) & 511)
+#define PT_INDEX(v)    (((v) >> 12) & 511)
+
+#define ADDR_1G_MASK   0x000FFFFFC0000000ull
+#define ADDR_2M_MASK   0x000FFFFFFFE00000ull
+
+/* Атрибуты, которые сохраняются при дроблении крупной страницы. */
+#define PTE_KEEP_MASK  (PTE_PRESENT | PTE_RW | PTE_USER | PTE_PWT | PTE_PCD | \
+                        PTE_ACCESSED | PTE_DIRTY | PTE_GLOBAL | PTE_NX)
+
+/* Если диапазон больше, TLB сбрасывается целиком, а не по страницам. */
+#define FLUSH_ALL_PAGES 64
+
+#define USER_PML4_FIRST PML4_INDEX(USER_SPACE_BASE)
+#define USER_PML4_END   (USER_PML4_FIRST + (USER_SPACE_END - USER_SPACE_BASE) / (1ull << 39))
+
+/* PAT: записи 0..3 = WB, WC, UC-, UC; 4..7 повторяют их, поэтому бит PAT в
+ * записях таблиц не используется. PWT без PCD выбирает WC, PCD|PWT — UC. */
+#define PAT_VALUE       0x0007010600070106ull
+
+#define PCID_COUNT      4096
+#define CR3_NOFLUSH     (1ull << 63)
+
+static vm_space_t kernel_space;
+/* Пространство в CR3 каждого CPU. */
+static vm_space_t *current_space[SMP_MAX_CPUS] = { [0 ... SMP_MAX_CPUS - 1] = &kernel_space };
+static kmem_cache_t *space_cache = 0;
+static kmem_cache_t *region_cache = 0;
+static uint64_t kernel_vm_next = KERNEL_VM_BASE;
+
+static int use_1g = 0;
+static int nx_enabled = 0;
+static int pat_enabled = 0;
+static int pcid_supported = 0;
+static int pcid_active = 0;
+static uint64_t pcid_used[PCID_COUNT / 64];   /* PCID 0 — ядро */
+/* Номер включения PCID. CPU, который ещё не видел текущий, сбрасывает TLB
+ * всех PCID, прежде чем переключиться без сброса: пока PCID был выключен,
+ * пространства менялись без учёта своих тегов. */
+static volatile uint32_t pcid_generation = 0;
+static uint32_t pcid_generation_seen[SMP_MAX_CPUS];
+
+static uint64_t align_up(uint64_t v, uint64_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+static uint64_t *entry_table(uint64_t e) {
+    return (uint64_t *)(uintptr_t)(e & PTE_ADDR_MASK);
+}
+
+static void zero_page(uint64_t phys) {
+    memset((void *)(uintptr_t)phys, 0, PAGE_SIZE);
+}
+
+static uint64_t *alloc_table(void) {
+    uint64_t phys = pmm_alloc_frame();
+    if (!phys) return 0;
+    zero_page(phys);
+    return (uint64_t *)(uintptr_t)phys;
+}
+
+/* level: 1 = PDPT, 2 = PD, 3 = PT. Освобождает таблицу и все дочерние;
+ * с leaves — и ссылки на фреймы 4K-страниц (крупные страницы чужие). */
+static void free_table(uint64_t *t, int level, int leaves) {
+    for (int i = 0; i < 512; i++) {
+        if (!(t[i] & PTE_PRESENT)) continue;
+        if (level < 3 && !(t[i] & PTE_PS))
+            free_table(entry_table(t[i]), level + 1, leaves);
+        else if (level == 3 && leaves)
+            pmm_frame_put(t[i] & PTE_ADDR_MASK);
+    }
+    pmm_free_frame((uint64_t)(uintptr_t)t);
+}
+
+static uint64_t leaf_bits(uint32_t flags, int large) {
+    uint64_t e = PTE_PRESENT;
+    if (flags & VMM_WRITE)    e |= PTE_RW;
+    if (flags & VMM_USER)     e |= PTE_USER;
+    if (flags & VMM_GLOBAL)   e |= PTE_GLOBAL;
+    if (flags & VMM_UNCACHED) e |= PTE_PCD | PTE_PWT;
+    if (flags & VMM_WRITECOMB) e |= pat_enabled ? PTE_PWT : PTE_PCD | PTE_PWT;
+    if ((flags & VMM_NOEXEC) && nx_enabled) e |= PTE_NX;
+    if (large) e |= PTE_PS;
+    return e;
+}
+
+/* Таблица следующего уровня за записью entry (при create — создаётся). */
+static uint64_t *next_level(uint64_t *entry, int create, uint32_t flags) {
+    if (*entry & PTE_PRESENT) {
+        if (*entry & PTE_PS) return 0;
+        if (flags & VMM_USER) *entry |= PTE_USER;
+        return entry_table(*entry);
+    }
+    if (!create) return 0;
+
+    uint64_t *t = alloc_table();
+    if (!t) return 0;
+    *entry = (uint64_t)(uintptr_t)t | PTE_PRESENT | PTE_RW | ((flags & VMM_USER) ? PTE_USER : 0);
+    return t;
+}
+
+/* Раздробить 1 GiB (level 1) или 2 MiB (level 2) страницу на таблицу
+ * страниц следующего размера с теми же атрибутами. */
+static int split_large(uint64_t *entry, int level) {
+    uint64_t e = *entry;
+    uint64_t *t = alloc_table();
+    if (!t) return -1;
+
+    uint64_t attrs = e & PTE_KEEP_MASK;
+    if (level == 1) {
+        uint64_t base = e & ADDR_1G_MASK;
+        for (uint64_t i = 0; i < 512; i++)
+            t[i] = (base + i * PAGE_SIZE_2M) | attrs | PTE_PS | (e & PTE_PAT_LARGE);
+    } else {
+        uint64_t base = e & ADDR_2M_MASK;
+        uint64_t pat = (e & PTE_PAT_LARGE) ? PTE_PAT_4K : 0;
+        for (uint64_t i = 0; i < 512; i++)
+            t[i] = (base + i * PAGE_SIZE) | attrs | pat;
+    }
+
+    *entry = (uint64_t)(uintptr_t)t | PTE_PRESENT | PTE_RW | (e & PTE_USER);
+    return 0;
+}
+
+/* Сбросить TLB всех PCID, включая глобальные записи: переключение CR4.PGE
+ * сбрасывает и их. */
+static void flush_all_pcids(void) {
+    uint64_t cr4 = read_cr4();
+    if (cr4 & CR4_PGE) {
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3(read_cr3());
+    }
+}
+
+void vmm_flush(vm_space_t *space, uint64_t virt, uint64_t size) {
+    /* Неактивное пространство: его записи в TLB (под своим PCID) сбросятся при
+     * следующем переключении на него. Ядро отображено глобальными страницами,
+     * их invlpg сбрасывает для всех PCID. Сброс только локальный: пространства
+     * пользователя живут на одном CPU, а kernel_space после запуска AP только
+     * растёт — новые отображения сброса не требуют. Менять права или тип
+     * памяти уже видимых страниц ядра при работающих AP нельзя: рассылки
+     * сброса на другие CPU нет. */
+    if (space != current_space[cpu_id()] && space != &kernel_space) {
+        space->tlb_stale = 1;
+        return;
+    }
+    if (size / PAGE_SIZE > FLUSH_ALL_PAGES) {
+        flush_all_pcids();
+        return;
+    }
+    for (uint64_t a = virt; a < virt + size; a += PAGE_SIZE)
+        invlpg(a);
+}
+
+int vmm_map(vm_space_t *space, uint64_t virt, uint64_t phys, uint64_t size, uint32_t flags) {
+    uint64_t *pml4 = space->pml4;
+    uint64_t start = virt;
+    uint64_t end_virt = virt + size;
+
+    while (virt < end_virt) {
+        uint64_t rem = end_virt - virt;
+        uint64_t step;
+
+        uint64_t *pdpt = next_level(&pml4[PML4_INDEX(virt)], 1, flags);
+        if (!pdpt) return -1;
+        uint64_t *pdpte = &pdpt[PDPT_INDEX(virt)];
+
+        if (use_1g && ((virt | phys) & (PAGE_SIZE_1G - 1)) == 0 && rem >= PAGE_SIZE_1G) {
+            if ((*pdpte & PTE_PRESENT) && !(*pdpte & PTE_PS))
+                free_table(entry_table(*pdpte), 2, 0);
+            *pdpte = phys | leaf_bits(flags, 1);
+            step = PAGE_SIZE_1G;
+        } else {
+            if ((*pdpte & PTE_PRESENT) && (*pdpte & PTE_PS) && split_large(pdpte, 1) != 0)
+                return -1;
+            uint64_t *pd = next_level(pdpte, 1, flags);
+            if (!pd) return -1;
+            uint64_t *pde = &pd[PD_INDEX(virt)];
+
+            if (((virt | phys) & (PAGE_SIZE_2M - 1)) == 0 && rem >= PAGE_SIZE_2M) {
+                if ((*pde & PTE_PRESENT) && !(*pde & PTE_PS))
+                    free_table(entry_table(*pde), 3, 0);
+                *pde = phys | leaf_bits(flags, 1);
+                step = PAGE_SIZE_2M;
+            } else {
+                if ((*pde & PTE_PRESENT) && (*pde & PTE_PS) && split_large(pde, 2) != 0)
+                    return -1;
+                uint64_t *pt = next_level(pde, 1, flags);
+                if (!pt) return -1;
+                pt[PT_INDEX(virt)] = phys | leaf_bits(flags, 0);
+                step = PAGE_SIZE;
+            }
+        }
+
+        virt += step;
+        phys += step;
+    }
+
+    vmm_flush(space, start, size);
+    return 0;
+}
+
+#define OP_UNMAP   0
+#define OP_PROTECT 1
+#define OP_RELEASE 2   /* снять и освободить фреймы 4K-страниц */
+
+static void apply(vm_space_t *space, uint64_t virt, uint64_t *entry, int op,
+                  uint32_t flags, int large) {
+    if (op == OP_RELEASE && !large) {
+        pmm_frame_put(*entry & PTE_ADDR_MASK);
+        space->resident--;
+    }
+    if (op != OP_PROTECT) {
+        *entry = 0;
+        return;
+    }
+    uint64_t addr = *entry & PTE_ADDR_MASK;
+    uint64_t pat = 0;
+    if (large) {
+        pat = *entry & PTE_PAT_LARGE;
+        addr &= ~PTE_PAT_LARGE;
+    } else {
+        pat = *entry & PTE_PAT_4K;
+    }
+    uint64_t e = addr | pat | leaf_bits(flags, large);
+
+    /* Фрейм, общий с другим пространством после fork, остаётся copy-on-write. */
+    if (!large && (e & PTE_RW) && virt >= USER_SPACE_BASE && virt < USER_SPACE_END) {
+        pmm_frame_t *f = pmm_frame(addr);
+        if (f && f->refcount > 1) e = (e & ~PTE_RW) | PTE_COW;
+    }
+    *entry = e;
+}
+
+/* Общий обход для unmap/protect/release: крупные страницы, целиком попадающие в
+ * диапазон, меняются на месте; частично попадающие — дробятся. */
+static int walk_range(vm_space_t *space, uint64_t virt, uint64_t size, int op, uint32_t flags) {
+    uint64_t *pml4 = space->pml4;
+    uint64_t start = virt;
+    uint64_t end_virt = virt + size;
+
+    while (virt < end_virt) {
+        uint64_t rem = end_virt - virt;
+
+        uint64_t *pml4e = &pml4[PML4_INDEX(virt)];
+        if (!(*pml4e & PTE_PRESENT)) {
+            virt = (virt + (1ull << 39)) & ~((1ull << 39) - 1);
+            continue;
+        }
+        uint64_t *pdpte = &entry_table(*pml4e)[PDPT_INDEX(virt)];
+        if (!(*pdpte & PTE_PRESENT)) {
+            virt = (virt + PAGE_SIZE_1G) & ~(PAGE_SIZE_1G - 1);
+            continue;
+        }
+        if (*pdpte & PTE_PS) {
+            if ((virt & (PAGE_SIZE_1G - 1)) == 0 && rem >= PAGE_SIZE_1G) {
+                apply(space, virt, pdpte, op, flags, 1);
+                virt += PAGE_SIZE_1G;
+                continue;
+            }
+            if (split_large(pdpte, 1) != 0) return -1;
+        }
+
+        uint64_t *pde = &entry_table(*pdpte)[PD_INDEX(virt)];
+        if (!(*pde & PTE_PRESENT)) {
+            virt = (virt + PAGE_SIZE_2M) & ~(PAGE_SIZE_2M - 1);
+            continue;
+        }
+        if (*pde & PTE_PS) {
+            if ((virt & (PAGE_SIZE_2M - 1)) == 0 && rem >= PAGE_SIZE_2M) {
+                apply(space, virt, pde, op, flags, 1);
+                virt += PAGE_SIZE_2M;
+                continue;
+            }
+            if (split_large(pde, 2) != 0) return -1;
+        }
+
+        uint64_t *pte = &entry_table(*pde)[PT_INDEX(virt)];
+        if (*pte & PTE_PRESENT) apply(space, virt, pte, op, flags, 0);
+        virt += PAGE_SIZE;
+    }
+
+    vmm_flush(space, start, size);
+    return 0;
+}
+
+int vmm_unmap(vm_space_t *space, uint64_t virt, uint64_t size) {
+    return walk_range(space, virt, size, OP_UNMAP, 0);
+}
+
+int vmm_protect(vm_space_t *space, uint64_t virt, uint64_t size, uint32_t flags) {
+    return walk_range(space, virt, size, OP_PROTECT, flags);
+}
+
+int vmm_translate(vm_space_t *space, uint64_t virt, uint64_t *phys) {
+    uint64_t e = space->pml4[PML4_INDEX(virt)];
+    if (!(e & PTE_PRESENT)) return -1;
+
+    e = entry_table(e)[PDPT_INDEX(virt)];
+    if (!(e & PTE_PRESENT)) return -1;
+    if (e & PTE_PS) {
+        if (phys) *phys = (e & ADDR_1G_MASK) | (virt & (PAGE_SIZE_1G - 1));
+        return 0;
+    }
+
+    e = entry_table(e)[PD_INDEX(virt)];
+    if (!(e & PTE_PRESENT)) return -1;
+    if (e & PTE_PS) {
+        if (phys) *phys = (e & ADDR_2M_MASK) | (virt & (PAGE_SIZE_2M - 1));
+        return 0;
+    }
+
+    e = entry_table(e)[PT_INDEX(virt)];
+    if (!(e & PTE_PRESENT)) return -1;
+    if (phys) *phys = (e & PTE_ADDR_MASK) | (virt & (PAGE_SIZE - 1));
+    return 0;
+}
+
+vm_space_t *vmm_kernel_space(void) {
+    return &kernel_space;
+}
+
+vm_space_t *vmm_space_current(void) {
+    return current_space[cpu_id()];
+}
+
+static uint16_t pcid_alloc(void) {
+    if (!pcid_supported) return 0;
+    for (int w = 0; w < PCID_COUNT / 64; w++) {
+        if (pcid_used[w] == ~0ull) continue;
+        int bit = __builtin_ctzll(~pcid_used[w]);
+        pcid_used[w] |= 1ull << bit;
+        return (uint16_t)(w * 64 + bit);
+    }
+    return 0;   /* PCID кончились: пространство работает без тега */
+}
+
+static void pcid_free(uint16_t pcid) {
+    if (pcid) pcid_used[pcid / 64] &= ~(1ull << (pcid % 64));
+}
+
+vm_space_t *vmm_space_create(void) {
+    if (!space_cache) {
+        space_cache = kmem_cache_create("vm_space", sizeof(vm_space_t), 0);
+        if (!space_cache) return 0;
+    }
+    vm_space_t *space = (vm_space_t *)kmem_cache_alloc(space_cache);
+    if (!space) return 0;
+
+    space->pml4 = alloc_table();
+    if (!space->pml4) {
+        kmem_cache_free(space_cache, space);
+        return 0;
+    }
+
+    /* Общая часть ядра разделяется на уровне записей PML4. */
+    for (uint64_t i = 0; i < 512; i++) {
+        if (i < USER_PML4_FIRST || i >= USER_PML4_END)
+            space->pml4[i] = kernel_space.pml4[i];
+    }
+
+    /* PCID мог принадлежать уничтоженному пространству — в TLB могут
+     * остаться его записи, поэтому первое переключение со сбросом. */
+    space->pcid = pcid_alloc();
+    space->tlb_stale = 1;
+    space->regions = 0;
+    space->resident = 0;
+    return space;
+}
+
+void vmm_space_destroy(vm_space_t *space) {
+    if (!space || space == &kernel_space) return;
+    if (space == current_space[cpu_id()]) vmm_space_switch(&kernel_space);
+
+    while (space->regions) {
+        vm_region_t *r = space->regions;
+        space->regions = r->next;
+        kmem_cache_free(region_cache, r);
+    }
+    for (uint64_t i = USER_PML4_FIRST; i < USER_PML4_END; i++) {
+        if (space->pml4[i] & PTE_PRESENT)
+            free_table(entry_table(space->pml4[i]), 1, 1);
+    }
+    pmm_free_frame((uint64_t)(uintptr_t)space->pml4);
+    pcid_free(space->pcid);
+    kmem_cache_free(space_cache, space);
+}
+
+/* Копия таблицы уровня level для fork. Записываемые 4K-страницы в обеих
+ * копиях становятся PTE_COW без PTE_RW; крупные страницы просто делятся. */
+static uint64_t *fork_table(uint64_t *src, int level) {
+    uint64_t *dst = alloc_table();
+    if (!dst) return 0;
+
+    for (int i = 0; i < 512; i++) {
+        uint64_t e = src[i];
+        if (!(e & PTE_PRESENT)) continue;
+
+        if (level < 3 && !(e & PTE_PS)) {
+            uint64_t *child = fork_table(entry_table(e), level + 1);
+            if (!child) {
+                free_table(dst, level, 1);
+                return 0;
+            }
+            dst[i] = (uint64_t)(uintptr_t)child | (e & ~PTE_ADDR_MASK);
+            continue;
+        }
+        if (level == 3) {
+            if (pmm_frame_get(e & PTE_ADDR_MASK) != 0) {
+                free_table(dst, level, 1);
+                return 0;
+            }
+            if (e & PTE_RW) {
+                e = (e & ~PTE_RW) | PTE_COW;
+                src[i] = e;
+            }
+        }
+        dst[i] = e;
+    }
+    return dst;
+}
+
+vm_space_t *vmm_space_fork(vm_space_t *parent) {
+    vm_space_t *child = vmm_space_create();
+    if (!child) return 0;
+
+    vm_region_t **link = &child->regions;
+    for (vm_region_t *r = parent->regions; r; r = r->next) {
+        vm_region_t *copy = (vm_region_t *)kmem_cache_alloc(region_cache);
+        if (!copy) {
+            vmm_space_destroy(child);
+            return 0;
+        }
+        *copy = *r;
+        copy->next = 0;
+        *link = copy;
+        link = &copy->next;
+    }
+
+    for (uint64_t i = USER_PML4_FIRST; i < USER_PML4_END; i++) {
+        uint64_t e = parent->pml4[i];
+        if (!(e & PTE_PRESENT)) continue;
+        uint64_t *pdpt = fork_table(entry_table(e), 1);
+        if (!pdpt) {
+            vmm_space_destroy(child);
+            vmm_flush(parent, USER_SPACE_BASE, USER_SPACE_END - USER_SPACE_BASE);
+            return 0;
+        }
+        child->pml4[i] = (uint64_t)(uintptr_t)pdpt | (e & ~PTE_ADDR_MASK);
+    }
+    child->resident = parent->resident;
+
+    /* У родителя записываемые страницы стали только для чтения. */
+    vmm_flush(parent, USER_SPACE_BASE, USER_SPACE_END - USER_SPACE_BASE);
+    return child;
+}
+
+void vmm_space_switch(vm_space_t *space) {
+    uint32_t cpu = cpu_id();
+    uint64_t cr3 = (uint64_t)(uintptr_t)space->pml4;
+    current_space[cpu] = space;
+    if (!pcid_active) {
+        /* Тег 0: запись CR3 сбрасывает только его, записи под PCID
+         * пространства остаются — отложенный сброс сохраняем. */
+        write_cr3(cr3);
+        return;
+    }
+    uint32_t gen = pcid_generation;
+    if (pcid_generation_seen[cpu] != gen) {
+        flush_all_pcids();
+        pcid_generation_seen[cpu] = gen;
+    }
+    cr3 |= space->pcid;
+    if (!space->tlb_stale) cr3 |= CR3_NOFLUSH;
+    /* Запись без NOFLUSH сбросила именно этот PCID. */
+    space->tlb_stale = 0;
+    write_cr3(cr3);
+}
+
+int vmm_pcid_enabled(void) {
+    return pcid_active;
+}
+
+void vmm_use_pcid(int on) {
+    /* Без PCID все пространства делят тег 0, и любой CR3 сбрасывает TLB. */
+    int active = on && pcid_supported;
+    if (active && !pcid_active) __atomic_fetch_add(&pcid_generation, 1, __ATOMIC_SEQ_CST);
+    pcid_active = active;
+    vmm_space_switch(current_space[cpu_id()]);
+}
+
+void vmm_init(void) {
+    use_1g = cpu_has(CPU_FEAT_PDPE1GB);
+    if (cpu_has(CPU_FEAT_NX)) {
+        wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+        nx_enabled = 1;
+    }
+
+    /* Загрузочные таблицы не используют PWT/PCD, поэтому смена записей PAT
+     * не меняет тип уже отображённой памяти; кэш сбрасываем для надёжности. */
+    if (cpu_has(CPU_FEAT_PAT)) {
+        wbinvd();
+        wrmsr(MSR_PAT, PAT_VALUE);
+        pat_enabled = 1;
+    }
+
+    uint64_t *kernel_pml4 = alloc_table();
+    if (!kernel_pml4) {
+        vga_println("vmm: no memory for page tables, staying on boot map");
+        return;
+    }
+
+    /* Прямое отображение: вся карта памяти и framebuffer, но не меньше 4 GiB
+     * (там MMIO: LAPIC, IOAPIC, framebuffer). */
+    uint64_t top = PMM_BOOT_LIMIT;
+    uint64_t base, len;
+    uint32_t type;
+    for (int i = 0; multiboot2_get_mmap_entry(i, &base, &len, &type) == 0; i++) {
+        if (base + len > top) top = base + len;
+    }
+    multiboot_fb_info_t fb;
+    if (multiboot2_get_framebuffer(&fb) && fb.addr + (uint64_t)fb.pitch * fb.height > top)
+        top = fb.addr + (uint64_t)fb.pitch * fb.height;
+    top = align_up(top, PAGE_SIZE_1G);
+
+    kernel_space.pml4 = kernel_pml4;
+    kernel_space.pcid = 0;
+    if (vmm_map(&kernel_space, 0, 0, top, VMM_WRITE | VMM_GLOBAL | VMM_NOEXEC) != 0) {
+        vga_println("vmm: failed to build direct map, staying on boot map");
+        return;
+    }
+
+    /* PDPT для KERNEL_VM создаётся заранее: записи PML4 копируются в новые
+     * пространства, и ленивые отображения ядра должны быть видны во всех. */
+    if (!next_level(&kernel_pml4[PML4_INDEX(KERNEL_VM_BASE)], 1, 0)) {
+        vga_println("vmm: no memory for page tables, staying on boot map");
+        return;
+    }
+
+    /* Образ ядра: код — только чтение и исполнение, константы — только чтение.
+     * Это дробит первые 2 MiB на 4K страницы; остальное остаётся крупным. */
+    uint64_t text = (uint64_t)(uintptr_t)&text_start;
+    uint64_t rodata = (uint64_t)(uintptr_t)&rodata_start;
+    vmm_protect(&kernel_space, text, align_up((uint64_t)(uintptr_t)&text_end, PAGE_SIZE) - text,
+                VMM_GLOBAL);
+    vmm_protect(&kernel_space, rodata, align_up((uint64_t)(uintptr_t)&rodata_end, PAGE_SIZE) - rodata,
+                VMM_GLOBAL | VMM_NOEXEC);
+
+    /* Нулевая страница не отображается, чтобы ловить разыменование NULL. */
+    vmm_unmap(&kernel_space, 0, PAGE_SIZE);
+
+    write_cr3((uint64_t)(uintptr_t)kernel_pml4);
+    write_cr0(read_cr0() | CR0_WP);
+
+    /* PCID: CR3 ядра сейчас с тегом 0, как того требует включение PCIDE. */
+    if (cpu_has(CPU_FEAT_PCID)) {
+        write_cr4(read_cr4() | CR4_PCIDE);
+        pcid_used[0] = 1;
+        pcid_supported = 1;
+        pcid_active = 1;
+    }
+
+    /* Теперь вся RAM отображена — отдаём аллокатору память выше 4 GiB. */
+    pmm_extend(top);
+}
+
+/* --- Области с ленивым выделением и обработка #PF --- */
+
+static vm_region_t *region_find(vm_space_t *space, uint64_t addr) {
+    for (vm_region_t *r = space->regions; r && r->start <= addr; r = r->next) {
+        if (addr < r->end) return r;
+    }
+    return 0;
+}
+
+int vmm_region_reserve(vm_space_t *space, uint64_t start, uint64_t size, uint32_t flags) {
+    uint64_t end_virt = start + size;
+    if (size == 0 || ((start | size) & (PAGE_SIZE - 1)) || end_virt < start) return -1;
+
+    if (!region_cache) {
+        region_cache = kmem_cache_create("vm_region", sizeof(vm_region_t), 0);
+        if (!region_cache) return -1;
+    }
+
+    vm_region_t **link = &space->regions;
+    while (*link && (*link)->end <= start) link = &(*link)->next;
+    if (*link && (*link)->start < end_virt) return -1;
+
+    vm_region_t *r = (vm_region_t *)kmem_cache_alloc(region_cache);
+    if (!r) return -1;
+    r->start = start;
+    r->end = end_virt;
+    r->flags = flags;
+    r->next = *link;
+    *link = r;
+    return 0;
+}
+
+int vmm_region_release(vm_space_t *space, uint64_t start) {
+    vm_region_t **link = &space->regions;
+    while (*link && (*link)->start != start) link = &(*link)->next;
+    if (!*link) return -1;
+
+    vm_region_t *r = *link;
+    *link = r->next;
+    walk_range(space, r->start, r->end - r->start, OP_RELEASE, 0);
+    kmem_cache_free(region_cache, r);
+    return 0;
+}
+
+void *vmm_kernel_reserve(uint64_t size, uint32_t flags) {
+    /* Адреса выдаются подряд и не переиспользуются: 512 GiB хватает надолго. */
+    size = align_up(size, PAGE_SIZE);
+    if (size == 0 || size > KERNEL_VM_END - kernel_vm_next) return 0;
+    if (vmm_region_reserve(&kernel_space, kernel_vm_next, size, flags | VMM_GLOBAL) != 0)
+        return 0;
+    void *p = (void *)(uintptr_t)kernel_vm_next;
+    kernel_vm_next += size;
+    return p;
+}
+
+/* Запись на общий фрейм: последний владелец просто получает право записи,
+ * иначе страница копируется в новый фрейм. */
+static int cow_fault(vm_space_t *space, uint64_t page, uint64_t *pte, struct process *proc) {
+    uint64_t old = *pte & PTE_ADDR_MASK;
+    pmm_frame_t *f = pmm_frame(old);
+
+    if (f && f->refcount == 1) {
+        *pte = (*pte & ~PTE_COW) | PTE_RW;
+        vmm_flush(space, page, PAGE_SIZE);
+        if (proc) proc->minor_faults++;
+        return 0;
+    }
+
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) {
+        vga_println("vmm: out of memory in page fault");
+        return -1;
+    }
+    memcpy((void *)(uintptr_t)frame, (const void *)(uintptr_t)old, PAGE_SIZE);
+
+    *pte = frame | (*pte & ~(PTE_ADDR_MASK | PTE_COW)) | PTE_RW;
+    vmm_flush(space, page, PAGE_SIZE);
+    pmm_frame_put(old);
+    if (proc) proc->major_faults++;
+    return 0;
+}
+
+/* Запись 4K-страницы для virt или 0 (нет таблицы или крупная страница). */
+static uint64_t *pte_lookup(vm_space_t *space, uint64_t virt) {
+    uint64_t e = space->pml4[PML4_INDEX(virt)];
+    if (!(e & PTE_PRESENT)) return 0;
+    e = entry_table(e)[PDPT_INDEX(virt)];
+    if (!(e & PTE_PRESENT) || (e & PTE_PS)) return 0;
+    e = entry_table(e)[PD_INDEX(virt)];
+    if (!(e & PTE_PRESENT) || (e & PTE_PS)) return 0;
+    return &entry_table(e)[PT_INDEX(virt)];
+}
+
+int vmm_handle_fault(uint64_t addr, uint64_t error) {
+    if (error & PF_RSVD) return -1;
+
+    vm_space_t *space = current_space[cpu_id()];
+    if (addr >= KERNEL_VM_BASE && addr < KERNEL_VM_END) space = &kernel_space;
+
+    struct process *proc = process_current();
+    uint64_t page = addr & ~(PAGE_SIZE - 1);
+    uint64_t *pte = pte_lookup(space, page);
+
+    if (pte && (*pte & PTE_COW) && (error & (PF_PRESENT | PF_WRITE)) == (PF_PRESENT | PF_WRITE)) {
+        if ((error & PF_USER) && !(*pte & PTE_USER)) return -1;
+        return cow_fault(space, page, pte, proc);
+    }
+
+    vm_region_t *r = region_find(space, addr);
+    if (!r) return -1;
+    if ((error & PF_WRITE) && !(r->flags & VMM_WRITE)) return -1;
+    if ((error & PF_USER) && !(r->flags & VMM_USER)) return -1;
+    if ((error & PF_INSTR) && (r->flags & VMM_NOEXEC) && nx_enabled) return -1;
+
+    /* Страница уже отображена с нужными правами — в TLB была устаревшая
+     * запись (например, отображение появилось на другом пути). */
+    if (pte && (*pte & PTE_PRESENT)) {
+        if ((error & PF_WRITE) && !(*pte & PTE_RW)) return -1;
+        invlpg(page);
+        if (proc) proc->minor_faults++;
+        return 0;
+    }
+
+    /* Первое обращение: новый обнулённый фрейм. */
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame) {
+        vga_println("vmm: out of memory in page fault");
+        return -1;
+    }
+    zero_page(frame);
+    if (vmm_map(space, page, frame, PAGE_SIZE, r->flags) != 0) {
+        pmm_free_frame(frame);
+        return -1;
+    }
+    space->resident++;
+    if (proc) proc->major_faults++;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+
+/* Менеджер виртуальной памяти: 4-уровневые таблицы (PML4/PDPT/PD/PT) во время
+ * работы. Таблицы лежат в RAM, доступной через прямое (identity) отображение,
+ * поэтому физический адрес таблицы совпадает с её виртуальным. */
+
+#define PAGE_SIZE_2M  0x200000ull
+#define PAGE_SIZE_1G  0x40000000ull
+
+/* Пользовательская часть адресного пространства: записи PML4 128..255.
+ * Остальные записи PML4 (прямое отображение и т.п.) общие для всех. */
+#define USER_SPACE_BASE 0x0000400000000000ull
+#define USER_SPACE_END  0x0000800000000000ull
+
+/* Область виртуальной памяти ядра для ленивых резервирований (одна запись
+ * PML4, общая для всех пространств). */
+#define KERNEL_VM_BASE  0xFFFF800000000000ull
+#define KERNEL_VM_END   0xFFFF808000000000ull
+
+/* Область с ленивым выделением: фреймы появляются при первом обращении. */
+typedef struct vm_region {
+    uint64_t start;
+    uint64_t end;
+    uint32_t flags;         /* VMM_* для страниц области */
+    struct vm_region *next; /* список отсортирован по start */
+} vm_region_t;
+
+/* Адресное пространство: своя PML4 и свой PCID (тег TLB). Фреймы 4K-страниц
+ * пользовательской части принадлежат пространству. */
+typedef struct vm_space {
+    uint64_t *pml4;
+    uint16_t  pcid;         /* 0 — ядро или PCID не поддерживается */
+    uint8_t   tlb_stale;    /* при следующем переключении сбросить TLB этого PCID */
+    vm_region_t *regions;
+    uint64_t  resident;     /* страниц, выделенных по обращению */
+} vm_space_t;
+
+/* Биты кода ошибки #PF. */
+#define PF_PRESENT    0x01   /* страница есть, нарушены права */
+#define PF_WRITE      0x02
+#define PF_USER       0x04
+#define PF_RSVD       0x08
+#define PF_INSTR      0x10
+
+/* Атрибуты отображения (флаги vmm_map/vmm_protect). */
+#define VMM_WRITE     0x01
+#define VMM_USER      0x02
+#define VMM_NOEXEC    0x04   /* игнорируется, если CPU без NX */
+#define VMM_GLOBAL    0x08
+#define VMM_UNCACHED  0x10
+#define VMM_WRITECOMB 0x20   /* write-combining (PAT); без PAT — uncached */
+
+/* Биты записей таблиц страниц. */
+#define PTE_PRESENT   (1ull << 0)
+#define PTE_RW        (1ull << 1)
+#define PTE_USER      (1ull << 2)
+#define PTE_PWT       (1ull << 3)
+#define PTE_PCD       (1ull << 4)
+#define PTE_ACCESSED  (1ull << 5)
+#define PTE_DIRTY     (1ull << 6)
+#define PTE_PS        (1ull << 7)    /* 2 MiB / 1 GiB страница */
+#define PTE_PAT_4K    (1ull << 7)
+#define PTE_GLOBAL    (1ull << 8)
+#define PTE_COW       (1ull << 9)    /* программный: запись копирует фрейм */
+#define PTE_PAT_LARGE (1ull << 12)
+#define PTE_NX        (1ull << 63)
+#define PTE_ADDR_MASK 0x000FFFFFFFFFF000ull
+
+/* Построить прямое отображение всей RAM и переключиться на него. */
+void vmm_init(void);
+
+/* Пространство ядра: только общая часть, без пользовательских отображений. */
+vm_space_t *vmm_kernel_space(void);
+
+/* Новое пространство: общая часть ядра + пустая пользовательская. */
+vm_space_t *vmm_space_create(void);
+
+/* Освободить области, фреймы и таблицы пользовательской части. */
+void vmm_space_destroy(vm_space_t *space);
+
+/* Копия пространства для fork: таблицы копируются, 4K-страницы становятся
+ * общими copy-on-write. Возвращает 0 при нехватке памяти. */
+vm_space_t *vmm_space_fork(vm_space_t *parent);
+
+/* Загрузить CR3. С PCID сохраняет записи TLB переключаемых пространств. */
+void vmm_space_switch(vm_space_t *space);
+vm_space_t *vmm_space_current(void);
+
+/* 1, если CR4.PCIDE включён и PCID используется при переключении. */
+int vmm_pcid_enabled(void);
+
+/* Включить/выключить использование PCID (для сравнения в bench). */
+void vmm_use_pcid(int on);
+
+/* virt, phys и size выровнены по 4 KiB. Возвращают 0 при успехе, -1 при
+ * нехватке памяти под таблицы. Крупные страницы выбираются автоматически. */
+int vmm_map(vm_space_t *space, uint64_t virt, uint64_t phys, uint64_t size, uint32_t flags);
+
+/* Снять отображение. Сами фреймы не освобождаются — ими владеет вызывающий. */
+int vmm_unmap(vm_space_t *space, uint64_t virt, uint64_t size);
+
+/* Сменить атрибуты уже отображённого диапазона. */
+int vmm_protect(vm_space_t *space, uint64_t virt, uint64_t size, uint32_t flags);
+
+/* Физический адрес для virt. Возвращает 0 при успехе, -1 если не отображено. */
+int vmm_translate(vm_space_t *space, uint64_t virt, uint64_t *phys);
+
+/* Сбросить TLB для диапазона пространства (для неактивного — отложенно). */
+void vmm_flush(vm_space_t *space, uint64_t virt, uint64_t size);
+
+/* Зарезервировать [start, start+size) без выделения памяти. -1 при пересечении. */
+int vmm_region_reserve(vm_space_t *space, uint64_t start, uint64_t size, uint32_t flags);
+
+/* Снять область, начинающуюся с start, и освободить её фреймы. */
+int vmm_region_release(vm_space_t *space, uint64_t start);
+
+/* Ленивый диапазон в KERNEL_VM. Возвращает 0, если место кончилось. */
+void *vmm_kernel_reserve(uint64_t size, uint32_t flags);
+
+/* Обработчик #PF: 0 — ошибка разрешена, -1 — настоящая ошибка доступа. */
+int vmm_handle_fault(uint64_t addr, uint64_t error);
+
+#endif /* VMM_H */
@@ -2,23 +2,26 @@
 #include "vga.h"
 #include "keyboard.h"
 #include "paging.h"
+#include "pmm.h"
+#include "slab.h"
 #include "heap.h"
 #include "fs.h"
 #include "config.h"
 #include "cpu.h"
+#include "bench.h"
+#include "process.h"
+#include "string.h"
+#include "irq.h"
+#include "clock.h"
+#include "timer.h"
+#include "sched.h"
+#include "smp.h"
+#include "syscall.h"
 #include <stdint.h>
 
 static const char *KERNEL_NAME    = "nola";
 static const char *KERNEL_VERSION = "0226b";
 
-static int str_eq(const char *a, const char *b) {
-    while (*a && *b) {
-        if (*a != *b) return 0;
-        a++; b++;
-    }
-    return *a == '\0' && *b == '\0';
-}
-
 static void cmd_help(void) {
     vga_println("help         - show commands");
     vga_println("clear / cls  - clear screen");
@@ -31,15 +34,262 @@ static void cmd_help(void) {
     vga_println("touch <file> - create empty file");
     vga_println("write <f> <t> - write text to file");
     vga_println("mem          - memory info");
+    vga_println("slabinfo     - object cache statistics");
+    vga_println("faults       - page faults per process");
+    vga_println("irqs         - interrupt counts per vector");
+    vga_println("syscalls     - system call counts and latency");
+    vga_println("uptime       - time since boot and clock source");
+    vga_println("time <cmd>   - run a command and print elapsed time");
+    vga_println("sleep <ms>   - sleep for milliseconds");
+    vga_println("ps           - tasks and CPU time");
+    vga_println("cpus         - processors, switches and steals");
+    vga_println("spin <ms> [prio] - start a task that burns CPU");
+    vga_println("bench <name> - run a benchmark (no name: list)");
     vga_println("version      - kernel version");
     vga_println("halt         - halt CPU");
     vga_println("reboot       - reboot");
 }
 
 static void cmd_mem(void) {
-    uint64_t next = paging_get_next_free();
-    vga_print("next free: ");
-    vga_print_hex64(next);
+    pmm_stats_t st;
+    pmm_get_stats(&st);
+    vga_print("frames: ");
+    vga_print_uint64(st.free_frames);
+    vga_print(" free / ");
+    vga_print_uint64(st.total_frames);
+    vga_print(" total (");
+    vga_print_uint64(st.free_frames * (PAGE_SIZE / 1024));
+    vga_println(" KiB free)");
+    vga_print("free blocks by order:");
+    for (int i = 0; i <= PMM_MAX_ORDER; i++) {
+        vga_putc(' ');
+        vga_print_uint64(st.free_blocks[i]);
+    }
+    vga_putc('\n');
+    if (st.failed_allocs) {
+        vga_print("failed allocations: ");
+        vga_print_uint64(st.failed_allocs);
+        vga_putc('\n');
+    }
+
+    heap_stats_t hs;
+    heap_get_stats(&hs);
+    vga_print("heap: ");
+    vga_print_uint64(hs.spans);
+    vga_print(" spans, ");
+    vga_print_uint64(hs.span_bytes / 1024);
+    vga_print(" KiB, used ");
+    vga_print_uint64(hs.used_bytes);
+    vga_print(" in ");
+    vga_print_uint64(hs.used_blocks);
+    vga_println(" blocks");
+    vga_print("heap free: ");
+    vga_print_uint64(hs.free_bytes);
+    vga_print(" in ");
+    vga_print_uint64(hs.free_blocks);
+    vga_print(" blocks, largest ");
+    vga_print_uint64(hs.largest_free);
+    vga_print(", fragmentation ");
+    vga_print_uint64(hs.free_bytes ? 100 - hs.largest_free * 100 / hs.free_bytes : 0);
+    vga_println("%");
+}
+
+static void cmd_slabinfo(void) {
+    vga_println("cache            objsize  active  per-slab  slabs");
+    for (const kmem_cache_t *c = kmem_cache_first(); c; c = c->next) {
+        int pad = 17;
+        vga_print(c->name);
+        for (const char *p = c->name; *p && pad > 1; p++) pad--;
+        while (pad-- > 0) vga_putc(' ');
+        vga_print_uint64(c->obj_size);
+        vga_print("  ");
+        vga_print_uint64(c->active_objs);
+        vga_print("  ");
+        vga_print_uint64(c->objs_per_slab);
+        vga_print("  ");
+        vga_print_uint64(c->nr_slabs);
+        vga_putc('\n');
+    }
+}
+
+static void cmd_irqs(void) {
+    const irq_chip_t *chip = irq_get_chip();
+    vga_print("controller: ");
+    vga_println(chip ? chip->name : "none");
+    vga_println("vector  count");
+    for (int v = IRQ_VECTOR_FIRST; v < IRQ_VECTORS; v++) {
+        uint64_t n = irq_count((uint8_t)v);
+        if (!n) continue;
+        vga_print_uint64((uint64_t)v);
+        vga_print("  ");
+        vga_print_uint64(n);
+        vga_putc('\n');
+    }
+    vga_print("spurious ");
+    vga_print_uint64(irq_spurious_count());
+    vga_print(", unhandled ");
+    vga_print_uint64(irq_unhandled_count());
+    vga_putc('\n');
+}
+
+static void cmd_syscalls(void) {
+    vga_println("syscall  calls  avg cycles  latency histogram (cycles)");
+    for (uint64_t n = 0; n < SYSCALL_MAX; n++) {
+        syscall_stats_t st;
+        if (syscall_get_stats(n, &st) != 0 || !st.calls) continue;
+        uint64_t done = 0;
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) done += st.hist[b];
+        vga_print(st.name);
+        vga_print("  ");
+        vga_print_uint64(st.calls);
+        vga_print("  ");
+        vga_print_uint64(done ? st.cycles / done : 0);
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            if (!st.hist[b]) continue;
+            /* Верхняя граница бакета; у последнего её нет. */
+            vga_print(b == SYSCALL_HIST_BUCKETS - 1 ? "  >=" : "  <");
+            vga_print_uint64(1ull << (b + SYSCALL_HIST_SHIFT - (b == SYSCALL_HIST_BUCKETS - 1)));
+            vga_putc(':');
+            vga_print_uint64(st.hist[b]);
+        }
+        vga_putc('\n');
+    }
+}
+
+static void cmd_faults(void) {
+    vga_println("pid  minor  major  resident");
+    for (int i = 0; i < PROC_MAX; i++) {
+        struct process *p = process_at(i);
+        if (!p) continue;
+        vga_print_uint64(p->pid);
+        vga_print("  ");
+        vga_print_uint64(p->minor_faults);
+        vga_print("  ");
+        vga_print_uint64(p->major_faults);
+        vga_print("  ");
+        vga_print_uint64(p->space ? p->space->resident : 0);
+        vga_putc('\n');
+    }
+}
+
+/* value / unit с тремя знаками после точки. */
+static void print_fixed3(uint64_t value, uint64_t unit) {
+    uint64_t frac = value % unit * 1000 / unit;
+    vga_print_uint64(value / unit);
+    vga_putc('.');
+    if (frac < 100) vga_putc('0');
+    if (frac < 10) vga_putc('0');
+    vga_print_uint64(frac);
+}
+
+static void cmd_uptime(void) {
+    vga_print("up ");
+    print_fixed3(ktime_get_ns(), NSEC_PER_SEC);
+    vga_println(" s");
+    vga_print("clock: tsc ");
+    vga_print_uint64(clock_tsc_hz() / 1000000);
+    vga_print(" MHz");
+    if (!clock_tsc_invariant()) vga_print(" (not invariant)");
+    vga_print(", calibrated by ");
+    vga_println(clock_calibration_source());
+    vga_print("timer: ");
+    vga_print(timer_source_name());
+    vga_print(", ");
+    vga_print_uint64(timer_interrupts());
+    vga_print(" interrupts, ");
+    vga_print_uint64(timer_expired());
+    vga_println(" expired");
+}
+
+/* Десятичное число в начале s; *end — за ним. -1, если цифр нет. */
+static int parse_uint(const char *s, uint64_t *value, const char **end) {
+    uint64_t v = 0;
+    int i = 0;
+    while (s[i] == ' ') i++;
+    int start = i;
+    for (; s[i] >= '0' && s[i] <= '9'; i++) v = v * 10 + (uint64_t)(s[i] - '0');
+    if (i == start) return -1;
+    *value = v;
+    if (end) *end = &s[i];
+    return 0;
+}
+
+static void cmd_sleep(const char *args) {
+    uint64_t ms;
+    if (parse_uint(args, &ms, 0) != 0) {
+        vga_println("sleep: usage sleep <ms>");
+        return;
+    }
+    sched_sleep_ns(ms * NSEC_PER_MSEC);
+}
+
+static const char *const state_names[] = { "free", "run", "zombie", "ready", "wait" };
+
+static void cmd_ps(void) {
+    vga_println("pid  state  prio  on  cpu ms  name");
+    for (int i = 0; i < PROC_MAX; i++) {
+        struct process *p = process_at(i);
+        if (!p) continue;
+        vga_print_uint64(p->pid);
+        vga_print("  ");
+        vga_print(p->state <= PROC_BLOCKED ? state_names[p->state] : "?");
+        vga_print("  ");
+        vga_print_uint64(p->prio);
+        vga_print("  ");
+        vga_print_uint64(p->cpu);
+        vga_print("  ");
+        print_fixed3(sched_cpu_ns(p), NSEC_PER_MSEC);
+        vga_print("  ");
+        vga_println(p->name);
+    }
+    vga_print("context switches: ");
+    vga_print_uint64(sched_switches());
+    vga_putc('\n');
+}
+
+static void cmd_cpus(void) {
+    vga_println("cpu  apic  switches  steals  ready  task");
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        const struct percpu *c = smp_cpu(i);
+        sched_stats_t st;
+        sched_get_stats(i, &st);
+        vga_print_uint64(i);
+        vga_print("  ");
+        vga_print_uint64(c->apic_id);
+        vga_print("  ");
+        vga_print_uint64(st.switches);
+        vga_print("  ");
+        vga_print_uint64(st.steals);
+        vga_print("  ");
+        vga_print_uint64(st.ready);
+        vga_print("  ");
+        vga_println(st.current ? st.current->name : "-");
+    }
+}
+
+/* Крутится, пока не наберёт заданное время на CPU. */
+static void spin_task(void *arg) {
+    uint64_t ns = (uint64_t)(uintptr_t)arg * NSEC_PER_MSEC;
+    while (sched_cpu_ns(process_current()) < ns)
+        __asm__ volatile("pause");
+}
+
+static void cmd_spin(const char *args) {
+    uint64_t ms, prio = SCHED_PRIO_DEFAULT;
+    const char *rest;
+    if (parse_uint(args, &ms, &rest) != 0) {
+        vga_println("spin: usage spin <ms> [prio]");
+        return;
+    }
+    parse_uint(rest, &prio, 0);
+    struct process *p = sched_spawn("spin", spin_task, (void *)(uintptr_t)ms,
+                                    (uint8_t)(prio < SCHED_PRIO_LEVELS ? prio : SCHED_PRIO_LOW));
+    if (!p) {
+        vga_println("spin: no free task slot");
+        return;
+    }
+    vga_print("pid ");
+    vga_print_uint64(p->pid);
     vga_putc('\n');
 }
 
@@ -53,6 +303,21 @@ static void cmd_reboot(void) {
     cpu_reboot();
 }
 
+static void shell_execute(const char *line);
+
+static void cmd_time(const char *args) {
+    if (args[0] == '\0') {
+        vga_println("time: usage time <cmd>");
+        return;
+    }
+    uint64_t t0 = ktime_get_ns();
+    shell_execute(args);
+    uint64_t dt = ktime_get_ns() - t0;
+    vga_print("real ");
+    print_fixed3(dt, NSEC_PER_MSEC);
+    vga_println(" ms");
+}
+
 static void shell_execute(const char *line) {
     char cmd[16];
     const char *args = 0;
@@ -69,20 +334,20 @@ static void shell_execute(const char *line) {
 
     if (cmd[0] == '\0') return;
 
-    if (str_eq(cmd, "help")) {
+    if (strcmp(cmd, "help") == 0) {
         cmd_help();
-    } else if (str_eq(cmd, "clear") || str_eq(cmd, "cls")) {
+    } else if (strcmp(cmd, "clear") == 0 || strcmp(cmd, "cls") == 0) {
         vga_clear();
-    } else if (str_eq(cmd, "echo")) {
+    } else if (strcmp(cmd, "echo") == 0) {
         vga_print(args);
         vga_putc('\n');
-    } else if (str_eq(cmd, "ls")) {
+    } else if (strcmp(cmd, "ls") == 0) {
         if (fs_ls(args) != 0) vga_println("ls: error");
-    } else if (str_eq(cmd, "cd")) {
+    } else if (strcmp(cmd, "cd") == 0) {
         if (fs_cd(args) != 0) vga_println("cd: no such directory");
-    } else if (str_eq(cmd, "pwd")) {
+    } else if (strcmp(cmd, "pwd") == 0) {
         vga_println(fs_pwd());
-    } else if (str_eq(cmd, "cat")) {
+    } else if (strcmp(cmd, "cat") == 0) {
         char buf[256];
         uint64_t n = 0;
         if (fs_read_file(args, buf, sizeof(buf), &n) != 0) {
@@ -90,11 +355,11 @@ static void shell_execute(const char *line) {
         } else {
             vga_println(buf);
         }
-    } else if (str_eq(cmd, "mkdir")) {
+    } else if (strcmp(cmd, "mkdir") == 0) {
         if (fs_mkdir(args) != 0) vga_println("mkdir: error");
-    } else if (str_eq(cmd, "touch")) {
+    } else if (strcmp(cmd, "touch") == 0) {
         if (fs_touch(args) != 0) vga_println("touch: error");
-    } else if (str_eq(cmd, "write")) {
+    } else if (strcmp(cmd, "write") == 0) {
         char name[64];
         int ni = 0, j = 0;
         while (args[j] == ' ') j++;
@@ -108,16 +373,43 @@ static void shell_execute(const char *line) {
         } else {
             vga_println("ok");
         }
-    } else if (str_eq(cmd, "mem")) {
+    } else if (strcmp(cmd, "mem") == 0) {
         cmd_mem();
-    } else if (str_eq(cmd, "version")) {
+    } else if (strcmp(cmd, "slabinfo") == 0) {
+        cmd_slabinfo();
+    } else if (strcmp(cmd, "faults") == 0) {
+        cmd_faults();
+    } else if (strcmp(cmd, "irqs") == 0) {
+        cmd_irqs();
+    } else if (strcmp(cmd, "syscalls") == 0) {
+        cmd_syscalls();
+    } else if (strcmp(cmd, "uptime") == 0) {
+        cmd_uptime();
+    } else if (strcmp(cmd, "time") == 0) {
+        cmd_time(args);
+    } else if (strcmp(cmd, "ps") == 0) {
+        cmd_ps();
+    } else if (strcmp(cmd, "cpus") == 0) {
+        cmd_cpus();
+    } else if (strcmp(cmd, "spin") == 0) {
+        cmd_spin(args);
+    } else if (strcmp(cmd, "sleep") == 0) {
+        cmd_sleep(args);
+    } else if (strcmp(cmd, "bench") == 0) {
+        if (args[0] == '\0') {
+            bench_list();
+        } else if (bench_run(args) != 0) {
+            vga_println("bench: unknown benchmark");
+            bench_list();
+        }
+    } else if (strcmp(cmd, "version") == 0) {
         vga_print(KERNEL_NAME);
         vga_print(" ");
         vga_print(KERNEL_VERSION);
         vga_putc('\n');
-    } else if (str_eq(cmd, "halt")) {
+    } else if (strcmp(cmd, "halt") == 0) {
         cmd_halt();
-    } else if (str_eq(cmd, "reboot")) {
+    } else if (strcmp(cmd, "reboot") == 0) {
         cmd_reboot();
     } else {
         vga_print("unknown: ");
@@ -138,6 +430,10 @@ void shell_run(void) {
         vga_print("> ");
 
         keyboard_read_line(buf, sizeof(buf));
+        /* Команды трогают консоль, кучу и таблицы страниц без блокировок:
+         * пока команда идёт, shell не вытесняется (блокироваться можно). */
+        preempt_disable();
         shell_execute(buf);
+        preempt_enable();
     }
 }